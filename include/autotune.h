@@ -0,0 +1,48 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <chrono>
+#include <iosfwd>
+
+#include "pipeline.h"
+#include "simulator.h"
+
+// What the sizing aims for; the latency target wins when both apply
+struct AutoTuneTarget {
+    double utilization = 0.7;  // function arrival rate / processing pool capacity
+    double latencyMs = 0;      // mean generation-to-result latency, 0: none
+};
+
+struct MeasuredRates {
+    double dataRate = 0;      // values/s over all data threads
+    double functionRate = 0;  // functions/s over all function threads
+    ServiceTimes service;
+    double iterationSeconds = 0;  // mean processing loop iteration, pacing included
+};
+
+struct AutoTuneResult {
+    MeasuredRates rates;
+    int processingThreads = 0;
+    int dataQueueCapacity = 0;
+    int functionQueueCapacity = 0;
+    // Predictions for the chosen configuration
+    double utilization = 0;
+    double latencyMs = 0;
+    bool dataLimited = false;  // data generation is too slow for the function rate
+};
+
+// Runs only the generator threads of config for the given time, with queues
+// large enough never to block, and measures their rates and the processing
+// service times
+MeasuredRates measureRates(const PipelineConfig& config, std::chrono::milliseconds duration);
+
+// Smallest processing pool meeting the target, modelling each function queue
+// as M/M/1 served by random queue-pair visits, and capacities that keep
+// generators from blocking in more than 1% of pushes
+AutoTuneResult sizePipeline(const PipelineConfig& config, const MeasuredRates& rates,
+                            const AutoTuneTarget& target);
+
+void printAutoTuneReport(std::ostream& out, const AutoTuneResult& result,
+                         const AutoTuneTarget& target);
+
+#endif  // AUTOTUNE_H
@@ -0,0 +1,75 @@
+#ifndef BACKPRESSURE_H
+#define BACKPRESSURE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "metrics.h"
+#include "queue_registry.h"
+
+struct BackpressureConfig {
+    double targetFill = 0.5;  // queue occupancy to hold, fraction of capacity
+    // Mean latency of the functions applied in one interval above which every
+    // generator slows down; 0 ignores latency
+    std::chrono::microseconds latencyTarget{0};
+    double increase = 0.05;  // added to a throttle per calm interval
+    double decrease = 0.7;   // a throttle is multiplied by this on overload
+    double minThrottle = 0.2;
+    std::chrono::milliseconds interval{100};
+};
+
+struct BackpressureStats {
+    uint64_t intervals = 0;
+    uint64_t decreases = 0;  // generator throttles cut
+    uint64_t increases = 0;  // generator throttles raised
+    double meanThrottle = 1;  // over the generators of the last interval
+};
+
+// Feedback from the processing pool to the generators, so that queues stay
+// near a target occupancy instead of filling up, blocking their generator and
+// then refilling in a burst. Every interval each generator's throttle (see
+// BaseThread::setThrottle) is adjusted AIMD-style: multiplied by decrease when
+// its queue is above the target fill or the latency target is missed, raised
+// by increase otherwise, up to the paced rate. Unpaced generators cannot be
+// slowed down. Generators are found through the registry, so topology changes
+// are picked up on the next interval.
+class BackpressureController {
+   public:
+    BackpressureController(QueueRegistry& registry, const LatencyHistogram* latencies,
+                           const BackpressureConfig& config = {});
+    ~BackpressureController();
+
+    void start();
+    void stop();
+
+    // One control step; start() runs it every interval
+    void update();
+
+    BackpressureStats getStats() const;
+
+    BackpressureController(const BackpressureController&) = delete;
+    BackpressureController& operator=(const BackpressureController&) = delete;
+
+   private:
+    BackpressureConfig config;
+    const LatencyHistogram* latencies;
+    std::unique_ptr<QueueRegistry::Reader> reader;
+    // Latency histogram position at the previous step
+    LatencyHistogram::Totals last;
+
+    std::atomic<uint64_t> intervals{0};
+    std::atomic<uint64_t> decreases{0};
+    std::atomic<uint64_t> increases{0};
+    std::atomic<double> meanThrottle{1};
+
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+
+    bool latencyMissed();
+    void adjust(BaseThread& thread, size_t size, int capacity, bool overloaded);
+};
+
+#endif  // BACKPRESSURE_H
@@ -0,0 +1,27 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+#include "threads.h"
+
+// One function of a micro-batch with the data values it takes
+struct BatchItem {
+    ArithmeticFunction function;
+    std::vector<DataValue> args;
+    DataValue result;
+    bool failed = false;  // evaluation failed; result is unset
+    std::string error;    // why it failed, as apply() would have thrown it
+};
+
+// Evaluates every item, with the same results as function.apply(args).
+// Items are bucketed by operation and resolved operand types; each bucket's
+// operands are converted to their common type into contiguous arrays and
+// computed in one loop with the operation hoisted out, which the compiler
+// can vectorize. Division by zero marks the item failed with the error apply()
+// throws instead of throwing.
+// Returns the number of buckets executed.
+size_t applyBatch(std::vector<BatchItem>& items);
+
+#endif  // BATCH_H
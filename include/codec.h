@@ -0,0 +1,23 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <string>
+
+#include "threads.h"
+
+// Binary encoding of queue elements for logs, snapshots and transports. Fields
+// are written in host byte order, so encoded data only moves between machines
+// of the same architecture. ArithmeticFunction::generatedAt is a steady_clock
+// reading that means nothing in another process and is not encoded; decoded
+// functions have no generation time.
+
+// Appends the encoding of a value to out
+void encode(std::string& out, const DataValue& value);
+void encode(std::string& out, const ArithmeticFunction& function);
+
+// Decodes one value at cursor and advances it; returns false on truncated or
+// malformed input, leaving cursor unspecified
+bool decode(const char*& cursor, const char* end, DataValue& value);
+bool decode(const char*& cursor, const char* end, ArithmeticFunction& function);
+
+#endif  // CODEC_H
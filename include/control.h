@@ -0,0 +1,64 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "pipeline.h"
+
+// Live tuning of a running pipeline over a UNIX-domain socket. A request is
+// one line of text; the reply is any number of lines followed by "ok" or
+// "error: <reason>". One lightweight thread serves every client, and commands
+// act through the Pipeline's runtime setters without pausing the data path:
+//
+//   stats                                  counts, latency, every queue's fill (and owner)
+//   rate <data|function|processing> <x>    x times the startup rate ("max": unpaced)
+//   add <data|function|processing> [n]     start n more threads (default 1)
+//   remove <data|function|processing> [id]  retire a thread (default: the newest)
+//   capacity <data|function> <n>           resize every queue of that kind
+//   overflow <data|function> <policy>      overflow policy of those queues
+//   log <off|errors|all>                   thread log level
+//   snapshot <file>                        save all queue contents (see snapshot.h)
+//   help
+//
+// Linux only; elsewhere listen() fails.
+class ControlServer {
+   public:
+    explicit ControlServer(Pipeline& pipeline);
+    ~ControlServer();
+
+    // Starts serving on path (replacing a stale socket file)
+    bool listen(const std::string& path, std::string& error);
+    // Disconnects every client, removes the socket file and joins the thread
+    void stop();
+
+    // Runs one command and returns its reply, ending with the status line
+    std::string execute(const std::string& line);
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+   private:
+    Pipeline& pipeline;
+    // Pacing at startup; rate factors are relative to it
+    Pacing dataPacing;
+    Pacing functionPacing;
+    Pacing processingPacing;
+    std::mutex executeMtx;  // commands run one at a time
+
+    std::string socketPath;
+    int listenFd = -1;
+    std::atomic<bool> stopping{false};
+    std::thread serverThread;
+
+    void serve();
+};
+
+// Client side: sends one command and collects the reply up to its status
+// line. Returns false if the server could not be reached.
+bool sendControlCommand(const std::string& path, const std::string& command, std::string& reply,
+                        std::string& error);
+
+#endif  // CONTROL_H
@@ -0,0 +1,96 @@
+#ifndef DURABLE_QUEUE_H
+#define DURABLE_QUEUE_H
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "codec.h"
+#include "queue.h"
+#include "wal.h"
+
+// Queue<T> whose contents survive a crash. Every push is written to a
+// WriteAheadLog before it becomes visible and every pop appends an
+// acknowledgement; the constructor replays the log and refills the queue with
+// the elements that were never popped. Pop acknowledgements are not waited
+// for, so after a crash the last popped elements may be delivered again
+// (at-least-once). T needs encode()/decode() overloads (see codec.h).
+template <typename T>
+class DurableQueue {
+   public:
+    // Opens or creates the log in directory. If more elements are recovered
+    // than capacity allows, the capacity grows to hold them. waitForCommit
+    // makes push() return only once its record is durable; otherwise a crash
+    // loses at most the last commit interval of pushes.
+    // Throws std::runtime_error if the log cannot be opened.
+    DurableQueue(const string& directory, int capacity = 50,
+                 const WalOptions& options = WalOptions(), bool waitForCommit = true)
+        : log(options), waitForCommit(waitForCommit) {
+        vector<pair<uint64_t, string>> records;
+        if (!log.open(directory, records)) {
+            throw runtime_error("Could not open write-ahead log in " + directory);
+        }
+        elements = make_unique<Queue<Entry>>(max(capacity, static_cast<int>(records.size())));
+        for (const auto& [sequence, payload] : records) {
+            Entry entry{sequence, T()};
+            const char* cursor = payload.data();
+            if (!decode(cursor, cursor + payload.size(), entry.value)) {
+                throw runtime_error("Corrupt element in write-ahead log " + directory);
+            }
+            elements->push(entry);
+        }
+        recovered = records.size();
+    }
+
+    void push(const T& elem) {
+        string payload;
+        encode(payload, elem);
+        uint64_t sequence;
+        uint64_t position = log.appendPush(payload, sequence);
+        elements->push({sequence, elem});
+        if (waitForCommit) log.waitDurable(position);
+    }
+
+    // The acknowledgement is appended before the element leaves the queue, so
+    // if the append throws (e.g. disk full) the element is still queued
+    T pop() {
+        Entry entry =
+            elements->popCommitted([this](const Entry& front) { log.appendPop(front.sequence); });
+        return entry.value;
+    }
+
+    // Closes the queue (see Queue::close) and makes the log durable
+    void close() {
+        elements->close();
+        log.close();
+    }
+
+    size_t size() const { return elements->size(); }
+
+    bool empty() const { return elements->empty(); }
+
+    int getId() const { return elements->getId(); }
+
+    int getMaxCapacity() const { return elements->getMaxCapacity(); }
+
+    // Elements restored from the log when the queue was opened
+    size_t recoveredCount() const { return recovered; }
+
+    WalStats getLogStats() const { return log.getStats(); }
+
+   private:
+    struct Entry {
+        uint64_t sequence;
+        T value;
+    };
+
+    WriteAheadLog log;
+    unique_ptr<Queue<Entry>> elements;
+    bool waitForCommit;
+    size_t recovered = 0;
+};
+
+#endif  // DURABLE_QUEUE_H
@@ -0,0 +1,35 @@
+#ifndef HASH_RING_H
+#define HASH_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Consistent hash ring assigning keys (generator ids) to nodes (processing
+// thread ids). Every node owns VIRTUAL_NODES points on a 64-bit ring and a key
+// belongs to the node of the first point at or after the key's hash, so
+// adding or removing one of n nodes moves only about 1/n of the keys, all of
+// them to or from that node.
+class HashRing {
+   public:
+    static constexpr int VIRTUAL_NODES = 64;
+
+    // Adding a present node or removing an absent one changes nothing
+    void add(int node);
+    void remove(int node);
+
+    // Node owning key, -1 while the ring is empty
+    int owner(uint64_t key) const;
+    // Index of the key first at or after node's first ring point (wrapping
+    // around), whether or not node is on the ring; -1 if keys is empty
+    static int nearest(int node, const std::vector<uint64_t>& keys);
+    bool contains(int node) const;
+    size_t size() const { return points.size() / VIRTUAL_NODES; }
+    bool empty() const { return points.empty(); }
+
+   private:
+    std::vector<std::pair<uint64_t, int>> points;  // sorted by position
+};
+
+#endif  // HASH_RING_H
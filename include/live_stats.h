@@ -0,0 +1,105 @@
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Layout of the live statistics shared-memory segment. The processing process
+// is the only writer; viewers such as pt_top map it read-only. All counters
+// are monotonic and written with relaxed atomics, so a viewer may see values
+// from slightly different instants but never a torn one. Slots of destroyed
+// queues and threads are freed and reused; a slot's generation is odd while it
+// is in use and changes on every reuse, so viewers skip free slots and never
+// derive a rate across two owners.
+constexpr uint32_t LIVE_STATS_MAGIC = 0x54534c50;  // "PLST"
+constexpr uint32_t LIVE_STATS_VERSION = 3;
+constexpr size_t LIVE_STATS_MAX_QUEUES = 256;
+constexpr size_t LIVE_STATS_MAX_THREADS = 512;
+constexpr const char* LIVE_STATS_DEFAULT_NAME = "/processing_threads";
+
+enum class StatsKind : uint32_t { DATA, FUNCTION, PROCESSING };
+
+// One queue; depth is pushed - popped - evicted. Padded to a cache line so
+// writers of different queues never share one.
+struct alignas(64) QueueStats {
+    std::atomic<uint32_t> generation;
+    int32_t queueId;
+    StatsKind kind;
+    std::atomic<int32_t> capacity;  // follows runtime capacity changes
+    std::atomic<uint64_t> pushed;
+    std::atomic<uint64_t> popped;
+    std::atomic<uint64_t> evicted;  // removed by the drop-oldest overflow policy
+};
+
+// One thread: items generated (generators) or functions applied (processing).
+// Latency is the time blocked in push for generators and the
+// generation-to-result time of applied functions for processing threads.
+struct alignas(64) ThreadStats {
+    std::atomic<uint32_t> generation;
+    int32_t threadId;
+    StatsKind kind;
+    std::atomic<uint64_t> operations;
+    std::atomic<uint64_t> latencySumNs;
+    std::atomic<uint64_t> latencyMaxNs;
+
+    void recordOperation(uint64_t latencyNs);
+};
+
+struct LiveStatsSegment {
+    uint32_t magic;
+    uint32_t version;
+    int32_t pid;
+    std::atomic<uint32_t> queueCount;   // slots ever used, live or free
+    std::atomic<uint32_t> threadCount;
+    QueueStats queues[LIVE_STATS_MAX_QUEUES];
+    ThreadStats threads[LIVE_STATS_MAX_THREADS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "live stats counters must be lock-free to live in shared memory");
+
+// Publisher side: owns the segment for the lifetime of the process
+class LiveStats {
+   public:
+    static LiveStats& instance();
+
+    // Creates (or replaces) the named POSIX shared-memory segment; returns false
+    // if shared memory is unavailable, leaving live stats disabled
+    bool open(const std::string& name = LIVE_STATS_DEFAULT_NAME);
+    // Unmaps and unlinks the segment
+    void close();
+    // Stops publishing from this process but leaves the segment to its
+    // creator; for children forked by a publishing process
+    void detach();
+    bool isOpen() const { return segment != nullptr; }
+
+    // Slots for new queues/threads, reusing freed ones; nullptr when disabled
+    // or the table is full
+    QueueStats* registerQueue(int queueId, StatsKind kind, int capacity);
+    ThreadStats* registerThread(int threadId, StatsKind kind);
+    // Frees a slot once its owner has stopped writing to it; nullptr is ignored
+    void unregisterQueue(QueueStats* slot);
+    void unregisterThread(ThreadStats* slot);
+
+    const LiveStatsSegment* getSegment() const { return segment; }
+
+    LiveStats(const LiveStats&) = delete;
+    LiveStats& operator=(const LiveStats&) = delete;
+
+   private:
+    LiveStats() = default;
+    ~LiveStats();
+
+    LiveStatsSegment* segment = nullptr;
+    std::string segmentName;
+    std::mutex mtx;
+};
+
+// Viewer side: maps an existing segment read-only; nullptr on failure
+const LiveStatsSegment* attachLiveStats(const std::string& name, std::string& error);
+void detachLiveStats(const LiveStatsSegment* segment);
+
+#endif  // LIVE_STATS_H
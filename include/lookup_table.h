@@ -0,0 +1,59 @@
+#ifndef LOOKUP_TABLE_H
+#define LOOKUP_TABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "threads.h"
+
+// Precomputed results of int ⊕ int for all four operations with both
+// operands in [DATA_MIN_VALUE, DATA_MAX_VALUE]. Data ints and function int
+// constants (-20..20) both fall in that range, so every int/int application
+// can be answered by one load. Results fit in 16 bits (|a*b| <= 10000),
+// which keeps the table at ~320 KiB; division by zero is stored as a marker.
+class IntLookupTable {
+   public:
+    static constexpr int MIN_OPERAND = DATA_MIN_VALUE;
+    static constexpr int MAX_OPERAND = DATA_MAX_VALUE;
+
+    // Built on first use
+    static const IntLookupTable& instance();
+
+    // Whether ArithmeticFunction::apply consults the table (off by default)
+    static void enable(bool enabled);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    static bool covers(int a, int b) {
+        return a >= MIN_OPERAND && a <= MAX_OPERAND && b >= MIN_OPERAND && b <= MAX_OPERAND;
+    }
+
+    // Result of a op b; both operands must be covered. Throws
+    // std::runtime_error on division by zero, like ArithmeticFunction::apply.
+    int lookup(Operation op, int a, int b) const {
+        int16_t result = results[index(op, a, b)];
+        if (result == DIVISION_BY_ZERO) throw std::runtime_error("Division by zero");
+        return result;
+    }
+
+   private:
+    static constexpr int SIDE = MAX_OPERAND - MIN_OPERAND + 1;
+    static constexpr int16_t DIVISION_BY_ZERO = std::numeric_limits<int16_t>::min();
+    static_assert(MAX_OPERAND * MAX_OPERAND < std::numeric_limits<int16_t>::max() &&
+                      MIN_OPERAND * MAX_OPERAND > DIVISION_BY_ZERO,
+                  "int results must fit the 16-bit table entries");
+
+    static std::atomic<bool> enabled;
+    std::vector<int16_t> results;  // [op][a][b]
+
+    IntLookupTable();
+
+    static size_t index(Operation op, int a, int b) {
+        return (static_cast<size_t>(op) * SIDE + static_cast<size_t>(a - MIN_OPERAND)) * SIDE +
+               static_cast<size_t>(b - MIN_OPERAND);
+    }
+};
+
+#endif  // LOOKUP_TABLE_H
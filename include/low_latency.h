@@ -0,0 +1,52 @@
+#ifndef LOW_LATENCY_H
+#define LOW_LATENCY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// OS knobs for latency-critical runs. Each returns false where the platform
+// or the process's privileges do not allow it, leaving things unchanged, so
+// callers can fall back to default scheduling. Linux only; elsewhere every
+// call fails.
+
+// Restricts the calling thread to the given CPUs
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+// Switches the calling thread to SCHED_FIFO at priority (1..99); usually
+// needs CAP_SYS_NICE or an rtprio limit
+bool setFifoPriority(int priority);
+
+// Locks current and future pages of the process in memory (mlockall), so page
+// faults and swapping cannot stall a thread later; needs CAP_IPC_LOCK or a
+// sufficient memlock limit
+bool lockProcessMemory();
+
+// Touches the given number of bytes of the calling thread's stack, so its
+// pages are mapped before latency matters
+void prefaultStack(size_t bytes);
+
+// "0-3,6" style list, as in /sys and taskset; throws std::invalid_argument
+std::vector<int> parseCpuList(const std::string& text);
+
+// CPUs isolated from the scheduler (isolcpus=), if any
+std::vector<int> isolatedCpus();
+
+// Number of CPUs this process may run on
+int availableCpus();
+
+// CPUs for count busy-polling threads: isolated CPUs if the kernel has any,
+// otherwise the highest-numbered CPUs this process may run on, which leaves
+// the low ones to generators and the OS
+std::vector<int> lowLatencyCpus(int count);
+
+// Spin-wait hint for busy-polling loops
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+#endif  // LOW_LATENCY_H
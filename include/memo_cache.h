@@ -0,0 +1,57 @@
+#ifndef MEMO_CACHE_H
+#define MEMO_CACHE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "threads.h"
+
+struct MemoStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    uint64_t lookups() const { return hits + misses; }
+    double hitRatio() const { return lookups() > 0 ? static_cast<double>(hits) / lookups() : 0; }
+    MemoStats& operator+=(const MemoStats& other) {
+        hits += other.hits;
+        misses += other.misses;
+        return *this;
+    }
+};
+
+// Bounded, direct-mapped cache of function results for one thread. The key is
+// the operation plus both resolved operands packed into five 64-bit words
+// (type tags and the raw bits of each value), hashed with a multiply-xorshift.
+// A colliding entry is simply replaced. Results that throw (division by zero)
+// are not cached.
+class MemoCache {
+   public:
+    // entries is rounded up to a power of two
+    explicit MemoCache(size_t entries);
+
+    // Same result as func.apply(args), from the cache when possible
+    DataValue apply(const ArithmeticFunction& func, const std::vector<DataValue>& args);
+
+    size_t capacity() const { return slots.size(); }
+    // Not synchronized: read from another thread only after the owner joined
+    MemoStats getStats() const { return stats; }
+
+   private:
+    struct Key {
+        uint64_t words[5];  // op and type tags, left re/im, right re/im
+        bool operator==(const Key& other) const;
+    };
+    struct Slot {
+        Key key{};  // all zero while empty; a valid key never is
+        DataValue result;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask;
+    MemoStats stats;
+
+    static Key makeKey(Operation op, const DataValue& left, const DataValue& right);
+    static size_t hash(const Key& key);
+};
+
+#endif  // MEMO_CACHE_H
@@ -0,0 +1,49 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Concurrent latency histogram with log-linear buckets: 16 sub-buckets per
+// power of two, i.e. at most ~6% relative error, covering the full uint64_t
+// nanosecond range. record() is wait-free (relaxed atomics), so any number of
+// threads can record while another thread reads percentiles.
+class LatencyHistogram {
+   public:
+    // Count and sum of the recorded values, consistent with each other
+    struct Totals {
+        uint64_t count = 0;
+        uint64_t sumNs = 0;
+    };
+
+    void record(uint64_t valueNs);
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maximum.load(std::memory_order_relaxed); }
+    double mean() const;
+    // Every value in sumNs is also in count; the difference of two snapshots
+    // gives the values recorded in between
+    Totals totals() const;
+    // Upper bound of the bucket holding the p-th percentile (p in [0, 100]); 0 when empty
+    uint64_t percentile(double p) const;
+
+    // Clears all counts; values recorded concurrently may or may not survive
+    void reset();
+
+   private:
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    static size_t bucketFor(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maximum{0};
+};
+
+#endif  // METRICS_H
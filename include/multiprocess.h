@@ -0,0 +1,65 @@
+#ifndef MULTIPROCESS_H
+#define MULTIPROCESS_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+#include "shm_queue.h"
+
+// Runs every data and function generator of a pipeline in its own child
+// process. Each child runs an ordinary DataThread/FunctionThread and a bridge
+// that moves its output into a ShmQueue; in this process the pipeline's
+// generator threads read those queues through their sources and forward the
+// elements into their own Queue. That hop costs one copy per element, but it
+// keeps everything built on generator queues (registry, overflow policies,
+// timed pops, live stats, snapshots, partitioning) unchanged.
+//
+// A generator process that crashes leaves the processing process running: its
+// source notices the exit while waiting, closes the shared queue and ends once
+// the queue is drained.
+class GeneratorProcesses {
+   public:
+    ~GeneratorProcesses();
+
+    // Creates the shared queues and forks the children; must be called
+    // before this process starts any thread. Returns false if shared memory
+    // or fork is unavailable.
+    bool start(const PipelineConfig& config);
+
+    // Points the pipeline's generator sources at the shared queues; the
+    // sources refer to this object, which must outlive the pipeline's threads
+    void attachSources(PipelineConfig& config);
+
+    // Closes the shared queues, which ends the children and the sources, and
+    // reaps the children; one that has not exited after a grace period (e.g.
+    // because it hangs) is killed
+    void stop();
+
+    size_t processCount() const { return children.size(); }
+    // Process ids in generator order: data generators first
+    std::vector<int> getPids() const;
+    // Children reaped so far
+    size_t exitedCount() const;
+
+   private:
+    struct Child {
+        int pid;
+        bool exited = false;
+    };
+
+    std::vector<std::unique_ptr<ShmQueue<DataValue>>> dataQueues;
+    std::vector<std::unique_ptr<ShmQueue<ArithmeticFunction>>> functionQueues;
+    std::vector<Child> children;
+    mutable std::mutex childMtx;  // reaping happens in the sources and in stop()
+
+    // Reaps the child without blocking; whether it has exited
+    bool hasExited(size_t child);
+    // Source of one generator thread: the shared queue of the given child
+    template <typename T>
+    bool receive(ShmQueue<T>& queue, size_t child, T& elem);
+};
+
+#endif  // MULTIPROCESS_H
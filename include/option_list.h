@@ -0,0 +1,33 @@
+#ifndef OPTION_LIST_H
+#define OPTION_LIST_H
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Parses a comma-separated list of non-negative numbers given to a command-line
+// option, e.g. "--np=1,2,4"; throws std::invalid_argument on a malformed or
+// negative item and on an empty list
+template <typename T>
+std::vector<T> parseList(const std::string& text) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t used = 0;
+        T value;
+        if constexpr (std::is_same_v<T, double>) {
+            value = std::stod(item, &used);
+        } else {
+            value = std::stoi(item, &used);
+        }
+        if (used != item.size() || value < 0) throw std::invalid_argument(item);
+        values.push_back(value);
+    }
+    if (values.empty()) throw std::invalid_argument(text);
+    return values;
+}
+
+#endif  // OPTION_LIST_H
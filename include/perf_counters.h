@@ -0,0 +1,69 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Hardware/software events counted per thread
+enum class PerfEvent { CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, CONTEXT_SWITCHES };
+
+constexpr size_t PERF_EVENT_COUNT = 5;
+
+// Counter values of one thread; an empty optional means the event could not be opened
+using PerfValues = std::array<std::optional<uint64_t>, PERF_EVENT_COUNT>;
+
+// Optional collector of per-thread perf counters (Linux perf_event_open).
+// When enabled, every BaseThread opens its counters as its worker starts. The
+// counters stay readable after the thread exits, so the report can be produced
+// at shutdown without joining. A destroyed thread's counters are read one last
+// time and closed, so threads added and retired at runtime do not hold fds.
+// Missing kernel support or permissions only turn the affected values into "n/a".
+class PerfCollector {
+   public:
+    static PerfCollector& instance();
+
+    void enable();
+    bool isEnabled() const;
+
+    // Opens counters for the calling thread; no-op while disabled
+    void attachCurrentThread(const std::string& threadType, int threadId);
+    // Keeps the final values of the thread's counters and closes them; ids
+    // are only unique per thread type
+    void detachThread(const std::string& threadType, int threadId);
+
+    // Reads the current value of every counter, one entry per attached thread
+    std::vector<std::pair<std::string, PerfValues>> readAll() const;
+
+    // Totals per thread type; ProcessingThread totals are also normalized by
+    // the number of applied functions
+    void report(std::ostream& out, int functionsApplied) const;
+
+    static const char* eventName(PerfEvent event);
+
+    PerfCollector(const PerfCollector&) = delete;
+    PerfCollector& operator=(const PerfCollector&) = delete;
+
+   private:
+    PerfCollector() = default;
+    ~PerfCollector();
+
+    struct ThreadCounters {
+        std::string threadType;
+        int threadId;
+        std::array<int, PERF_EVENT_COUNT> fds;
+        std::optional<PerfValues> finalValues;  // set once detached
+    };
+
+    std::atomic<bool> enabled{false};
+    std::string firstError;
+    std::vector<ThreadCounters> threads;
+    mutable std::mutex mtx;
+};
+
+#endif  // PERF_COUNTERS_H
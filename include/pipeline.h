@@ -0,0 +1,176 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "memo_cache.h"
+#include "metrics.h"
+#include "queue_registry.h"
+#include "reorder_buffer.h"
+#include "threads.h"
+
+// Thread id ranges, disjoint so that an id names one thread: data threads
+// 1..99, function threads 100..199, processing threads from 200
+constexpr int FIRST_DATA_ID = 1;
+constexpr int FIRST_FUNCTION_ID = 100;
+constexpr int FIRST_PROCESSING_ID = 200;
+
+// Topology and pacing of one processing run
+struct PipelineConfig {
+    int functionThreads = 0;    // NF
+    int dataThreads = 0;        // ND
+    int processingThreads = 0;  // NP
+    int maxFunctions = std::numeric_limits<int>::max();  // NA, stop condition
+    // 0 selects calculateQueueCapacity() of the producer count
+    int dataQueueCapacity = 0;
+    int functionQueueCapacity = 0;
+    Pacing dataPacing = DATA_PACING;
+    Pacing functionPacing = FUNCTION_PACING;
+    Pacing processingPacing = PROCESSING_PACING;
+    // Optional per-thread sources; generator i uses entry i when present
+    std::vector<DataSource> dataSources;
+    std::vector<FunctionSource> functionSources;
+    // Per-processing-thread result cache entries, 0 disables memoization
+    size_t memoEntries = 0;
+    // Longest a processing thread waits on one queue (see Queue::popFor)
+    std::chrono::microseconds queueWait = PROCESSING_QUEUE_WAIT;
+    // What a generator's push does when its queue is full
+    OverflowPolicy dataOverflow = OverflowPolicy::BLOCK;
+    OverflowPolicy functionOverflow = OverflowPolicy::BLOCK;
+    // Scheduling of the processing threads; processing thread i is pinned to
+    // lowLatency.cpus[i % cpus.size()] alone
+    LowLatencyProfile lowLatency;
+    // Each processing thread serves only the generators the registry's
+    // consistent hash ring assigns it, instead of any random pair
+    bool partitioned = false;
+    // Micro-batching of every processing thread, off by default
+    BatchConfig batch;
+    // Receives every function thread's results in generation order (see
+    // ReorderBuffer); nullptr leaves results unordered
+    OrderedSink orderedSink;
+    ReorderConfig reorder;
+};
+
+// Overflow counters of a set of queues (see Queue::droppedCount)
+struct OverflowCounts {
+    uint64_t dropped = 0;
+    uint64_t rejected = 0;
+};
+
+// Queue capacity that avoids deadlocks for the given number of producers
+int calculateQueueCapacity(int producers);
+
+// Owns the data, function and processing threads of one run. Thread ids follow
+// the processing_threads convention: data 1.., function 100.., processing 200..
+// Processing threads find the generators through a QueueRegistry, so
+// generators can be added and retired while the pipeline runs.
+class Pipeline {
+   public:
+    explicit Pipeline(const PipelineConfig& config);
+    ~Pipeline();
+
+    // Threads of one kind are constructed in parallel. Starting the generators
+    // first lets the processing threads see every queue from their first
+    // iteration.
+    void startDataThreads();
+    void startFunctionThreads();
+    void startProcessingThreads();
+    void start();
+
+    // Runtime topology changes. New generators use the configured capacity
+    // and pacing and get the next id of their kind's range, throwing
+    // runtime_error once it is used up. Retiring stops the generator and
+    // closes its queue; elements still queued are lost once no processing
+    // thread can reach it any more. Returns false for an unknown id.
+    int addDataThread();
+    int addFunctionThread();
+    bool retireDataThread(int id);
+    bool retireFunctionThread(int id);
+    // A retired processing thread finishes its current operation and is
+    // joined before this returns. Both rebalance the partitions.
+    int addProcessingThread();
+    bool retireProcessingThread(int id);
+
+    // Live tuning: applies to running threads from their next iteration and
+    // to threads added later. Busy-polling processing threads keep no delay.
+    void setDataPacing(const Pacing& pacing);
+    void setFunctionPacing(const Pacing& pacing);
+    void setProcessingPacing(const Pacing& pacing);
+    // See Queue::setMaxCapacity
+    void setDataQueueCapacity(int capacity);
+    void setFunctionQueueCapacity(int capacity);
+    // See Queue::setOverflowPolicy
+    void setDataOverflowPolicy(OverflowPolicy policy);
+    void setFunctionOverflowPolicy(OverflowPolicy policy);
+
+    // Warm-up barrier: blocks until every data and function queue holds at
+    // least level elements (capped at its capacity), or timeout passes.
+    // Returns whether the level was reached; level 0 returns immediately.
+    bool waitForPrefill(int level, std::chrono::milliseconds timeout) const;
+
+    // Elements queued into the i-th data/function thread's queue before it
+    // starts generating, e.g. a restored snapshot (see restoreSnapshot).
+    // Call before startDataThreads()/startFunctionThreads().
+    void preloadQueues(std::vector<std::vector<DataValue>> data,
+                       std::vector<std::vector<ArithmeticFunction>> functions);
+
+    // Stops every thread, closes the queues to release blocked callers and
+    // joins; queue contents are kept
+    void stop();
+
+    int getFunctionsProcessed() const { return functionsProcessed.load(); }
+    // The getters below are not synchronized with the runtime changes above:
+    // use them from the thread that makes the changes, or read getRegistry()
+    const PipelineConfig& getConfig() const { return config; }
+    const std::vector<std::unique_ptr<DataThread>>& getDataThreads() const { return dataThreads; }
+    const std::vector<std::unique_ptr<FunctionThread>>& getFunctionThreads() const {
+        return functionThreads;
+    }
+    const std::vector<std::unique_ptr<ProcessingThread>>& getProcessingThreads() const {
+        return processingThreads;
+    }
+    QueueRegistry& getRegistry() { return registry; }
+    // Summed over the live data and function queues
+    OverflowCounts getOverflowCounts() const;
+    // Generation-to-result latency of every applied function
+    LatencyHistogram& getLatencies() { return latencies; }
+    // Ordered output counters, shared by all function threads
+    const ReorderMetrics& getReorderMetrics() const { return reorderMetrics; }
+    // Memo cache hits and misses of all processing threads; call after stop()
+    MemoStats getMemoStats() const;
+    // Batching counters of all processing threads; call after stop()
+    BatchStats getBatchStats() const;
+
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+   private:
+    PipelineConfig config;
+    std::atomic<int> functionsProcessed{0};
+    LatencyHistogram latencies;
+    ReorderMetrics reorderMetrics;
+    // Declared before the threads: processing threads hold readers of it
+    QueueRegistry registry;
+    std::mutex topologyMtx;  // serializes runtime topology changes
+    int nextDataId;
+    int nextFunctionId;
+    int nextProcessingId;
+    std::vector<std::unique_ptr<DataThread>> dataThreads;
+    std::vector<std::unique_ptr<FunctionThread>> functionThreads;
+    std::vector<std::unique_ptr<ProcessingThread>> processingThreads;
+    // Consumed by the start methods
+    std::vector<std::vector<DataValue>> preloadedData;
+    std::vector<std::vector<ArithmeticFunction>> preloadedFunctions;
+
+    // Gives a new function thread its reorder buffer when ordered output is on
+    void attachReorderBuffer(FunctionThread& thread);
+    // index selects the pinned CPU of a low-latency profile
+    std::unique_ptr<ProcessingThread> makeProcessingThread(int index, int id);
+};
+
+#endif  // PIPELINE_H
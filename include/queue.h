@@ -2,59 +2,273 @@
 #define QUEUE_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <iostream>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 using namespace std;
 
 // Global counter shared by all Queue instantiations
-static atomic<int> globalRunningID{0};
+inline atomic<int> globalRunningID{0};
 
+// Whether constructing a Queue prints its type, id and capacity
+inline atomic<bool> logQueueCreation{true};
+
+// What push() does with a full queue
+enum class OverflowPolicy {
+    BLOCK,        // wait for room (the default)
+    DROP_NEWEST,  // discard the pushed element
+    DROP_OLDEST,  // discard the front element to make room (ring semantics)
+    REJECT        // refuse the element and leave it to the caller
+};
+
+enum class PushResult {
+    PUSHED,
+    EVICTED_OLDEST,  // pushed after discarding the front element
+    DROPPED,         // not queued, the element is gone
+    REJECTED,        // not queued, the caller still owns the element
+    CLOSED,          // not queued, the queue was closed
+    TIMED_OUT        // not queued, still full at the deadline (timed pushes only)
+};
+
+inline bool wasQueued(PushResult result) {
+    return result == PushResult::PUSHED || result == PushResult::EVICTED_OLDEST;
+}
+
+inline const char* overflowPolicyName(OverflowPolicy policy) {
+    switch (policy) {
+        case OverflowPolicy::BLOCK:
+            return "block";
+        case OverflowPolicy::DROP_NEWEST:
+            return "drop-newest";
+        case OverflowPolicy::DROP_OLDEST:
+            return "drop-oldest";
+        case OverflowPolicy::REJECT:
+            return "reject";
+    }
+    return "unknown";
+}
+
+// Inverse of overflowPolicyName(); false for an unknown name
+inline bool parseOverflowPolicy(const string& name, OverflowPolicy& policy) {
+    for (OverflowPolicy candidate : {OverflowPolicy::BLOCK, OverflowPolicy::DROP_NEWEST,
+                                     OverflowPolicy::DROP_OLDEST, OverflowPolicy::REJECT}) {
+        if (name == overflowPolicyName(candidate)) {
+            policy = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bounded FIFO. When full, push() follows the queue's OverflowPolicy; pop()
+// blocks while empty, and the timed variants bound both waits. push/pop
+// synchronize on the mutex; size() and empty() never take it. They read a
+// relaxed atomic copy of the element count that is stored under the mutex
+// after every push/pop, so the value is exact at some recent instant but may
+// already be stale when the caller acts on it (another thread can pop right
+// after empty() returned false). Use them for heuristics and monitoring; only
+// push/pop give guarantees.
 template <typename T>
 class Queue {
    public:
     // Constructor with dynamic capacity
-    Queue(int capacity = 50) : maxCapacity(capacity), uniqueId(globalRunningID++) {
-        cout << "Created Queue of type: " << typeid(T).name() << ", uniqueId: " << uniqueId
-             << ", Max Capacity: " << maxCapacity << endl;
+    Queue(int capacity = 50, OverflowPolicy policy = OverflowPolicy::BLOCK)
+        : uniqueId(globalRunningID++), maxCapacity(capacity), policy(policy) {
+        if (logQueueCreation.load(memory_order_relaxed)) {
+            cout << "Created Queue of type: " << typeid(T).name() << ", uniqueId: " << uniqueId
+                 << ", Max Capacity: " << maxCapacity.load() << endl;
+        }
     }
 
-    void push(const T& elem) {
+    // Only BLOCK ever waits; the other policies return at once when full
+    PushResult push(const T& elem) {
         unique_lock<mutex> lock(mtx);
-        cv.wait(lock, [this] { return elements.size() < static_cast<size_t>(maxCapacity); });
-        elements.push(elem);
+        cv.wait(lock, [this] { return canPush(); });
+        return pushLocked(elem);
+    }
+
+    // Like push(), but BLOCK waits at most timeout and then gives up with TIMED_OUT
+    template <typename Rep, typename Period>
+    PushResult pushFor(const T& elem, const chrono::duration<Rep, Period>& timeout) {
+        unique_lock<mutex> lock(mtx);
+        if (!cv.wait_for(lock, timeout, [this] { return canPush(); })) {
+            return PushResult::TIMED_OUT;
+        }
+        return pushLocked(elem);
+    }
+
+    // Non-blocking push regardless of the policy; returns false if the queue
+    // is full or closed
+    bool tryPush(const T& elem) {
+        lock_guard<mutex> lock(mtx);
+        if (closed || full()) return false;
+        elements.push_back(elem);
+        approximateSize.store(elements.size(), memory_order_relaxed);
         cv.notify_one();
+        return true;
     }
 
     T pop() {
         unique_lock<mutex> lock(mtx);
-        cv.wait(lock, [this] { return !elements.empty(); });
-        T elem = elements.front();
-        elements.pop();
+        cv.wait(lock, [this] { return closed || !elements.empty(); });
+        if (elements.empty()) throw runtime_error("Queue closed");
+        return popLocked();
+    }
+
+    // Like pop(), but the front element is only removed once commit(front)
+    // returned; if commit throws, the element stays at the front. commit runs
+    // with the queue locked.
+    template <typename Commit>
+    T popCommitted(Commit&& commit) {
+        unique_lock<mutex> lock(mtx);
+        cv.wait(lock, [this] { return closed || !elements.empty(); });
+        if (elements.empty()) throw runtime_error("Queue closed");
+        commit(static_cast<const T&>(elements.front()));
+        return popLocked();
+    }
+
+    // Like pop(), but returns nullopt if no element arrived by the deadline.
+    // Still throws once the queue is closed and drained.
+    template <typename Clock, typename Duration>
+    optional<T> popUntil(const chrono::time_point<Clock, Duration>& deadline) {
+        unique_lock<mutex> lock(mtx);
+        if (!cv.wait_until(lock, deadline, [this] { return closed || !elements.empty(); })) {
+            return nullopt;
+        }
+        if (elements.empty()) throw runtime_error("Queue closed");
+        return popLocked();
+    }
+
+    template <typename Rep, typename Period>
+    optional<T> popFor(const chrono::duration<Rep, Period>& timeout) {
+        return popUntil(chrono::steady_clock::now() + timeout);
+    }
+
+    // Non-blocking pop; returns false if the queue is empty
+    bool tryPop(T& elem) {
+        lock_guard<mutex> lock(mtx);
+        if (elements.empty()) return false;
+        elem = elements.front();
+        elements.pop_front();
+        approximateSize.store(elements.size(), memory_order_relaxed);
         cv.notify_one();
-        return elem;
+        return true;
     }
 
-    size_t size() const {
+    // Wakes every blocked caller for shutdown. Later pushes are discarded and
+    // pop() throws once the remaining elements have been drained.
+    void close() {
         lock_guard<mutex> lock(mtx);
-        return elements.size();
+        closed = true;
+        cv.notify_all();
     }
 
-    bool empty() const {
+    bool isClosed() const {
         lock_guard<mutex> lock(mtx);
-        return elements.empty();
+        return closed;
     }
 
+    // Copy of the current elements, front first
+    vector<T> contents() const {
+        lock_guard<mutex> lock(mtx);
+        return vector<T>(elements.begin(), elements.end());
+    }
+
+    // Lock-free, possibly stale (see class comment)
+    size_t size() const { return approximateSize.load(memory_order_relaxed); }
+
+    // Lock-free, possibly stale (see class comment)
+    bool empty() const { return size() == 0; }
+
     int getId() const { return uniqueId; }
 
-    int getMaxCapacity() const { return maxCapacity; }
+    int getMaxCapacity() const { return maxCapacity.load(); }
+
+    OverflowPolicy getOverflowPolicy() const {
+        lock_guard<mutex> lock(mtx);
+        return policy;
+    }
+
+    // Switching away from BLOCK releases blocked pushers under the new policy
+    void setOverflowPolicy(OverflowPolicy newPolicy) {
+        lock_guard<mutex> lock(mtx);
+        policy = newPolicy;
+        cv.notify_all();
+    }
+
+    // Elements discarded by DROP_NEWEST and DROP_OLDEST
+    uint64_t droppedCount() const { return dropped.load(memory_order_relaxed); }
+    // Pushes refused by REJECT
+    uint64_t rejectedCount() const { return rejected.load(memory_order_relaxed); }
+    // Queued elements removed by DROP_OLDEST (included in droppedCount); they
+    // left the queue without being popped
+    uint64_t evictedCount() const { return evicted.load(memory_order_relaxed); }
+
+    // Changes the capacity of a live queue. Growing it wakes blocked pushers;
+    // shrinking keeps the elements already queued and only blocks new pushes.
+    void setMaxCapacity(int capacity) {
+        lock_guard<mutex> lock(mtx);
+        maxCapacity = capacity;
+        cv.notify_all();
+    }
 
    private:
-    queue<T> elements;
+    // Callers hold mtx
+    bool full() const { return elements.size() >= static_cast<size_t>(maxCapacity.load()); }
+    bool canPush() const { return closed || policy != OverflowPolicy::BLOCK || !full(); }
+
+    // Queues elem once a push may proceed, applying the overflow policy
+    PushResult pushLocked(const T& elem) {
+        if (closed) return PushResult::CLOSED;
+        PushResult result = PushResult::PUSHED;
+        if (full()) {
+            if (policy == OverflowPolicy::DROP_NEWEST) {
+                dropped.fetch_add(1, memory_order_relaxed);
+                return PushResult::DROPPED;
+            }
+            if (policy == OverflowPolicy::REJECT) {
+                rejected.fetch_add(1, memory_order_relaxed);
+                return PushResult::REJECTED;
+            }
+            // DROP_OLDEST; more than one element if the capacity was lowered
+            while (full() && !elements.empty()) {
+                elements.pop_front();
+                dropped.fetch_add(1, memory_order_relaxed);
+                evicted.fetch_add(1, memory_order_relaxed);
+            }
+            result = PushResult::EVICTED_OLDEST;
+        }
+        elements.push_back(elem);
+        approximateSize.store(elements.size(), memory_order_relaxed);
+        cv.notify_one();
+        return result;
+    }
+
+    T popLocked() {
+        T elem = elements.front();
+        elements.pop_front();
+        approximateSize.store(elements.size(), memory_order_relaxed);
+        cv.notify_one();
+        return elem;
+    }
+
+    deque<T> elements;
+    atomic<size_t> approximateSize{0};
     int uniqueId;
-    int maxCapacity;
+    atomic<int> maxCapacity;
+    OverflowPolicy policy;
+    atomic<uint64_t> dropped{0};
+    atomic<uint64_t> rejected{0};
+    atomic<uint64_t> evicted{0};
+    bool closed = false;
     mutable mutex mtx;
     condition_variable cv;
 };
@@ -0,0 +1,137 @@
+#ifndef QUEUE_REGISTRY_H
+#define QUEUE_REGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "hash_ring.h"
+
+class BaseThread;
+class DataThread;
+class FunctionThread;
+
+// Generator threads the processing threads pick their queues from, changeable
+// while they run.
+//
+// Readers never lock: they announce the current epoch in their own slot and
+// load an immutable snapshot through one atomic pointer. Writers serialize on
+// a mutex, publish a new snapshot and retire the old one (together with any
+// removed thread) tagged with a freshly advanced epoch. A retired object is
+// destroyed once every reader slot is either idle or announces a later epoch,
+// i.e. no reader can still hold a pointer to it. A reader blocked inside a
+// queue operation delays reclamation, not the writer; retired queues are
+// closed so such readers wake up.
+class QueueRegistry {
+   public:
+    struct Snapshot {
+        std::vector<DataThread*> dataThreads;
+        std::vector<FunctionThread*> functionThreads;
+        // Processing thread ids; in partitioned mode each generator is served
+        // by partitions.owner(generator id)
+        HashRing partitions;
+        uint64_t version = 0;  // number of changes published so far
+    };
+
+    class Reader;
+
+    // Read-side critical section; the snapshot stays valid until destruction
+    class ReadGuard {
+       public:
+        ~ReadGuard();
+        const Snapshot& operator*() const { return *snapshot; }
+        const Snapshot* operator->() const { return snapshot; }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+       private:
+        friend class Reader;
+        ReadGuard(std::atomic<uint64_t>& slot, const Snapshot* snapshot)
+            : slot(slot), snapshot(snapshot) {}
+
+        std::atomic<uint64_t>& slot;
+        const Snapshot* snapshot;
+    };
+
+    // Per-thread read handle; read sections of one reader must not nest
+    class Reader {
+       public:
+        ~Reader();
+        ReadGuard read();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+       private:
+        friend class QueueRegistry;
+        Reader(QueueRegistry& registry, std::atomic<uint64_t>& slot)
+            : registry(registry), slot(slot) {}
+
+        QueueRegistry& registry;
+        std::atomic<uint64_t>& slot;
+    };
+
+    QueueRegistry();
+    // Destroys every retired object; no reader may be active
+    ~QueueRegistry();
+
+    std::unique_ptr<Reader> registerReader();
+
+    // Makes the thread visible to readers; the caller keeps ownership
+    void add(DataThread* thread);
+    void add(FunctionThread* thread);
+    // Hides the thread from new readers and takes ownership, destroying it
+    // after the grace period. The thread should already be stopped and its
+    // queue closed. Returns false if it was not registered.
+    bool retire(std::unique_ptr<DataThread> thread);
+    bool retire(std::unique_ptr<FunctionThread> thread);
+    // Adds or removes a processing thread from the partition ring; readers
+    // pick up the rebalanced ownership with the next snapshot
+    void addPartitionOwner(int processingId);
+    void removePartitionOwner(int processingId);
+    // Processing thread serving the generator in partitioned mode, -1 if none
+    int partitionOwner(int generatorId) const;
+
+    // Destroys the retired objects no reader can reach any more
+    void reclaim();
+    // Waits until every retired object has been destroyed
+    void synchronize();
+
+    size_t retiredCount() const;
+    uint64_t getVersion() const;
+
+    QueueRegistry(const QueueRegistry&) = delete;
+    QueueRegistry& operator=(const QueueRegistry&) = delete;
+
+   private:
+    // 0 while the reader is outside a read section, else the epoch it entered in
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};
+        bool inUse = false;
+    };
+    struct Retired {
+        uint64_t epoch;
+        std::unique_ptr<Snapshot> snapshot;
+        std::unique_ptr<BaseThread> thread;
+    };
+
+    std::atomic<Snapshot*> current;
+    std::atomic<uint64_t> epoch{1};
+    mutable std::mutex writeMtx;  // writers, reader registration and the retired list
+    std::deque<ReaderSlot> slots;  // deque: slots never move once handed out
+    std::vector<Retired> retired;
+
+    template <typename Thread>
+    bool retireThread(std::unique_ptr<Thread> thread,
+                      std::vector<Thread*> Snapshot::*member);
+    // Publishes next and retires the previous snapshot (and thread); writeMtx held
+    void publish(std::unique_ptr<Snapshot> next, std::unique_ptr<BaseThread> thread);
+    // Moves the unreachable retired objects to out; writeMtx held
+    void collectLocked(std::vector<Retired>& out);
+};
+
+#endif  // QUEUE_REGISTRY_H
@@ -0,0 +1,73 @@
+#ifndef QUEUE_SAMPLER_H
+#define QUEUE_SAMPLER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "queue.h"
+
+// Background sampler of queue occupancy. Every interval it reads the lock-free
+// size of each registered queue and stores one row in a ring buffer; when the
+// buffer is full the oldest rows are overwritten.
+class QueueSampler {
+   public:
+    QueueSampler(std::chrono::milliseconds interval, size_t maxSamples = 100000);
+    ~QueueSampler();
+
+    // Queues must be registered before start() and outlive the sampler
+    template <typename T>
+    void addQueue(const Queue<T>& queue, const std::string& kind) {
+        sources.push_back({queue.getId(), kind, [&queue] { return queue.size(); }});
+    }
+
+    void start();
+    void stop();
+
+    // Takes one sample immediately (also used by the sampling thread)
+    void sampleNow();
+
+    size_t sampleCount() const;
+    // Sizes of the queue at position queueIndex, oldest first
+    std::vector<uint32_t> samplesFor(size_t queueIndex) const;
+
+    // One row per sample: time_ms, then one column per queue; false on I/O error
+    bool writeCsv(const std::string& path) const;
+
+    QueueSampler(const QueueSampler&) = delete;
+    QueueSampler& operator=(const QueueSampler&) = delete;
+
+   private:
+    struct Source {
+        int queueId;
+        std::string kind;
+        std::function<size_t()> read;
+    };
+
+    std::chrono::milliseconds interval;
+    size_t maxSamples;
+    std::vector<Source> sources;
+    std::chrono::steady_clock::time_point startTime;
+
+    // Ring buffer: row r occupies values[r * sources.size() ...]
+    std::vector<uint32_t> values;
+    std::vector<int64_t> timestampsUs;
+    size_t nextRow = 0;
+    size_t rowCount = 0;
+
+    std::thread samplerThread;
+    std::atomic<bool> running{false};
+    mutable std::mutex mtx;
+    std::condition_variable cv;
+
+    void sampleLoop();
+    size_t rowIndex(size_t sample) const;
+};
+
+#endif  // QUEUE_SAMPLER_H
@@ -0,0 +1,127 @@
+#ifndef REORDER_BUFFER_H
+#define REORDER_BUFFER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+#include "threads.h"
+
+// One applied function, released in its generator's order
+struct OrderedResult {
+    int stream = 0;         // id of the FunctionThread that generated the function
+    uint64_t sequence = 0;  // its ArithmeticFunction::sequence, 0 when unsequenced
+    DataValue result;
+    std::string text;  // function, parameters and result as in the processing log
+};
+
+// Receives released results; called from processing threads, one result of a
+// stream at a time but concurrently for different streams
+using OrderedSink = std::function<void(const OrderedResult&)>;
+
+struct ReorderConfig {
+    size_t capacity = 1024;  // results held per stream before completers wait
+    // How long results wait behind a missing sequence before it is given up
+    std::chrono::milliseconds gapTimeout{1000};
+};
+
+// Shared by the buffers of one pipeline
+struct ReorderMetrics {
+    std::atomic<uint64_t> released{0};
+    std::atomic<uint64_t> gaps{0};      // sequences given up after the gap timeout
+    std::atomic<uint64_t> late{0};      // results that arrived after their gap was given up
+    std::atomic<uint64_t> maxDepth{0};  // most results one buffer held at once
+    LatencyHistogram delay;             // completion to release
+};
+
+// Releases the results of one FunctionThread in sequence order while any
+// number of processing threads complete them out of order.
+//
+// A completer writes its result into the slot its sequence maps to
+// (sequences are unique, so slots need no claiming) without locking, and then
+// tries to become the drainer. Draining is serialized by a flag taken with
+// an atomic exchange, i.e. a spinlock that completers only try: one that finds
+// it taken leaves its result to the holder, which re-checks the head after
+// stepping down, so a result stored meanwhile is never stranded. The drainer
+// only moves released results to a staging list; late results and window
+// moves spin on the flag, but it is never held across user code.
+//
+// The sink runs outside the flag, called by whichever completer wins a second
+// tried flag, the emitter, which delivers staged results in order until none
+// are left. Completers never wait for the sink; only flush() does.
+//
+// Functions that are consumed but not applied are reported with skip().
+// Anything else missing (e.g. evicted by the drop-oldest overflow policy) is
+// given up once later results, or a completer waiting for the window to
+// reach its sequence, have waited gapTimeout; if it still arrives it is
+// released immediately and counted as late.
+class ReorderBuffer {
+   public:
+    ReorderBuffer(int stream, OrderedSink sink, const ReorderConfig& config = {},
+                  ReorderMetrics* metrics = nullptr);
+    ~ReorderBuffer();
+
+    // Result of the function with the given sequence; 0 is released at once
+    void complete(uint64_t sequence, DataValue result, std::string text);
+    // The function with this sequence will never complete
+    void skip(uint64_t sequence);
+    // Releases everything held, giving up on all gaps, and waits until the sink
+    // has received it; no completer may be active
+    void flush();
+
+    // Next sequence to release and number of results held
+    uint64_t getHead() const { return head.load(); }
+    size_t depth() const { return pending.load(); }
+
+    ReorderBuffer(const ReorderBuffer&) = delete;
+    ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+   private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> sequence{0};  // of the held result, 0 while empty
+        bool skipped = false;
+        DataValue result;
+        std::string text;
+        std::chrono::steady_clock::time_point completedAt;
+    };
+
+    int stream;
+    OrderedSink sink;
+    ReorderConfig config;
+    ReorderMetrics* metrics;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> head{1};
+    std::atomic<size_t> pending{0};
+    std::atomic<bool> draining{false};
+    // Drainer only: when the head was first found missing with results behind it
+    std::chrono::steady_clock::time_point stalledSince{};
+
+    struct Staged {
+        uint64_t sequence;
+        DataValue result;
+        std::string text;
+        std::chrono::steady_clock::time_point completedAt;
+    };
+    std::vector<Staged> staged;  // released in order, not yet emitted; draining held
+    std::atomic<size_t> unemitted{0};
+    std::atomic<bool> emitting{false};
+
+    void store(uint64_t sequence, bool skipped, DataValue result, std::string text);
+    // Queues a result for the sink; draining held
+    void stage(uint64_t sequence, DataValue result, std::string text,
+               std::chrono::steady_clock::time_point completedAt);
+    void release(Staged& result);
+    void drain();
+    // Passes staged results to the sink unless another thread is doing so
+    void emit();
+    // Releases from the head while possible, giving up missing sequences
+    // below releaseBefore regardless of the gap timeout; draining held
+    void releaseReady(bool giveUpGaps, uint64_t releaseBefore = 0);
+};
+
+#endif  // REORDER_BUFFER_H
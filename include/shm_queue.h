@@ -0,0 +1,248 @@
+#ifndef SHM_QUEUE_H
+#define SHM_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Named shared-memory segments (shm_open + mmap). Create replaces a stale
+// segment of the same name; both return nullptr if shared memory is not
+// available.
+void* shmCreate(const std::string& name, size_t size);
+void* shmAttach(const std::string& name, size_t& size);
+void shmUnmap(void* memory, size_t size);
+void shmUnlink(const std::string& name);
+
+// Process-shared futex on a word in shared memory: shmWait sleeps while the
+// word still holds expected (or until the timeout), shmWake wakes up to count
+// sleepers. Other platforms poll with short sleeps.
+void shmWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::milliseconds timeout);
+void shmWake(std::atomic<uint32_t>& word, int count);
+
+// Bounded blocking FIFO in a shared-memory segment, for connecting processes.
+// The ring is the lock-free MPMC array of per-slot sequence numbers, so no
+// lock can be left held by a crashed process. Blocked callers sleep on futex
+// words that every push/pop bumps; the wake syscall is only made when a
+// sleeper has announced itself. Sleeps are bounded so a peer that dies
+// between bump and wake costs latency, not a hang. Elements are copied byte
+// by byte, hence the trivially copyable requirement; DataValue and
+// ArithmeticFunction qualify (steady_clock is system-wide on Linux, so
+// ArithmeticFunction::generatedAt stays meaningful in the consumer).
+template <typename T>
+class ShmQueue {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "ShmQueue elements are copied between processes byte by byte");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                      std::atomic<uint32_t>::is_always_lock_free,
+                  "ShmQueue counters must be lock-free to live in shared memory");
+
+   public:
+    // Creates the segment; the creator unlinks the name when destroyed
+    static std::unique_ptr<ShmQueue> create(const std::string& name, int capacity) {
+        if (capacity <= 0) throw std::invalid_argument("ShmQueue capacity must be positive");
+        size_t size = segmentSize(capacity);
+        void* memory = shmCreate(name, size);
+        if (!memory) return nullptr;
+        Header* header = new (memory) Header();
+        header->capacity = static_cast<uint32_t>(capacity);
+        header->elementSize = sizeof(T);
+        Slot* slots = reinterpret_cast<Slot*>(header + 1);
+        for (int i = 0; i < capacity; ++i) new (&slots[i]) Slot{{static_cast<uint64_t>(i)}, T()};
+        // Attachers check the magic last, once the segment is complete
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = MAGIC;
+        return std::unique_ptr<ShmQueue>(new ShmQueue(name, memory, size, true));
+    }
+
+    // Attaches to a segment created by another process; nullptr if it is
+    // missing or holds a different element type
+    static std::unique_ptr<ShmQueue> attach(const std::string& name) {
+        size_t size = 0;
+        void* memory = shmAttach(name, size);
+        if (!memory) return nullptr;
+        const Header* header = static_cast<const Header*>(memory);
+        if (size < sizeof(Header) || header->magic != MAGIC || header->elementSize != sizeof(T) ||
+            size < segmentSize(static_cast<int>(header->capacity))) {
+            shmUnmap(memory, size);
+            return nullptr;
+        }
+        return std::unique_ptr<ShmQueue>(new ShmQueue(name, memory, size, false));
+    }
+
+    ~ShmQueue() {
+        shmUnmap(memory, mappedSize);
+        if (owner) shmUnlink(name);
+    }
+
+    // Blocks while full; discards the element once the queue is closed
+    void push(const T& elem) {
+        while (!isClosed()) {
+            uint32_t seen = header->popSignal.load(std::memory_order_acquire);
+            if (tryPush(elem)) return;
+            header->pushWaiters.fetch_add(1);
+            shmWait(header->popSignal, seen, WAIT_TIMEOUT);
+            header->pushWaiters.fetch_sub(1);
+        }
+    }
+
+    // Blocks while empty; throws std::runtime_error once the queue is closed
+    // and drained
+    T pop() {
+        while (true) {
+            if (std::optional<T> elem = popFor(WAIT_TIMEOUT)) return *elem;
+        }
+    }
+
+    // Like pop(), but returns nullopt if no element arrived within timeout
+    std::optional<T> popFor(std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        T elem;
+        while (true) {
+            uint32_t seen = header->pushSignal.load(std::memory_order_acquire);
+            if (tryPop(elem)) return elem;
+            if (isClosed()) {
+                if (tryPop(elem)) return elem;
+                throw std::runtime_error("Queue closed");
+            }
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) return std::nullopt;
+            header->popWaiters.fetch_add(1);
+            shmWait(header->pushSignal, seen, std::min(left, WAIT_TIMEOUT));
+            header->popWaiters.fetch_sub(1);
+        }
+    }
+
+    bool tryPush(const T& elem) {
+        uint64_t position = header->enqueuePosition.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position % header->capacity];
+            uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            int64_t difference = static_cast<int64_t>(sequence - position);
+            if (difference == 0) {
+                if (header->enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                                  std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;  // full
+            } else {
+                position = header->enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        slot->value = elem;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        signal(header->pushSignal, header->popWaiters);
+        return true;
+    }
+
+    bool tryPop(T& elem) {
+        uint64_t position = header->dequeuePosition.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position % header->capacity];
+            uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            int64_t difference = static_cast<int64_t>(sequence - (position + 1));
+            if (difference == 0) {
+                if (header->dequeuePosition.compare_exchange_weak(position, position + 1,
+                                                                  std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;  // empty
+            } else {
+                position = header->dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+        elem = slot->value;
+        slot->sequence.store(position + header->capacity, std::memory_order_release);
+        signal(header->popSignal, header->pushWaiters);
+        return true;
+    }
+
+    // Wakes every blocked caller in every process (see Queue::close)
+    void close() {
+        header->closed.store(1);
+        header->pushSignal.fetch_add(1);
+        header->popSignal.fetch_add(1);
+        shmWake(header->pushSignal, INT_MAX);
+        shmWake(header->popSignal, INT_MAX);
+    }
+
+    bool isClosed() const { return header->closed.load() != 0; }
+
+    // Lock-free, possibly stale (see Queue)
+    size_t size() const {
+        uint64_t popped = header->dequeuePosition.load(std::memory_order_relaxed);
+        uint64_t pushed = header->enqueuePosition.load(std::memory_order_relaxed);
+        return pushed > popped ? static_cast<size_t>(pushed - popped) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    int getMaxCapacity() const { return static_cast<int>(header->capacity); }
+
+    const std::string& getName() const { return name; }
+
+    ShmQueue(const ShmQueue&) = delete;
+    ShmQueue& operator=(const ShmQueue&) = delete;
+
+   private:
+    static constexpr uint32_t MAGIC = 0x51485350;  // "PSHQ"
+    static constexpr std::chrono::milliseconds WAIT_TIMEOUT{100};
+
+    struct Header {
+        uint32_t magic = 0;
+        uint32_t capacity = 0;
+        uint32_t elementSize = 0;
+        std::atomic<uint32_t> closed{0};
+        // Producers and consumers on separate cache lines
+        alignas(64) std::atomic<uint64_t> enqueuePosition{0};
+        std::atomic<uint32_t> pushSignal{0};  // bumped by every push, consumers sleep on it
+        std::atomic<uint32_t> popWaiters{0};
+        alignas(64) std::atomic<uint64_t> dequeuePosition{0};
+        std::atomic<uint32_t> popSignal{0};  // bumped by every pop, producers sleep on it
+        std::atomic<uint32_t> pushWaiters{0};
+    };
+
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        T value;
+    };
+
+    std::string name;
+    void* memory;
+    size_t mappedSize;
+    bool owner;
+    Header* header;
+    Slot* slots;
+
+    ShmQueue(const std::string& name, void* memory, size_t mappedSize, bool owner)
+        : name(name),
+          memory(memory),
+          mappedSize(mappedSize),
+          owner(owner),
+          header(static_cast<Header*>(memory)),
+          slots(reinterpret_cast<Slot*>(header + 1)) {}
+
+    static size_t segmentSize(int capacity) {
+        return sizeof(Header) + static_cast<size_t>(capacity) * sizeof(Slot);
+    }
+
+    // The bump is seen by any sleeper that announced itself before this load
+    static void signal(std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiters) {
+        word.fetch_add(1);
+        if (waiters.load() > 0) shmWake(word, 1);
+    }
+};
+
+#endif  // SHM_QUEUE_H
@@ -0,0 +1,58 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <cstdint>
+#include <vector>
+
+#include "pipeline.h"
+
+// CPU cost of each step of the work loops, in nanoseconds
+struct ServiceTimes {
+    double generateNs = 1000;  // create a value/function and push it
+    double transferNs = 500;   // pop from one data queue and push to another
+    double applyNs = 1000;     // pop a function and its arguments and evaluate it
+    double selectNs = 100;     // pick a queue pair and check the queues
+};
+
+// Measures ServiceTimes with single-threaded microbenchmarks of the real code
+// paths (Queue push/pop, ArithmeticFunction::apply)
+ServiceTimes calibrateServiceTimes(int iterations = 200000);
+
+struct SimulationConfig {
+    PipelineConfig pipeline;
+    ServiceTimes service;
+    double warmupSeconds = 0.25;   // simulated time excluded from the results
+    double durationSeconds = 1.0;  // measured simulated time
+    uint64_t seed = 1;
+};
+
+struct SimulationResult {
+    double seconds = 0;  // measured simulated time
+    int64_t functionsApplied = 0;
+    double throughput = 0;  // applied functions per simulated second
+    // Generation-to-result latency of functions applied in the measured window
+    double latencyP50Us = 0;
+    double latencyP99Us = 0;
+    double latencyMeanUs = 0;
+    // Time-averaged queue lengths over the measured window
+    std::vector<double> dataQueueLengths;
+    std::vector<double> functionQueueLengths;
+    double meanDataQueueLength = 0;
+    double meanFunctionQueueLength = 0;
+    // Functions popped without enough data values (dropped, as in ProcessingThread)
+    int64_t functionsDropped = 0;
+    // Transfers whose destination stayed full for queueWait; the value went back
+    // to its source, or was lost if that had filled up meanwhile
+    int64_t transfersRefused = 0;
+    int64_t valuesLost = 0;
+};
+
+// Discrete-event model of Pipeline: generators push at their pacing interval
+// and block on full queues; processing threads pick two random distinct queues
+// per iteration exactly like ProcessingThread (transfer, apply or ignore), wait
+// up to queueWait on full transfer destinations (not at all when busy-polling)
+// before putting the value back, and sleep at their pacing interval. No real
+// threads are created, so configurations far beyond the machine can be sized.
+SimulationResult simulate(const SimulationConfig& config);
+
+#endif  // SIMULATOR_H
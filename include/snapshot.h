@@ -0,0 +1,40 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+
+// Contents of every data and function queue of a pipeline, front first
+struct QueueSnapshot {
+    std::vector<std::vector<DataValue>> dataQueues;
+    std::vector<std::vector<ArithmeticFunction>> functionQueues;
+
+    size_t valueCount() const;
+    size_t functionCount() const;
+};
+
+// Copies the queue contents without removing them; call after Pipeline::stop()
+// for a consistent picture
+QueueSnapshot captureSnapshot(const Pipeline& pipeline);
+
+// Writes the snapshot to a temporary file, syncs it and renames it over path,
+// then syncs the directory, so a crash never leaves a half-written snapshot.
+// Returns false on I/O errors.
+bool saveSnapshot(const std::string& path, const QueueSnapshot& snapshot);
+
+// Maps the snapshot file and decodes it in place. Returns false if the file
+// is missing, not a snapshot or damaged.
+bool loadSnapshot(const std::string& path, QueueSnapshot& snapshot);
+
+// Preloads the snapshot into the pipeline's generator queues (see
+// Pipeline::preloadQueues); call before the generator threads start, so
+// restored elements are queued ahead of new ones. Snapshot queue i goes to
+// thread i modulo the configured thread count, so a snapshot also restores
+// into a different topology. Restored functions count their latency from now.
+// Returns the number of elements that exceed their queue's capacity and are
+// not restored.
+size_t restoreSnapshot(const QueueSnapshot& snapshot, Pipeline& pipeline);
+
+#endif  // SNAPSHOT_H
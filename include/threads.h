@@ -2,7 +2,9 @@
 #define THREADS_H
 
 #include <atomic>
+#include <chrono>
 #include <complex>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -13,7 +15,11 @@
 #include <variant>
 #include <vector>
 
+#include "live_stats.h"
+#include "metrics.h"
 #include "queue.h"
+#include "queue_registry.h"
+#include "random.h"
 
 // Data types that threads can generate
 using DataValue = std::variant<int, float, std::complex<double>>;
@@ -22,6 +28,69 @@ using DataValue = std::variant<int, float, std::complex<double>>;
 constexpr int DATA_MIN_VALUE = -100;
 constexpr int DATA_MAX_VALUE = 100;
 
+// Delay between iterations of a work loop: base + (threadId % spread) * step
+struct Pacing {
+    std::chrono::microseconds base;
+    std::chrono::microseconds step;
+    int spread;
+
+    std::chrono::microseconds delayFor(int threadId) const;
+    // Same shape with every delay multiplied by factor (0 disables pacing)
+    Pacing scaled(double factor) const;
+};
+
+// Default pacing of each thread type
+constexpr Pacing DATA_PACING{std::chrono::milliseconds(200), std::chrono::milliseconds(50), 5};
+constexpr Pacing FUNCTION_PACING{std::chrono::milliseconds(300), std::chrono::milliseconds(75),
+                                 5};
+constexpr Pacing PROCESSING_PACING{std::chrono::milliseconds(100), std::chrono::milliseconds(50),
+                                   3};
+
+// Longest a processing thread waits on any one queue before moving on
+constexpr std::chrono::milliseconds PROCESSING_QUEUE_WAIT{100};
+
+// Random generator of each thread, seeded by SeedService (CMake option PT_MT19937
+// selects std::mt19937 instead)
+#ifdef PT_MT19937
+using ThreadRng = std::mt19937;
+#else
+using ThreadRng = Xoshiro128;
+#endif
+
+// Scheduling of a processing thread for latency-critical runs (see
+// low_latency.h). The default profile changes nothing.
+struct LowLatencyProfile {
+    bool busyPoll = false;   // spin on non-blocking queue operations, never sleep or park
+    std::vector<int> cpus;   // CPUs the thread is pinned to, empty for no pinning
+    int fifoPriority = 0;    // > 0 requests SCHED_FIFO at this priority
+};
+
+// Micro-batching of a processing thread: it takes up to maxFunctions
+// functions from one queue, waiting at most maxDelay after the first for more
+// to arrive, and applies them bucketed by operation and operand types (see
+// batch.h). maxFunctions <= 1 applies one function at a time.
+struct BatchConfig {
+    size_t maxFunctions = 1;
+    std::chrono::microseconds maxDelay{1000};
+};
+
+struct BatchStats {
+    uint64_t batches = 0;
+    uint64_t functions = 0;
+    uint64_t buckets = 0;  // (operation, operand types) groups run by the batch kernel
+
+    double meanSize() const { return batches > 0 ? static_cast<double>(functions) / batches : 0; }
+    BatchStats& operator+=(const BatchStats& other) {
+        batches += other.batches;
+        functions += other.functions;
+        buckets += other.buckets;
+        return *this;
+    }
+};
+
+// Verbosity of thread logging, shared by all threads
+enum class LogLevel { OFF, ERRORS, ALL };
+
 // Arithmetic operations
 enum class Operation { ADD, SUBTRACT, MULTIPLY, DIVIDE };
 
@@ -30,6 +99,9 @@ struct ArithmeticFunction {
     Operation op;
     std::optional<DataValue> left_operand;   // if present, use this as left operand
     std::optional<DataValue> right_operand;  // if present, use this as right operand
+    std::chrono::steady_clock::time_point generatedAt{};  // set when pushed to its queue
+    // Position among the functions its FunctionThread queued, from 1; 0 if unsequenced
+    uint64_t sequence = 0;
 
     // How many arguments this function needs from the data queue
     size_t requiredArgs() const;
@@ -37,24 +109,49 @@ struct ArithmeticFunction {
     // String representation of the function
     std::string description() const;
 
+    // Evaluates the function; args supplies the missing operands in order.
+    // Throws std::runtime_error on division by zero.
+    DataValue apply(const std::vector<DataValue>& args) const;
+
+    // Operands apply() uses, taking the missing ones from args
+    const DataValue& leftOperand(const std::vector<DataValue>& args) const;
+    const DataValue& rightOperand(const std::vector<DataValue>& args) const;
+
    private:
     std::string valueToString(const DataValue& val) const;
 };
 
+// Supply elements in place of a generator thread's random generation, e.g.
+// from another process. A source blocks until it has an element and returns
+// false once it is exhausted, which ends the thread.
+using DataSource = std::function<bool(DataValue&)>;
+using FunctionSource = std::function<bool(ArithmeticFunction&)>;
+
 // Forward declarations
 class DataThread;
 class FunctionThread;
+class MemoCache;
+class ReorderBuffer;
 
 // Base thread class
 class BaseThread {
    protected:
     int threadId;
     std::thread workerThread;
+    // getTypeName() as recorded by run(); the destructor cannot call it
+    const char* runningType = nullptr;
     std::atomic<bool> shouldStop{false};
 
     // Random number generation
-    std::random_device rd;
-    std::mt19937 gen;
+    ThreadRng gen;
+
+    // Live statistics slot, nullptr unless live stats are enabled
+    ThreadStats* liveStats = nullptr;
+
+    // Pause between work loop iterations, changeable while running
+    std::atomic<std::chrono::microseconds> delay{std::chrono::microseconds(0)};
+    // Fraction of the paced rate a generator runs at (see BackpressureController)
+    std::atomic<double> throttle{1.0};
 
    public:
     BaseThread(int id);
@@ -62,33 +159,81 @@ class BaseThread {
 
     void start();
     void stop();
+    // Waits for the worker to exit; stop() must have been called
+    void join();
     int getId() const;
     bool isRunning() const;
+    virtual const char* getTypeName() const = 0;
+
+    // Takes effect from the next iteration
+    void setDelay(std::chrono::microseconds value) { delay = value; }
+    std::chrono::microseconds getDelay() const { return delay.load(); }
+    // Generators pause delay / throttle between items; 1 keeps the paced rate
+    void setThrottle(double value) { throttle = value; }
+    double getThrottle() const { return throttle.load(); }
+
+    static void setLogLevel(LogLevel level);
+    static LogLevel getLogLevel();
 
    protected:
     virtual void workLoop() = 0;
-    void log(const std::string& message);
+    void log(const std::string& message, LogLevel level = LogLevel::ALL);
+    // Lets callers skip building messages that would not be printed
+    static bool shouldLog(LogLevel level);
+    // Sleeps on behalf of the work loop (recorded as a SLEEP span when tracing)
+    void sleepFor(std::chrono::microseconds duration);
+    // The delay stretched by the throttle
+    std::chrono::microseconds throttledDelay() const;
+
+   private:
+    static std::atomic<LogLevel> logLevel;
+
+    // Worker entry point: per-thread instrumentation, then workLoop()
+    void run();
 };
 
 // Data generation thread
 class DataThread : public BaseThread {
    public:
-    DataThread(int id, int queueCapacity = 50);
+    // With a source the thread forwards its elements unpaced instead of
+    // generating. initial is queued before the worker starts (e.g. a restored
+    // snapshot); elements beyond the capacity are dropped.
+    DataThread(int id, int queueCapacity = 50, const Pacing& pacing = DATA_PACING,
+               DataSource source = nullptr, OverflowPolicy overflow = OverflowPolicy::BLOCK,
+               const std::vector<DataValue>& initial = {});
     ~DataThread();
 
+    const char* getTypeName() const override;
+
     int getQueueId() const;
     size_t getQueueSize() const;
     bool isQueueEmpty() const;
+    const Queue<DataValue>& getQueue() const;
+    // Wakes threads blocked on the queue for shutdown (see Queue::close)
+    void closeQueue();
 
     // For testing - consume a value from the queue
     DataValue popValue();
-    void pushValue(const DataValue& value);
+    // Follows the queue's overflow policy
+    PushResult pushValue(const DataValue& value);
+    // Bounded waits (see Queue::popFor and Queue::pushFor)
+    std::optional<DataValue> popValueFor(std::chrono::microseconds timeout);
+    PushResult pushValueFor(const DataValue& value, std::chrono::microseconds timeout);
+    // Non-blocking push; false if the queue is full (see Queue::tryPush)
+    bool tryPushValue(const DataValue& value);
+    // Non-blocking pop; false if the queue is empty
+    bool tryPopValue(DataValue& value);
+    // See Queue::setMaxCapacity and Queue::setOverflowPolicy
+    void setQueueCapacity(int capacity);
+    void setOverflowPolicy(OverflowPolicy policy);
 
    protected:
     void workLoop() override;
 
    private:
     std::unique_ptr<Queue<DataValue>> dataQueue;
+    QueueStats* queueStats = nullptr;
+    DataSource source;
     // Random generators for different data types
     std::uniform_int_distribution<> typeSelector;
     std::uniform_int_distribution<> intGenerator;
@@ -102,21 +247,50 @@ class DataThread : public BaseThread {
 // Function generation thread
 class FunctionThread : public BaseThread {
    public:
-    FunctionThread(int id, int queueCapacity = 50);
+    // With a source the thread forwards its elements unpaced instead of
+    // generating; their generatedAt is kept. initial is queued as in DataThread.
+    FunctionThread(int id, int queueCapacity = 50, const Pacing& pacing = FUNCTION_PACING,
+                   FunctionSource source = nullptr,
+                   OverflowPolicy overflow = OverflowPolicy::BLOCK,
+                   const std::vector<ArithmeticFunction>& initial = {});
     ~FunctionThread();
 
+    const char* getTypeName() const override;
+
     int getQueueId() const;
     size_t getQueueSize() const;
     bool isQueueEmpty() const;
+    const Queue<ArithmeticFunction>& getQueue() const;
+    // Wakes threads blocked on the queue for shutdown (see Queue::close)
+    void closeQueue();
 
     // For testing - consume a function from the queue
     ArithmeticFunction popFunction();
+    // Follows the queue's overflow policy
+    PushResult pushFunction(const ArithmeticFunction& func);
+    // Bounded wait (see Queue::popFor)
+    std::optional<ArithmeticFunction> popFunctionFor(std::chrono::microseconds timeout);
+    // Non-blocking push; false if the queue is full (see Queue::tryPush)
+    bool tryPushFunction(const ArithmeticFunction& func);
+    bool tryPopFunction(ArithmeticFunction& func);
+    // See Queue::setMaxCapacity and Queue::setOverflowPolicy
+    void setQueueCapacity(int capacity);
+    void setOverflowPolicy(OverflowPolicy policy);
+    // Ordered output of this thread's functions; set before the thread is
+    // registered with processing threads. Held results are released when the
+    // thread is destroyed.
+    void setReorderBuffer(std::unique_ptr<ReorderBuffer> buffer);
+    ReorderBuffer* getReorderBuffer() const { return reorderBuffer.get(); }
 
    protected:
     void workLoop() override;
 
    private:
     std::unique_ptr<Queue<ArithmeticFunction>> functionQueue;
+    std::unique_ptr<ReorderBuffer> reorderBuffer;
+    uint64_t nextSequence = 1;
+    QueueStats* queueStats = nullptr;
+    FunctionSource source;
     // Random generators for function creation
     std::uniform_int_distribution<> operationSelector;  // 0-3 for +,-,*,/
     std::uniform_int_distribution<> patternSelector;    // 0-3 for different function patterns
@@ -129,12 +303,35 @@ class FunctionThread : public BaseThread {
     void logGeneratedFunction(const ArithmeticFunction& func);
 };
 
-// Processing thread - performs operations between queues
+// Queues a partitioned processing thread consumes
+struct QueuePartition {
+    std::vector<DataThread*> data;
+    std::vector<FunctionThread*> functions;
+};
+
+// The queues topology's hash ring assigns processingId. Owning queues of one
+// kind only, it also borrows the queue of the other kind nearest to it on the
+// ring, so every queue has exactly one owner and a thread borrows at most one.
+QueuePartition partitionFor(const QueueRegistry::Snapshot& topology, int processingId);
+
+// Processing thread - performs operations between queues. It picks them from
+// the registry on every iteration, so generators may come and go while it runs.
+// Partitioned threads only pick the queues of their partitionFor().
 class ProcessingThread : public BaseThread {
    public:
     ProcessingThread(int id, std::atomic<int>& processed, int maxFunctions,
-                     const std::vector<std::unique_ptr<DataThread>>& dataThreads,
-                     const std::vector<std::unique_ptr<FunctionThread>>& functionThreads);
+                     QueueRegistry& registry, const Pacing& pacing = PROCESSING_PACING,
+                     LatencyHistogram* latencies = nullptr, size_t memoEntries = 0,
+                     LowLatencyProfile lowLatency = {},
+                     std::chrono::microseconds queueWait = PROCESSING_QUEUE_WAIT,
+                     bool partitioned = false, BatchConfig batch = {});
+    ~ProcessingThread() override;
+
+    const char* getTypeName() const override;
+    // Result cache, present when created with memoEntries > 0
+    const MemoCache* getMemoCache() const { return memo.get(); }
+    // Not synchronized: read from another thread only after this one joined
+    BatchStats getBatchStats() const { return batchStats; }
 
    protected:
     void workLoop() override;
@@ -142,14 +339,30 @@ class ProcessingThread : public BaseThread {
    private:
     std::atomic<int>& functionsProcessed;
     int maxFunctions;
+    // Generation-to-result latency of applied functions, optional
+    LatencyHistogram* latencies;
+    std::unique_ptr<MemoCache> memo;
+    LowLatencyProfile lowLatency;
+    std::chrono::microseconds queueWait;
     std::uniform_int_distribution<> queueSelector;
-    // References to the actual thread pools
-    const std::vector<std::unique_ptr<DataThread>>& dataThreads;
-    const std::vector<std::unique_ptr<FunctionThread>>& functionThreads;
-
-    std::pair<int, int> selectTwoRandomQueues();
+    // Read handle on the generators to pick queues from
+    std::unique_ptr<QueueRegistry::Reader> registryReader;
+    bool partitioned;
+    // Queues owned in the snapshot of partitionVersion; valid while it is current
+    uint64_t partitionVersion = UINT64_MAX;
+    std::vector<DataThread*> ownedData;
+    std::vector<FunctionThread*> ownedFunctions;
+    BatchConfig batch;
+    BatchStats batchStats;
+
+    std::pair<int, int> selectTwoRandomQueues(int totalQueues);
+    void refreshPartition(const QueueRegistry::Snapshot& topology);
     void processDataToData(DataThread* source, DataThread* dest);
     void processFunctionWithData(FunctionThread* functionThread, DataThread* dataThread);
+    void processFunctionBatch(FunctionThread* functionThread, DataThread* dataThread);
+    void applyLowLatencyProfile();
+    // Pops for busy-polling: spins instead of blocking; false once stopped
+    bool spinPopValue(DataThread* dataThread, DataValue& value);
     DataValue applyFunction(const ArithmeticFunction& func, const std::vector<DataValue>& args);
     DataValue addValues(const DataValue& a, const DataValue& b);
     DataValue subtractValues(const DataValue& a, const DataValue& b);
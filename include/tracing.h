@@ -0,0 +1,92 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Activities recorded on the thread timeline
+enum class SpanType { GENERATE, PUSH_BLOCKED, POP_BLOCKED, APPLY, TRANSFER, SLEEP };
+
+// One completed activity, timestamps relative to the tracer epoch
+struct TraceSpan {
+    uint64_t startNs;
+    uint32_t durationNs;
+    SpanType type;
+};
+
+// Optional timeline recorder. Each thread appends to its own buffer, so
+// recording never contends with other threads; the buffers are merged into a
+// Chrome trace-event JSON file (chrome://tracing, ui.perfetto.dev) at exit.
+class Tracer {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    static Tracer& instance();
+
+    // Spans beyond maxSpansPerThread are counted as dropped
+    void enable(size_t maxSpansPerThread = 1 << 20);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Creates the calling thread's buffer; no-op while disabled
+    void attachCurrentThread(const std::string& threadType, int threadId);
+
+    // Appends a span to the calling thread's buffer (ignored for unattached threads)
+    void record(SpanType type, Clock::time_point start, Clock::time_point end);
+
+    size_t spanCount() const;
+    size_t droppedCount() const;
+
+    // Returns false if the file cannot be written
+    bool writeChromeTrace(const std::string& path) const;
+
+    static const char* spanName(SpanType type);
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+   private:
+    Tracer() = default;
+
+    struct ThreadBuffer {
+        std::string threadType;
+        int threadId;
+        std::vector<TraceSpan> spans;
+        size_t dropped = 0;
+        // Only contended while the trace is being written
+        mutable std::mutex mtx;
+    };
+
+    std::atomic<bool> enabled{false};
+    size_t maxSpans = 0;
+    Clock::time_point epoch;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    mutable std::mutex mtx;
+
+    static thread_local ThreadBuffer* currentBuffer;
+};
+
+// Records the enclosing scope as a span; costs one relaxed load when tracing is off
+class ScopedSpan {
+   public:
+    explicit ScopedSpan(SpanType type) : type(type), active(Tracer::instance().isEnabled()) {
+        if (active) start = Tracer::Clock::now();
+    }
+    ~ScopedSpan() {
+        if (active) Tracer::instance().record(type, start, Tracer::Clock::now());
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+   private:
+    SpanType type;
+    bool active;
+    Tracer::Clock::time_point start;
+};
+
+#endif  // TRACING_H
@@ -0,0 +1,119 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "threads.h"
+
+// Streams queue elements between processes over a UNIX-domain socket.
+//
+// Wire format: frames of [u32 length][u8 kind][u16 stream][u32 count][payload],
+// length counting everything after itself. DATA frames carry up to
+// TRANSPORT_MAX_BATCH encoded elements (codec.h) of one stream, so a busy
+// stream costs one write per batch rather than per element. Flow control is
+// credit based: the receiver grants each stream its local queue capacity and
+// returns a credit per consumed element, so the sender never has more in
+// flight than the remote queue can hold and the receiver never blocks. Each
+// side runs one epoll-driven I/O thread (Linux only; elsewhere connect/listen
+// fail).
+
+constexpr uint32_t TRANSPORT_MAX_BATCH = 256;
+
+struct TransportStats {
+    uint64_t frames = 0;
+    uint64_t elements = 0;
+    uint64_t bytes = 0;
+    uint64_t creditStalls = 0;  // sender: times a stream waited for credit
+};
+
+// Producer side: forwards elements taken from local sources
+class TransportSender {
+   public:
+    TransportSender();
+    ~TransportSender();
+
+    // Streams are numbered in the order they are added and must match the
+    // receiver's; add them all before connect()
+    void addStream(DataSource source);
+    void addStream(FunctionSource source);
+
+    // Connects, sends the stream layout and starts forwarding
+    bool connect(const std::string& path, std::string& error);
+    // False once the receiver closed the connection
+    bool isConnected() const { return connected.load(); }
+    // Sends what is pending, closes the connection and joins all threads.
+    // Sources must already be exhausted or closed, since a source blocked in
+    // pop cannot be interrupted from here.
+    void stop();
+
+    TransportStats getStats() const;
+
+    TransportSender(const TransportSender&) = delete;
+    TransportSender& operator=(const TransportSender&) = delete;
+
+   private:
+    struct Stream;
+
+    std::vector<std::unique_ptr<Stream>> streams;
+    int socketFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> connected{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> closing{false};  // pull threads are done, flush and close
+    std::thread ioThread;
+    mutable std::mutex statsMtx;
+    TransportStats stats;
+
+    void pullLoop(Stream& stream);
+    void ioLoop();
+    void wake();
+};
+
+// Consumer side: hands received elements to local sources
+class TransportReceiver {
+   public:
+    TransportReceiver();
+    ~TransportReceiver();
+
+    // Adds the next stream with a local queue of the given capacity and
+    // returns the source reading it. The source returns false once the
+    // sender disconnected and the queue is drained.
+    DataSource addDataStream(int capacity);
+    FunctionSource addFunctionStream(int capacity);
+
+    // Starts accepting one sender on path (replacing a stale socket file)
+    bool listen(const std::string& path, std::string& error);
+    bool isConnected() const { return connected.load(); }
+    // Closes the connection, which ends the sender, and joins the I/O thread
+    void stop();
+
+    TransportStats getStats() const;
+
+    TransportReceiver(const TransportReceiver&) = delete;
+    TransportReceiver& operator=(const TransportReceiver&) = delete;
+
+   private:
+    struct Stream;
+
+    std::vector<std::shared_ptr<Stream>> streams;
+    std::string socketPath;
+    int listenFd = -1;
+    int wakeFd = -1;
+    std::atomic<bool> connected{false};
+    std::atomic<bool> stopping{false};
+    std::thread ioThread;
+    mutable std::mutex statsMtx;
+    TransportStats stats;
+
+    void ioLoop();
+    void closeStreams();
+};
+
+#endif  // TRANSPORT_H
@@ -0,0 +1,96 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct WalOptions {
+    // Records are made durable by one fdatasync per interval for every writer
+    // (group commit); 0 syncs inside every append
+    std::chrono::microseconds commitInterval{1000};
+    // A new segment file is started once the current one reaches this size
+    size_t segmentBytes = 64 << 20;
+};
+
+struct WalStats {
+    uint64_t appends = 0;
+    uint64_t syncs = 0;
+    uint64_t bytes = 0;
+    size_t segments = 0;  // live segment files
+};
+
+// Segment-based write-ahead log of queue pushes and pop acknowledgements.
+// Every push gets a sequence number and every pop names the sequence it
+// removed, so recovery returns exactly the pushes that were never popped,
+// regardless of how concurrent pushers interleaved. Segments are files
+// wal-<n>.log in one directory; leading segments whose pushes have all been
+// popped are deleted. Each record carries a checksum and replay of a segment
+// stops at the first damaged record (a write torn by a crash).
+class WriteAheadLog {
+   public:
+    explicit WriteAheadLog(const WalOptions& options = WalOptions());
+    ~WriteAheadLog();
+
+    // Opens the log in directory (created if missing) and returns the pushes
+    // that were not popped, in sequence order. New records always go to a new
+    // segment. Returns false if the directory or a segment cannot be used.
+    bool open(const std::string& directory,
+              std::vector<std::pair<uint64_t, std::string>>& recovered);
+    // Makes every appended record durable and closes the files
+    void close();
+    bool isOpen() const;
+
+    // Appends a push of payload and stores its sequence number. Returns the
+    // log position to pass to waitDurable(). Throws std::runtime_error if the
+    // write fails.
+    uint64_t appendPush(const std::string& payload, uint64_t& sequence);
+    uint64_t appendPop(uint64_t sequence);
+
+    // Blocks until every record up to position is on stable storage
+    void waitDurable(uint64_t position);
+
+    WalStats getStats() const;
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+   private:
+    struct Segment {
+        uint64_t index;
+        uint64_t firstSequence;  // sequences from here on were pushed in this segment or later
+        uint64_t outstanding;    // pushes not yet popped
+    };
+
+    WalOptions options;
+    std::string directory;
+    std::vector<Segment> segments;
+    int fd = -1;
+    size_t segmentSize = 0;
+    std::vector<int> retiredFds;  // rotated segments awaiting their final sync
+    uint64_t nextSequence = 0;
+    uint64_t written = 0;  // log position: bytes appended since open
+    uint64_t durable = 0;
+    WalStats stats;
+
+    mutable std::mutex mtx;
+    std::condition_variable durableCv;
+    std::condition_variable commitCv;
+    bool stopping = false;
+    std::thread committer;
+
+    std::string segmentPath(uint64_t index) const;
+    bool startSegment(uint64_t index);
+    void rotateIfFull();
+    uint64_t append(uint8_t type, uint64_t sequence, const std::string& payload);
+    void acknowledge(uint64_t sequence);
+    void deletePoppedSegments();
+    void commitLoop();
+};
+
+#endif  // WAL_H
@@ -0,0 +1,195 @@
+#include "autotune.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+constexpr int MAX_PROCESSING_THREADS = 1024;
+// Queue large enough that no generator blocks during calibration
+constexpr int CALIBRATION_CAPACITY = 1 << 20;
+// Accepted share of pushes that find a function queue full
+constexpr double BLOCKING_PROBABILITY = 0.01;
+
+double secondsOf(chrono::microseconds duration) { return duration.count() / 1e6; }
+
+// Probabilities of one random pair of distinct queues being data+data and data+function
+double transferProbability(int nd, int nf) {
+    double n = nd + nf;
+    return n < 2 ? 0 : nd * (nd - 1.0) / (n * (n - 1));
+}
+
+double applyProbability(int nd, int nf) {
+    double n = nd + nf;
+    return n < 2 ? 0 : 2.0 * nd * nf / (n * (n - 1));
+}
+
+// CPU time of one processing iteration, excluding the pacing sleep
+double iterationCost(const PipelineConfig& config, const ServiceTimes& service) {
+    int nd = config.dataThreads, nf = config.functionThreads;
+    double ns = service.selectNs + transferProbability(nd, nf) * service.transferNs +
+                applyProbability(nd, nf) * service.applyNs;
+    return ns * 1e-9;
+}
+
+// Iterations per second of np processing threads with the Pipeline thread ids
+double poolIterationRate(const PipelineConfig& config, double cost, int np) {
+    double rate = 0;
+    for (int i = 0; i < np; ++i) {
+        rate += 1 / (cost + secondsOf(config.processingPacing.delayFor(i + 200)));
+    }
+    return rate;
+}
+
+struct QueueModel {
+    double utilization;
+    double latencySeconds;  // infinite when the queue is unstable
+    double serviceRate;     // pops per second of one function queue
+};
+
+QueueModel modelFunctionQueue(const PipelineConfig& config, const MeasuredRates& rates,
+                              double cost, int np) {
+    int nd = config.dataThreads, nf = config.functionThreads;
+    double arrival = rates.functionRate / nf;
+    // Each iteration takes from a given function queue if it pairs it with a data queue
+    double service = poolIterationRate(config, cost, np) * applyProbability(nd, nf) / nf;
+    QueueModel model;
+    model.serviceRate = service;
+    model.utilization = service > 0 ? arrival / service : INFINITY;
+    model.latencySeconds = service > arrival ? 1 / (service - arrival) : INFINITY;
+    return model;
+}
+
+}  // namespace
+
+MeasuredRates measureRates(const PipelineConfig& config, chrono::milliseconds duration) {
+    PipelineConfig generatorsOnly = config;
+    generatorsOnly.processingThreads = 0;
+    generatorsOnly.dataQueueCapacity = CALIBRATION_CAPACITY;
+    generatorsOnly.functionQueueCapacity = CALIBRATION_CAPACITY;
+
+    // The calibration run is not part of the output
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(min(previous, LogLevel::ERRORS));
+
+    MeasuredRates rates;
+    {
+        Pipeline pipeline(generatorsOnly);
+        auto startTime = chrono::steady_clock::now();
+        pipeline.startDataThreads();
+        pipeline.startFunctionThreads();
+        this_thread::sleep_for(duration);
+
+        // Nothing is consumed, so the queue sizes count every generated item
+        size_t values = 0, functions = 0;
+        for (const auto& thread : pipeline.getDataThreads()) values += thread->getQueueSize();
+        for (const auto& thread : pipeline.getFunctionThreads()) {
+            functions += thread->getQueueSize();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        pipeline.stop();
+        rates.dataRate = values / seconds;
+        rates.functionRate = functions / seconds;
+    }
+    BaseThread::setLogLevel(previous);
+
+    rates.service = calibrateServiceTimes();
+    int spread = max(1, config.processingPacing.spread);
+    double cost = iterationCost(config, rates.service);
+    rates.iterationSeconds = spread / poolIterationRate(config, cost, spread);
+    return rates;
+}
+
+AutoTuneResult sizePipeline(const PipelineConfig& config, const MeasuredRates& rates,
+                            const AutoTuneTarget& target) {
+    AutoTuneResult result;
+    result.rates = rates;
+    result.processingThreads = config.processingThreads;
+    result.dataQueueCapacity = calculateQueueCapacity(config.dataThreads);
+    result.functionQueueCapacity = calculateQueueCapacity(config.functionThreads);
+
+    // Without data and function queues no function is ever applied
+    if (config.dataThreads == 0 || config.functionThreads == 0 || rates.functionRate <= 0) {
+        return result;
+    }
+
+    double cost = iterationCost(config, rates.service);
+    double latencyTarget = target.latencyMs / 1000;
+    int np = 1;
+    QueueModel model = modelFunctionQueue(config, rates, cost, np);
+    for (; np < MAX_PROCESSING_THREADS; model = modelFunctionQueue(config, rates, cost, ++np)) {
+        bool met = latencyTarget > 0 ? model.latencySeconds <= latencyTarget
+                                     : model.utilization <= target.utilization;
+        if (met) break;
+    }
+
+    // Capacity k such that a M/M/1 queue holds more than k items with
+    // probability utilization^(k+1) <= BLOCKING_PROBABILITY
+    int capacity = 1;
+    if (model.utilization >= 1) {
+        capacity = calculateQueueCapacity(config.functionThreads);
+    } else if (model.utilization > 0) {
+        double k = ceil(log(BLOCKING_PROBABILITY) / log(model.utilization)) - 1;
+        capacity = static_cast<int>(max(1.0, k));
+    }
+    // A full queue should still drain within the latency target
+    if (latencyTarget > 0) {
+        capacity = min(capacity, max(1, static_cast<int>(model.serviceRate * latencyTarget)));
+    }
+
+    result.processingThreads = np;
+    result.functionQueueCapacity = capacity;
+    // Data queues must hold the arguments of the queued functions and keep the
+    // deadlock-avoiding minimum for transfers
+    result.dataQueueCapacity = max(calculateQueueCapacity(config.dataThreads), capacity);
+    result.utilization = model.utilization;
+    result.latencyMs = model.latencySeconds * 1000;
+    // Functions take one data value on average
+    result.dataLimited = rates.dataRate < rates.functionRate;
+    return result;
+}
+
+void printAutoTuneReport(ostream& out, const AutoTuneResult& result, const AutoTuneTarget& target) {
+    const MeasuredRates& rates = result.rates;
+    // The caller's number format is restored on return
+    ios_base::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << "Auto-tuning:" << endl;
+    out << fixed << setprecision(1);
+    out << "  Measured data rate: " << rates.dataRate << " values/s" << endl;
+    out << "  Measured function rate: " << rates.functionRate << " functions/s" << endl;
+    out << "  Service times (ns): select " << rates.service.selectNs << ", transfer "
+        << rates.service.transferNs << ", apply " << rates.service.applyNs << endl;
+    out << "  Processing iteration: " << rates.iterationSeconds * 1000 << " ms" << endl;
+    if (target.latencyMs > 0) {
+        out << "  Target: mean latency <= " << target.latencyMs << " ms" << endl;
+    } else {
+        out << "  Target: utilization <= " << setprecision(2) << target.utilization << endl;
+    }
+    out << setprecision(2);
+    out << "  Chosen processing threads: " << result.processingThreads << endl;
+    out << "  Chosen capacities: data " << result.dataQueueCapacity << ", function "
+        << result.functionQueueCapacity << endl;
+    if (result.utilization > 0) {
+        out << "  Predicted utilization: " << result.utilization << endl;
+        if (isfinite(result.latencyMs)) {
+            out << "  Predicted mean latency: " << result.latencyMs << " ms" << endl;
+        } else {
+            out << "  Predicted mean latency: unbounded (target not reachable)" << endl;
+        }
+    } else {
+        out << "  No functions can be applied with this topology; NP left unchanged" << endl;
+    }
+    if (result.dataLimited) {
+        out << "  Warning: data generation is slower than function generation; functions "
+               "will be dropped for lack of arguments"
+            << endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
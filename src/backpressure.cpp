@@ -0,0 +1,85 @@
+#include "backpressure.h"
+
+#include <algorithm>
+
+#include "threads.h"
+
+using namespace std;
+
+BackpressureController::BackpressureController(QueueRegistry& registry,
+                                               const LatencyHistogram* latencies,
+                                               const BackpressureConfig& config)
+    : config(config), latencies(latencies), reader(registry.registerReader()) {}
+
+BackpressureController::~BackpressureController() { stop(); }
+
+void BackpressureController::start() {
+    stopping = false;
+    worker = thread([this] {
+        while (!stopping) {
+            this_thread::sleep_for(config.interval);
+            if (!stopping) update();
+        }
+    });
+}
+
+void BackpressureController::stop() {
+    stopping = true;
+    if (worker.joinable()) worker.join();
+}
+
+void BackpressureController::update() {
+    bool slow = latencyMissed();
+    double throttleSum = 0;
+    size_t generators = 0;
+    {
+        auto topology = reader->read();
+        for (DataThread* thread : topology->dataThreads) {
+            adjust(*thread, thread->getQueueSize(), thread->getQueue().getMaxCapacity(), slow);
+            throttleSum += thread->getThrottle();
+        }
+        for (FunctionThread* thread : topology->functionThreads) {
+            adjust(*thread, thread->getQueueSize(), thread->getQueue().getMaxCapacity(), slow);
+            throttleSum += thread->getThrottle();
+        }
+        generators = topology->dataThreads.size() + topology->functionThreads.size();
+    }
+    if (generators > 0) meanThrottle = throttleSum / static_cast<double>(generators);
+    ++intervals;
+}
+
+bool BackpressureController::latencyMissed() {
+    if (!latencies || config.latencyTarget.count() <= 0) return false;
+    // Mean of the functions applied since the previous step
+    LatencyHistogram::Totals now = latencies->totals();
+    // A reset of the histogram starts the window over
+    if (now.count < last.count || now.sumNs < last.sumNs) last = {};
+    bool missed = false;
+    if (now.count > last.count) {
+        double meanNs = static_cast<double>(now.sumNs - last.sumNs) /
+                        static_cast<double>(now.count - last.count);
+        missed = meanNs > static_cast<double>(config.latencyTarget.count()) * 1000;
+    }
+    last = now;
+    return missed;
+}
+
+void BackpressureController::adjust(BaseThread& thread, size_t size, int capacity,
+                                    bool overloaded) {
+    double fill = capacity > 0 ? static_cast<double>(size) / capacity : 0;
+    double throttle = thread.getThrottle();
+    if (overloaded || fill > config.targetFill) {
+        double cut = max(config.minThrottle, throttle * config.decrease);
+        if (cut < throttle) {
+            thread.setThrottle(cut);
+            ++decreases;
+        }
+    } else if (throttle < 1) {
+        thread.setThrottle(min(1.0, throttle + config.increase));
+        ++increases;
+    }
+}
+
+BackpressureStats BackpressureController::getStats() const {
+    return {intervals.load(), decreases.load(), increases.load(), meanThrottle.load()};
+}
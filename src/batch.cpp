@@ -0,0 +1,118 @@
+#include "batch.h"
+
+#include <array>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t TYPE_COUNT = variant_size_v<DataValue>;
+constexpr size_t OPERATION_COUNT = 4;
+
+// Operand converted to the bucket's common type; complex operands only ever
+// land in complex buckets
+template <typename T>
+T as(const DataValue& value) {
+    return visit(
+        [](const auto& v) -> T {
+            if constexpr (is_same_v<T, complex<double>>) {
+                return complex<double>(v);
+            } else if constexpr (is_same_v<decay_t<decltype(v)>, complex<double>>) {
+                return T();
+            } else {
+                return static_cast<T>(v);
+            }
+        },
+        value);
+}
+
+template <typename T>
+bool isZeroDivisor(const T& value) {
+    if constexpr (is_same_v<T, complex<double>>) {
+        return abs(value) < 1e-10;
+    } else {
+        return abs(static_cast<double>(value)) < 1e-10;
+    }
+}
+
+// The tight loop: one operation over contiguous arrays
+template <typename T>
+void compute(Operation op, const T* a, const T* b, T* out, size_t n) {
+    switch (op) {
+        case Operation::ADD:
+            for (size_t i = 0; i < n; ++i) out[i] = a[i] + b[i];
+            break;
+        case Operation::SUBTRACT:
+            for (size_t i = 0; i < n; ++i) out[i] = a[i] - b[i];
+            break;
+        case Operation::MULTIPLY:
+            for (size_t i = 0; i < n; ++i) out[i] = a[i] * b[i];
+            break;
+        case Operation::DIVIDE:
+            for (size_t i = 0; i < n; ++i) out[i] = a[i] / b[i];
+            break;
+    }
+}
+
+template <typename T>
+void applyBucket(Operation op, vector<BatchItem>& items, const vector<size_t>& bucket) {
+    size_t n = bucket.size();
+    vector<T> left(n), right(n), out(n);
+    for (size_t i = 0; i < n; ++i) {
+        BatchItem& item = items[bucket[i]];
+        left[i] = as<T>(item.function.leftOperand(item.args));
+        right[i] = as<T>(item.function.rightOperand(item.args));
+        if (op == Operation::DIVIDE && isZeroDivisor(right[i])) {
+            item.failed = true;
+            item.error = "Division by zero";
+            right[i] = T(1);  // keeps the loop free of branches and traps
+        }
+    }
+    compute(op, left.data(), right.data(), out.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        BatchItem& item = items[bucket[i]];
+        if (!item.failed) item.result = out[i];
+    }
+}
+
+// Common type of two operand types, as apply() computes it
+template <typename Bucket>
+void dispatch(size_t leftType, size_t rightType, Bucket&& run) {
+    if (leftType == 2 || rightType == 2) {
+        run(complex<double>());
+    } else if (leftType == 1 || rightType == 1) {
+        run(float());
+    } else {
+        run(int());
+    }
+}
+
+}  // namespace
+
+size_t applyBatch(vector<BatchItem>& items) {
+    // Bucket index: operation, left type, right type
+    array<vector<size_t>, OPERATION_COUNT * TYPE_COUNT * TYPE_COUNT> buckets;
+    for (size_t i = 0; i < items.size(); ++i) {
+        BatchItem& item = items[i];
+        item.failed = false;
+        item.error.clear();
+        size_t leftType = item.function.leftOperand(item.args).index();
+        size_t rightType = item.function.rightOperand(item.args).index();
+        size_t op = static_cast<size_t>(item.function.op);
+        buckets[(op * TYPE_COUNT + leftType) * TYPE_COUNT + rightType].push_back(i);
+    }
+
+    size_t executed = 0;
+    for (size_t index = 0; index < buckets.size(); ++index) {
+        const auto& bucket = buckets[index];
+        if (bucket.empty()) continue;
+        auto op = static_cast<Operation>(index / (TYPE_COUNT * TYPE_COUNT));
+        size_t leftType = index / TYPE_COUNT % TYPE_COUNT, rightType = index % TYPE_COUNT;
+        dispatch(leftType, rightType, [&](auto type) {
+            applyBucket<decltype(type)>(op, items, bucket);
+        });
+        ++executed;
+    }
+    return executed;
+}
@@ -0,0 +1,97 @@
+#include "codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+enum : uint8_t { INT_VALUE, FLOAT_VALUE, COMPLEX_VALUE };
+enum : uint8_t { HAS_LEFT = 1, HAS_RIGHT = 2 };
+
+template <typename T>
+void put(string& out, T field) {
+    out.append(reinterpret_cast<const char*>(&field), sizeof(field));
+}
+
+template <typename T>
+bool get(const char*& cursor, const char* end, T& field) {
+    if (static_cast<size_t>(end - cursor) < sizeof(field)) return false;
+    memcpy(&field, cursor, sizeof(field));
+    cursor += sizeof(field);
+    return true;
+}
+
+}  // namespace
+
+void encode(string& out, const DataValue& value) {
+    if (holds_alternative<int>(value)) {
+        put<uint8_t>(out, INT_VALUE);
+        put<int32_t>(out, get<int>(value));
+    } else if (holds_alternative<float>(value)) {
+        put<uint8_t>(out, FLOAT_VALUE);
+        put(out, get<float>(value));
+    } else {
+        const complex<double>& number = get<complex<double>>(value);
+        put<uint8_t>(out, COMPLEX_VALUE);
+        put(out, number.real());
+        put(out, number.imag());
+    }
+}
+
+void encode(string& out, const ArithmeticFunction& function) {
+    uint8_t operands = (function.left_operand ? HAS_LEFT : 0) |
+                       (function.right_operand ? HAS_RIGHT : 0);
+    put(out, static_cast<uint8_t>(function.op));
+    put(out, operands);
+    if (function.left_operand) encode(out, *function.left_operand);
+    if (function.right_operand) encode(out, *function.right_operand);
+}
+
+bool decode(const char*& cursor, const char* end, DataValue& value) {
+    uint8_t type;
+    if (!get(cursor, end, type)) return false;
+    switch (type) {
+        case INT_VALUE: {
+            int32_t number;
+            if (!get(cursor, end, number)) return false;
+            value = static_cast<int>(number);
+            return true;
+        }
+        case FLOAT_VALUE: {
+            float number;
+            if (!get(cursor, end, number)) return false;
+            value = number;
+            return true;
+        }
+        case COMPLEX_VALUE: {
+            double real, imag;
+            if (!get(cursor, end, real) || !get(cursor, end, imag)) return false;
+            value = complex<double>(real, imag);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool decode(const char*& cursor, const char* end, ArithmeticFunction& function) {
+    uint8_t op, operands;
+    if (!get(cursor, end, op) || !get(cursor, end, operands)) return false;
+    if (op > static_cast<uint8_t>(Operation::DIVIDE) || operands > (HAS_LEFT | HAS_RIGHT)) {
+        return false;
+    }
+    function = ArithmeticFunction();
+    function.op = static_cast<Operation>(op);
+    DataValue operand;
+    if (operands & HAS_LEFT) {
+        if (!decode(cursor, end, operand)) return false;
+        function.left_operand = operand;
+    }
+    if (operands & HAS_RIGHT) {
+        if (!decode(cursor, end, operand)) return false;
+        function.right_operand = operand;
+    }
+    return true;
+}
@@ -0,0 +1,321 @@
+#include "control.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "snapshot.h"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define CONTROL_SUPPORTED 1
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr int POLL_TIMEOUT_MS = 100;
+constexpr size_t MAX_LINE = 4096;
+
+const char* HELP_TEXT =
+    "stats\n"
+    "rate <data|function|processing> <factor|max>\n"
+    "add <data|function|processing> [count]\n"
+    "remove <data|function|processing> [id]\n"
+    "capacity <data|function> <n>\n"
+    "overflow <data|function> <block|drop-newest|drop-oldest|reject>\n"
+    "log <off|errors|all>\n"
+    "snapshot <file>\n";
+
+template <typename Thread>
+int newestId(const vector<unique_ptr<Thread>>& threads) {
+    return threads.empty() ? -1 : threads.back()->getId();
+}
+
+// owner is the serving processing thread in partitioned mode, else -1
+string fillLine(const char* kind, int id, size_t size, int capacity, int owner) {
+    return string(kind) + " " + to_string(id) + ": " + to_string(size) + "/" +
+           to_string(capacity) + (owner >= 0 ? " owner " + to_string(owner) : "") + "\n";
+}
+
+#ifdef CONTROL_SUPPORTED
+bool socketAddress(const string& path, sockaddr_un& address, string& error) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long: " + path;
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool sendAll(int fd, const string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t count = ::send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        offset += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+bool isStatusLine(const string& reply, size_t lineStart) {
+    return reply.compare(lineStart, 3, "ok\n") == 0 || reply.compare(lineStart, 7, "error: ") == 0;
+}
+#endif
+
+}  // namespace
+
+ControlServer::ControlServer(Pipeline& pipeline)
+    : pipeline(pipeline),
+      dataPacing(pipeline.getConfig().dataPacing),
+      functionPacing(pipeline.getConfig().functionPacing),
+      processingPacing(pipeline.getConfig().processingPacing) {}
+
+ControlServer::~ControlServer() { stop(); }
+
+bool ControlServer::listen(const string& path, string& error) {
+#ifdef CONTROL_SUPPORTED
+    sockaddr_un address;
+    if (!socketAddress(path, address, error)) return false;
+    ::unlink(path.c_str());  // stale socket of a crashed run
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 ||
+        ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, 4) != 0) {
+        error = "cannot listen on " + path + ": " + strerror(errno);
+        if (listenFd >= 0) ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    socketPath = path;
+    serverThread = thread(&ControlServer::serve, this);
+    return true;
+#else
+    (void)path;
+    error = "control socket requires Linux";
+    return false;
+#endif
+}
+
+void ControlServer::stop() {
+    stopping = true;
+    if (serverThread.joinable()) serverThread.join();
+#ifdef CONTROL_SUPPORTED
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        listenFd = -1;
+        ::unlink(socketPath.c_str());
+    }
+#endif
+}
+
+void ControlServer::serve() {
+#ifdef CONTROL_SUPPORTED
+    struct Client {
+        int fd;
+        string in;
+    };
+    vector<Client> clients;
+
+    while (!stopping) {
+        vector<pollfd> fds{{listenFd, POLLIN, 0}};
+        for (const auto& client : clients) fds.push_back({client.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), POLL_TIMEOUT_MS) <= 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) clients.push_back({fd, string()});
+        }
+        // Clients accepted above are not in fds yet and are polled next round
+        for (size_t i = fds.size() - 1; i >= 1; --i) {
+            if (fds[i].revents == 0) continue;
+            Client& client = clients[i - 1];
+            char buffer[1024];
+            ssize_t count = ::recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            bool open = count > 0 || (count < 0 && (errno == EAGAIN || errno == EINTR));
+            if (count > 0) client.in.append(buffer, static_cast<size_t>(count));
+
+            size_t newline;
+            while (open && (newline = client.in.find('\n')) != string::npos) {
+                string line = client.in.substr(0, newline);
+                client.in.erase(0, newline + 1);
+                open = sendAll(client.fd, execute(line));
+            }
+            if (client.in.size() > MAX_LINE) open = false;
+            if (!open) {
+                ::close(client.fd);
+                clients.erase(clients.begin() + static_cast<ptrdiff_t>(i - 1));
+            }
+        }
+    }
+    for (const auto& client : clients) ::close(client.fd);
+#endif
+}
+
+string ControlServer::execute(const string& line) {
+    lock_guard<mutex> lock(executeMtx);
+    istringstream in(line);
+    string command, kind;
+    in >> command >> kind;
+    bool isData = kind == "data", isFunction = kind == "function",
+         isProcessing = kind == "processing";
+    bool anyKind = isData || isFunction || isProcessing;
+    ostringstream out;
+
+    try {
+        if (command == "stats") {
+            out << "processed " << pipeline.getFunctionsProcessed() << "\n";
+            out << "threads data=" << pipeline.getDataThreads().size()
+                << " function=" << pipeline.getFunctionThreads().size()
+                << " processing=" << pipeline.getProcessingThreads().size() << "\n";
+            OverflowCounts overflow = pipeline.getOverflowCounts();
+            out << "overflow dropped=" << overflow.dropped << " rejected=" << overflow.rejected
+                << "\n";
+            const LatencyHistogram& latencies = pipeline.getLatencies();
+            if (latencies.count() > 0) {
+                out << "latency_us p50=" << latencies.percentile(50) / 1000
+                    << " p99=" << latencies.percentile(99) / 1000
+                    << " max=" << latencies.max() / 1000 << "\n";
+            }
+            auto owner = [this](int id) {
+                return pipeline.getConfig().partitioned ? pipeline.getRegistry().partitionOwner(id)
+                                                        : -1;
+            };
+            for (const auto& thread : pipeline.getDataThreads()) {
+                out << fillLine("data", thread->getId(), thread->getQueueSize(),
+                                thread->getQueue().getMaxCapacity(), owner(thread->getId()));
+            }
+            for (const auto& thread : pipeline.getFunctionThreads()) {
+                out << fillLine("function", thread->getId(), thread->getQueueSize(),
+                                thread->getQueue().getMaxCapacity(), owner(thread->getId()));
+            }
+        } else if (command == "rate" && anyKind) {
+            string value;
+            in >> value;
+            // Rate x divides every delay by x; max removes them
+            double scale = 0;
+            if (value != "max") {
+                double factor = stod(value);
+                if (factor <= 0) throw runtime_error("rate must be positive");
+                scale = 1 / factor;
+            }
+            if (isData) pipeline.setDataPacing(dataPacing.scaled(scale));
+            if (isFunction) pipeline.setFunctionPacing(functionPacing.scaled(scale));
+            if (isProcessing) pipeline.setProcessingPacing(processingPacing.scaled(scale));
+        } else if (command == "add" && anyKind) {
+            string value;
+            in >> value;
+            int count = value.empty() ? 1 : stoi(value);
+            if (count <= 0) throw runtime_error("count must be positive");
+            for (int i = 0; i < count; ++i) {
+                int id = isData       ? pipeline.addDataThread()
+                         : isFunction ? pipeline.addFunctionThread()
+                                      : pipeline.addProcessingThread();
+                out << "added " << kind << " " << id << "\n";
+            }
+        } else if (command == "remove" && anyKind) {
+            string value;
+            in >> value;
+            int id = !value.empty() ? stoi(value)
+                     : isData       ? newestId(pipeline.getDataThreads())
+                     : isFunction   ? newestId(pipeline.getFunctionThreads())
+                                    : newestId(pipeline.getProcessingThreads());
+            bool removed = isData       ? pipeline.retireDataThread(id)
+                           : isFunction ? pipeline.retireFunctionThread(id)
+                                        : pipeline.retireProcessingThread(id);
+            if (!removed) return "error: no " + kind + " thread " + to_string(id) + "\n";
+            out << "removed " << kind << " " << id << "\n";
+        } else if (command == "capacity" && (isData || isFunction)) {
+            string value;
+            in >> value;
+            int capacity = stoi(value);
+            if (capacity <= 0) throw runtime_error("capacity must be positive");
+            if (isData) pipeline.setDataQueueCapacity(capacity);
+            if (isFunction) pipeline.setFunctionQueueCapacity(capacity);
+        } else if (command == "overflow" && (isData || isFunction)) {
+            string value;
+            in >> value;
+            OverflowPolicy policy;
+            if (!parseOverflowPolicy(value, policy)) {
+                return "error: unknown overflow policy '" + value + "'\n";
+            }
+            if (isData) pipeline.setDataOverflowPolicy(policy);
+            if (isFunction) pipeline.setFunctionOverflowPolicy(policy);
+        } else if (command == "log") {
+            if (kind == "off") {
+                BaseThread::setLogLevel(LogLevel::OFF);
+            } else if (kind == "errors") {
+                BaseThread::setLogLevel(LogLevel::ERRORS);
+            } else if (kind == "all") {
+                BaseThread::setLogLevel(LogLevel::ALL);
+            } else {
+                return "error: unknown log level '" + kind + "'\n";
+            }
+        } else if (command == "snapshot" && !kind.empty()) {
+            QueueSnapshot snapshot = captureSnapshot(pipeline);
+            if (!saveSnapshot(kind, snapshot)) return "error: cannot write " + kind + "\n";
+            out << "saved " << snapshot.valueCount() << " values and "
+                << snapshot.functionCount() << " functions to " << kind << "\n";
+        } else if (command == "help") {
+            out << HELP_TEXT;
+        } else {
+            return "error: unknown command '" + line + "' (try help)\n";
+        }
+    } catch (const invalid_argument&) {
+        return "error: invalid number in '" + line + "'\n";
+    } catch (const out_of_range&) {
+        return "error: number out of range in '" + line + "'\n";
+    } catch (const exception& e) {
+        return "error: " + string(e.what()) + "\n";
+    }
+    out << "ok\n";
+    return out.str();
+}
+
+bool sendControlCommand(const string& path, const string& command, string& reply,
+                        string& error) {
+#ifdef CONTROL_SUPPORTED
+    sockaddr_un address;
+    if (!socketAddress(path, address, error)) return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        error = "cannot connect to " + path + ": " + strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    reply.clear();
+    bool done = false;
+    if (sendAll(fd, command + "\n")) {
+        size_t lineStart = 0;
+        char buffer[1024];
+        while (!done) {
+            ssize_t count = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) break;
+            reply.append(buffer, static_cast<size_t>(count));
+            size_t newline;
+            while (!done && (newline = reply.find('\n', lineStart)) != string::npos) {
+                done = isStatusLine(reply, lineStart);
+                lineStart = newline + 1;
+            }
+        }
+    }
+    ::close(fd);
+    if (!done) error = "connection closed before the reply was complete";
+    return done;
+#else
+    (void)path;
+    (void)command;
+    (void)reply;
+    error = "control socket requires Linux";
+    return false;
+#endif
+}
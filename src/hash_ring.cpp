@@ -0,0 +1,57 @@
+#include "hash_ring.h"
+
+#include <algorithm>
+
+#include "random.h"
+
+using namespace std;
+
+namespace {
+
+uint64_t pointFor(int node, int replica) {
+    return splitmix64((static_cast<uint64_t>(static_cast<uint32_t>(node)) << 32) |
+                      static_cast<uint32_t>(replica));
+}
+
+}  // namespace
+
+void HashRing::add(int node) {
+    if (contains(node)) return;
+    for (int replica = 0; replica < VIRTUAL_NODES; ++replica) {
+        points.emplace_back(pointFor(node, replica), node);
+    }
+    sort(points.begin(), points.end());
+}
+
+void HashRing::remove(int node) {
+    points.erase(remove_if(points.begin(), points.end(),
+                           [node](const auto& point) { return point.second == node; }),
+                 points.end());
+}
+
+int HashRing::owner(uint64_t key) const {
+    if (points.empty()) return -1;
+    // Keys are hashed too: generator ids are small and consecutive
+    auto it = lower_bound(points.begin(), points.end(), make_pair(splitmix64(key), INT32_MIN));
+    return it != points.end() ? it->second : points.front().second;
+}
+
+int HashRing::nearest(int node, const vector<uint64_t>& keys) {
+    uint64_t start = pointFor(node, 0);
+    int best = -1;
+    uint64_t bestDistance = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        // Unsigned subtraction wraps around the ring
+        uint64_t distance = splitmix64(keys[i]) - start;
+        if (best < 0 || distance < bestDistance) {
+            best = static_cast<int>(i);
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+bool HashRing::contains(int node) const {
+    return any_of(points.begin(), points.end(),
+                  [node](const auto& point) { return point.second == node; });
+}
@@ -0,0 +1,191 @@
+#include "live_stats.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define LIVE_STATS_SUPPORTED 1
+#endif
+
+using namespace std;
+
+void ThreadStats::recordOperation(uint64_t latencyNs) {
+    operations.fetch_add(1, memory_order_relaxed);
+    latencySumNs.fetch_add(latencyNs, memory_order_relaxed);
+    // Single writer per slot, so load + store is enough for the maximum
+    if (latencyNs > latencyMaxNs.load(memory_order_relaxed)) {
+        latencyMaxNs.store(latencyNs, memory_order_relaxed);
+    }
+}
+
+LiveStats& LiveStats::instance() {
+    static LiveStats stats;
+    return stats;
+}
+
+LiveStats::~LiveStats() { close(); }
+
+bool LiveStats::open(const string& name) {
+#ifdef LIVE_STATS_SUPPORTED
+    lock_guard<mutex> lock(mtx);
+    if (segment) return true;
+
+    shm_unlink(name.c_str());  // stale segment of a crashed run
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, sizeof(LiveStatsSegment)) != 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* memory =
+        mmap(nullptr, sizeof(LiveStatsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    segment = new (memory) LiveStatsSegment();
+    segment->version = LIVE_STATS_VERSION;
+    segment->pid = static_cast<int32_t>(getpid());
+    // Viewers check the magic last, once the header is complete
+    atomic_thread_fence(memory_order_release);
+    segment->magic = LIVE_STATS_MAGIC;
+    segmentName = name;
+    return true;
+#else
+    (void)name;
+    return false;
+#endif
+}
+
+void LiveStats::close() {
+#ifdef LIVE_STATS_SUPPORTED
+    lock_guard<mutex> lock(mtx);
+    if (!segment || segmentName.empty()) return;
+    // Threads may still hold slot pointers until they are joined, so only the
+    // name is removed here; the mapping is released with the process
+    shm_unlink(segmentName.c_str());
+    segmentName.clear();
+#endif
+}
+
+void LiveStats::detach() {
+    lock_guard<mutex> lock(mtx);
+    segment = nullptr;
+    segmentName.clear();
+}
+
+namespace {
+
+bool inUse(uint32_t generation) { return generation % 2 == 1; }
+
+// First free slot below count, else the next unused one; nullptr when full
+template <typename Slot>
+Slot* claimSlot(Slot* slots, atomic<uint32_t>& count, size_t capacity) {
+    uint32_t used = count.load(memory_order_relaxed);
+    for (uint32_t i = 0; i < used; ++i) {
+        if (!inUse(slots[i].generation.load(memory_order_relaxed))) return &slots[i];
+    }
+    if (used >= capacity) return nullptr;
+    return &slots[used];
+}
+
+// Marks the slot used; counters must be written before
+template <typename Slot>
+void publishSlot(Slot* slots, Slot& slot, atomic<uint32_t>& count) {
+    slot.generation.fetch_add(1, memory_order_release);
+    uint32_t index = static_cast<uint32_t>(&slot - slots);
+    if (index >= count.load(memory_order_relaxed)) count.store(index + 1, memory_order_release);
+}
+
+}  // namespace
+
+QueueStats* LiveStats::registerQueue(int queueId, StatsKind kind, int capacity) {
+    lock_guard<mutex> lock(mtx);
+    if (!segment) return nullptr;
+    QueueStats* slot = claimSlot(segment->queues, segment->queueCount, LIVE_STATS_MAX_QUEUES);
+    if (!slot) return nullptr;
+
+    slot->queueId = queueId;
+    slot->kind = kind;
+    slot->capacity.store(capacity, memory_order_relaxed);
+    slot->pushed.store(0, memory_order_relaxed);
+    slot->popped.store(0, memory_order_relaxed);
+    slot->evicted.store(0, memory_order_relaxed);
+    publishSlot(segment->queues, *slot, segment->queueCount);
+    return slot;
+}
+
+ThreadStats* LiveStats::registerThread(int threadId, StatsKind kind) {
+    lock_guard<mutex> lock(mtx);
+    if (!segment) return nullptr;
+    ThreadStats* slot =
+        claimSlot(segment->threads, segment->threadCount, LIVE_STATS_MAX_THREADS);
+    if (!slot) return nullptr;
+
+    slot->threadId = threadId;
+    slot->kind = kind;
+    slot->operations.store(0, memory_order_relaxed);
+    slot->latencySumNs.store(0, memory_order_relaxed);
+    slot->latencyMaxNs.store(0, memory_order_relaxed);
+    publishSlot(segment->threads, *slot, segment->threadCount);
+    return slot;
+}
+
+void LiveStats::unregisterQueue(QueueStats* slot) {
+    lock_guard<mutex> lock(mtx);
+    // A forked child that detached must not free its parent's slots
+    if (segment && slot && inUse(slot->generation.load(memory_order_relaxed))) {
+        slot->generation.fetch_add(1, memory_order_release);
+    }
+}
+
+void LiveStats::unregisterThread(ThreadStats* slot) {
+    lock_guard<mutex> lock(mtx);
+    if (segment && slot && inUse(slot->generation.load(memory_order_relaxed))) {
+        slot->generation.fetch_add(1, memory_order_release);
+    }
+}
+
+const LiveStatsSegment* attachLiveStats(const string& name, string& error) {
+#ifdef LIVE_STATS_SUPPORTED
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error = "cannot open " + name + ": " + strerror(errno);
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, sizeof(LiveStatsSegment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        error = "cannot map " + name + ": " + strerror(errno);
+        return nullptr;
+    }
+
+    auto* segment = static_cast<const LiveStatsSegment*>(memory);
+    if (segment->magic != LIVE_STATS_MAGIC || segment->version != LIVE_STATS_VERSION) {
+        munmap(memory, sizeof(LiveStatsSegment));
+        error = name + " is not a live stats segment of this version";
+        return nullptr;
+    }
+    atomic_thread_fence(memory_order_acquire);
+    return segment;
+#else
+    error = "shared memory is not supported on this platform";
+    (void)name;
+    return nullptr;
+#endif
+}
+
+void detachLiveStats(const LiveStatsSegment* segment) {
+#ifdef LIVE_STATS_SUPPORTED
+    if (segment) munmap(const_cast<LiveStatsSegment*>(segment), sizeof(LiveStatsSegment));
+#else
+    (void)segment;
+#endif
+}
@@ -0,0 +1,40 @@
+#include "lookup_table.h"
+
+using namespace std;
+
+atomic<bool> IntLookupTable::enabled{false};
+
+const IntLookupTable& IntLookupTable::instance() {
+    static const IntLookupTable table;
+    return table;
+}
+
+void IntLookupTable::enable(bool value) {
+    if (value) instance();  // build before the first application needs it
+    enabled = value;
+}
+
+IntLookupTable::IntLookupTable() : results(4 * SIDE * SIDE) {
+    for (int op = 0; op < 4; ++op) {
+        for (int a = MIN_OPERAND; a <= MAX_OPERAND; ++a) {
+            for (int b = MIN_OPERAND; b <= MAX_OPERAND; ++b) {
+                int result;
+                switch (static_cast<Operation>(op)) {
+                    case Operation::ADD:
+                        result = a + b;
+                        break;
+                    case Operation::SUBTRACT:
+                        result = a - b;
+                        break;
+                    case Operation::MULTIPLY:
+                        result = a * b;
+                        break;
+                    default:
+                        result = b == 0 ? DIVISION_BY_ZERO : a / b;
+                        break;
+                }
+                results[index(static_cast<Operation>(op), a, b)] = static_cast<int16_t>(result);
+            }
+        }
+    }
+}
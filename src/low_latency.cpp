@@ -0,0 +1,120 @@
+#include "low_latency.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#define LOW_LATENCY_SUPPORTED 1
+#endif
+
+using namespace std;
+
+bool pinCurrentThread(const vector<int>& cpus) {
+#ifdef LOW_LATENCY_SUPPORTED
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+bool setFifoPriority(int priority) {
+#ifdef LOW_LATENCY_SUPPORTED
+    sched_param param{};
+    param.sched_priority = priority;
+    return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+    (void)priority;
+    return false;
+#endif
+}
+
+bool lockProcessMemory() {
+#ifdef LOW_LATENCY_SUPPORTED
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#else
+    return false;
+#endif
+}
+
+void prefaultStack(size_t bytes) {
+    // Each call maps one more page below its caller's frame
+    constexpr size_t CHUNK = 4096;
+    char page[CHUNK];
+    volatile char* touch = page;
+    touch[0] = 0;
+    touch[CHUNK - 1] = 0;
+    if (bytes > CHUNK) prefaultStack(bytes - CHUNK);
+}
+
+vector<int> parseCpuList(const string& text) {
+    vector<int> cpus;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (item.empty() || item == "\n") continue;
+        size_t dash = item.find('-');
+        size_t used = 0;
+        int first = stoi(item.substr(0, dash), &used);
+        if (used != (dash == string::npos ? item.size() : dash) || first < 0) {
+            throw invalid_argument(item);
+        }
+        int last = first;
+        if (dash != string::npos) {
+            string rest = item.substr(dash + 1);
+            last = stoi(rest, &used);
+            if (used != rest.size() || last < first) throw invalid_argument(item);
+        }
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+vector<int> isolatedCpus() {
+    ifstream file("/sys/devices/system/cpu/isolated");
+    string line;
+    if (!file || !getline(file, line)) return {};
+    try {
+        return parseCpuList(line);
+    } catch (const exception&) {
+        return {};
+    }
+}
+
+int availableCpus() {
+#ifdef LOW_LATENCY_SUPPORTED
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) return CPU_COUNT(&set);
+#endif
+    return 1;
+}
+
+vector<int> lowLatencyCpus(int count) {
+    vector<int> cpus = isolatedCpus();
+    if (!cpus.empty() || count <= 0) return cpus;
+#ifdef LOW_LATENCY_SUPPORTED
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return {};
+    for (int cpu = CPU_SETSIZE - 1; cpu >= 0 && static_cast<int>(cpus.size()) < count; --cpu) {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    // Keep at least one CPU for everything else
+    if (static_cast<int>(cpus.size()) == CPU_COUNT(&set) && cpus.size() > 1) cpus.pop_back();
+    reverse(cpus.begin(), cpus.end());
+#endif
+    return cpus;
+}
@@ -1,36 +1,446 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "autotune.h"
+#include "backpressure.h"
+#include "control.h"
+#include "live_stats.h"
+#include "lookup_table.h"
+#include "low_latency.h"
+#include "multiprocess.h"
+#include "perf_counters.h"
+#include "pipeline.h"
+#include "queue_sampler.h"
+#include "snapshot.h"
 #include "threads.h"
+#include "tracing.h"
+#include "transport.h"
 
 using namespace std;
 
+enum class NodeRole { STANDALONE, PRODUCER, PROCESSOR };
+
+// Producer node: generators only, everything they produce is streamed to the
+// processor node until it disconnects
+int runProducerNode(PipelineConfig config, const string& path) {
+    config.processingThreads = 0;
+    Pipeline pipeline(config);
+    pipeline.startDataThreads();
+    pipeline.startFunctionThreads();
+
+    TransportSender sender;
+    for (const auto& thread : pipeline.getDataThreads()) {
+        DataThread* source = thread.get();
+        sender.addStream([source](DataValue& value) {
+            try {
+                value = source->popValue();
+                return true;
+            } catch (const runtime_error&) {
+                return false;
+            }
+        });
+    }
+    for (const auto& thread : pipeline.getFunctionThreads()) {
+        FunctionThread* source = thread.get();
+        sender.addStream([source](ArithmeticFunction& function) {
+            try {
+                function = source->popFunction();
+                return true;
+            } catch (const runtime_error&) {
+                return false;
+            }
+        });
+    }
+
+    string error;
+    if (!sender.connect(path, error)) {
+        cerr << "Error: " << error << endl;
+        pipeline.stop();
+        return 1;
+    }
+    cout << "Connected to processor node at " << path << endl;
+
+    auto startTime = chrono::steady_clock::now();
+    while (sender.isConnected()) {
+        this_thread::sleep_for(chrono::milliseconds(500));
+        auto elapsed = chrono::duration_cast<chrono::seconds>(chrono::steady_clock::now() -
+                                                              startTime);
+        TransportStats stats = sender.getStats();
+        cout << "Sent: " << stats.elements << " elements in " << stats.frames
+             << " frames (elapsed: " << elapsed.count() << "s)" << endl;
+        if (elapsed.count() > 60) {
+            cout << "Timeout reached. Stopping..." << endl;
+            break;
+        }
+    }
+
+    // Closing the generator queues ends the sender's sources
+    pipeline.stop();
+    sender.stop();
+
+    TransportStats stats = sender.getStats();
+    cout << endl;
+    cout << "Transport: " << stats.elements << " elements, " << stats.frames << " frames, "
+         << stats.bytes << " bytes, " << stats.creditStalls << " credit stalls" << endl;
+    cout << "\nFinished!" << endl;
+    return 0;
+}
+
 void printUsage(const char* programName) {
-    cout << "Usage: " << programName << " <NF> <ND> <NP> <NA>" << endl;
+    cout << "Usage: " << programName << " <NF> <ND> <NP> <NA> [options]" << endl;
     cout << "  NF - number of function threads" << endl;
     cout << "  ND - number of data threads" << endl;
     cout << "  NP - number of processing threads" << endl;
     cout << "  NA - number of applied functions (stop condition)" << endl;
     cout << endl;
+    cout << "Options:" << endl;
+    cout << "  --perf - collect per-thread hardware perf counters (Linux)" << endl;
+    cout << "  --trace=<file> - write a Chrome trace-event timeline of thread activity" << endl;
+    cout << "  --live-stats[=<name>] - publish live counters in shared memory for pt_top"
+         << endl;
+    cout << "  --sample-queues=<file> - write a CSV time series of every queue's size" << endl;
+    cout << "  --sample-interval=<ms> - queue sampling interval (default: 10)" << endl;
+    cout << "  --snapshot=<file> - restore queue contents from file at startup (skipping the"
+         << endl;
+    cout << "                      warm-up) and save them there at shutdown" << endl;
+    cout << "  --processes - run every data and function thread in its own process, feeding"
+         << endl;
+    cout << "                this one through shared-memory queues (POSIX)" << endl;
+    cout << "  --node=producer --connect=<socket> - only generate, streaming data and functions"
+         << endl;
+    cout << "                to a processor node (NP and NA are ignored)" << endl;
+    cout << "  --node=processor --listen=<socket> - only process, receiving data and functions"
+         << endl;
+    cout << "                from a producer node with the same NF and ND (Linux)" << endl;
+    cout << "  --lut - answer int/int operations from a precomputed lookup table" << endl;
+    cout << "  --memo=<entries> - cache function results per processing thread" << endl;
+    cout << "  --prefill=<n> - start processing once every queue holds n elements (default: 1,"
+         << endl;
+    cout << "                  0 starts immediately)" << endl;
+    cout << "  --quiet-queues - do not print a line for every queue created" << endl;
+    cout << "  --seed=<n> - derive every thread's random seed from n (reproducible runs)"
+         << endl;
+    cout << "  --low-latency[=<cpus>] - busy-poll processing threads pinned one per CPU (default:"
+         << endl;
+    cout << "                  isolated CPUs, else the highest-numbered ones)" << endl;
+    cout << "  --fifo[=<priority>] - request SCHED_FIFO for processing threads (default: 50)"
+         << endl;
+    cout << "  --mlock - lock and prefault all memory of the process" << endl;
+    cout << "  --queue-wait-ms=<ms> - longest a processing thread waits on one queue (default:"
+         << endl;
+    cout << "                         100)" << endl;
+    cout << "  --overflow=<policy> - full queues: block (default), drop-newest, drop-oldest or"
+         << endl;
+    cout << "                        reject" << endl;
+    cout << "  --backpressure[=<fill>] - slow generators down to keep queues at fill (default:"
+         << endl;
+    cout << "                            0.5 of capacity)" << endl;
+    cout << "  --backpressure-latency-ms=<ms> - also slow them down while the mean latency"
+         << endl;
+    cout << "                                   exceeds ms" << endl;
+    cout << "  --batch=<k> - processing threads apply up to k functions at once, grouped by"
+         << endl;
+    cout << "                operation and operand types" << endl;
+    cout << "  --batch-delay-us=<us> - longest a batch waits to fill up (default: 1000)" << endl;
+    cout << "  --partitioned - each processing thread serves the generators a consistent hash"
+         << endl;
+    cout << "                  ring assigns it, instead of random queue pairs" << endl;
+    cout << "  --ordered[=<file>] - release results per function thread in generation order,"
+         << endl;
+    cout << "                       writing them to file" << endl;
+    cout << "  --reorder-gap-ms=<ms> - give up on a missing result after ms (default: 1000)"
+         << endl;
+    cout << "  --control=<socket> - accept live tuning commands on a UNIX socket (see pt_ctl,"
+         << endl;
+    cout << "                       Linux)" << endl;
+    cout << "  --auto - measure generation rates first and choose NP and queue capacities"
+         << endl;
+    cout << "  --target-util=<0..1> - processing utilization aimed at by --auto (default: 0.7)"
+         << endl;
+    cout << "  --target-latency-ms=<ms> - mean latency aimed at by --auto instead" << endl;
+    cout << "  --calibration-ms=<ms> - length of the --auto calibration phase (default: 2000)"
+         << endl;
+    cout << endl;
     cout << "Example: " << programName << " 2 3 2 10" << endl;
 }
 
-int calculateQueueCapacity(int producers) {
-    return producers * 10;
-}
-
 int main(int argc, char* argv[]) {
-    if (argc != 5) {
+    if (argc < 5) {
         printUsage(argv[0]);
         return 1;
     }
 
+    string traceFile;
+    string samplesFile;
+    string snapshotFile;
+    int sampleIntervalMs = 10;
+    bool autoTune = false;
+    bool multiProcess = false;
+    NodeRole role = NodeRole::STANDALONE;
+    string nodeAddress;
+    AutoTuneTarget target;
+    int calibrationMs = 2000;
+    int memoEntries = 0;
+    int prefill = 1;
+    bool lowLatency = false;
+    LowLatencyProfile lowLatencyProfile;
+    bool lockMemory = false;
+    string controlPath;
+    OverflowPolicy overflow = OverflowPolicy::BLOCK;
+    int queueWaitMs = static_cast<int>(PROCESSING_QUEUE_WAIT.count());
+    bool backpressure = false;
+    bool partitioned = false;
+    BatchConfig batch;
+    bool ordered = false;
+    string orderedFile;
+    int reorderGapMs = 1000;
+    BackpressureConfig backpressureConfig;
+    for (int i = 5; i < argc; ++i) {
+        string option = argv[i];
+        if (option == "--perf") {
+            PerfCollector::instance().enable();
+        } else if (option.rfind("--trace=", 0) == 0) {
+            traceFile = option.substr(8);
+            Tracer::instance().enable();
+        } else if (option == "--live-stats" || option.rfind("--live-stats=", 0) == 0) {
+            string name = option == "--live-stats" ? LIVE_STATS_DEFAULT_NAME : option.substr(13);
+            if (!LiveStats::instance().open(name)) {
+                cerr << "Warning: Could not create live stats segment " << name << endl;
+            } else {
+                cout << "Live stats published in " << name << " (view with pt_top)" << endl;
+            }
+        } else if (option.rfind("--sample-queues=", 0) == 0) {
+            samplesFile = option.substr(16);
+        } else if (option.rfind("--sample-interval=", 0) == 0) {
+            try {
+                sampleIntervalMs = stoi(option.substr(18));
+            } catch (const exception&) {
+                sampleIntervalMs = 0;
+            }
+            if (sampleIntervalMs <= 0) {
+                cerr << "Error: Sample interval must be a positive number of milliseconds" << endl;
+                return 1;
+            }
+        } else if (option.rfind("--snapshot=", 0) == 0) {
+            snapshotFile = option.substr(11);
+        } else if (option == "--processes") {
+            multiProcess = true;
+        } else if (option == "--node=producer") {
+            role = NodeRole::PRODUCER;
+        } else if (option == "--node=processor") {
+            role = NodeRole::PROCESSOR;
+        } else if (option.rfind("--connect=", 0) == 0) {
+            nodeAddress = option.substr(10);
+        } else if (option.rfind("--listen=", 0) == 0) {
+            nodeAddress = option.substr(9);
+        } else if (option == "--lut") {
+            IntLookupTable::enable(true);
+        } else if (option.rfind("--memo=", 0) == 0) {
+            try {
+                memoEntries = stoi(option.substr(7));
+            } catch (const exception&) {
+                memoEntries = 0;
+            }
+            if (memoEntries <= 0) {
+                cerr << "Error: Memo cache size must be a positive number of entries" << endl;
+                return 1;
+            }
+        } else if (option.rfind("--prefill=", 0) == 0) {
+            try {
+                prefill = stoi(option.substr(10));
+            } catch (const exception&) {
+                prefill = -1;
+            }
+            if (prefill < 0) {
+                cerr << "Error: Prefill level must be a non-negative number of elements" << endl;
+                return 1;
+            }
+        } else if (option.rfind("--seed=", 0) == 0) {
+            // stoull would wrap "-1" and skip leading blanks or a '+'
+            string seed = option.substr(7);
+            bool valid = !seed.empty() && seed.find_first_not_of("0123456789") == string::npos;
+            try {
+                if (valid) SeedService::instance().setSeed(stoull(seed));
+            } catch (const exception&) {
+                valid = false;  // beyond 64 bits
+            }
+            if (!valid) {
+                cerr << "Error: Seed must be a non-negative integer" << endl;
+                return 1;
+            }
+        } else if (option == "--low-latency" || option.rfind("--low-latency=", 0) == 0) {
+            lowLatency = true;
+            if (option != "--low-latency") {
+                try {
+                    lowLatencyProfile.cpus = parseCpuList(option.substr(14));
+                } catch (const exception&) {
+                    lowLatencyProfile.cpus.clear();
+                }
+                if (lowLatencyProfile.cpus.empty()) {
+                    cerr << "Error: Invalid CPU list " << option.substr(14) << endl;
+                    return 1;
+                }
+            }
+        } else if (option == "--fifo" || option.rfind("--fifo=", 0) == 0) {
+            lowLatencyProfile.fifoPriority = 50;
+            if (option != "--fifo") {
+                try {
+                    lowLatencyProfile.fifoPriority = stoi(option.substr(7));
+                } catch (const exception&) {
+                    lowLatencyProfile.fifoPriority = 0;
+                }
+                if (lowLatencyProfile.fifoPriority < 1 || lowLatencyProfile.fifoPriority > 99) {
+                    cerr << "Error: SCHED_FIFO priority must be between 1 and 99" << endl;
+                    return 1;
+                }
+            }
+        } else if (option == "--mlock") {
+            lockMemory = true;
+        } else if (option.rfind("--queue-wait-ms=", 0) == 0) {
+            try {
+                queueWaitMs = stoi(option.substr(16));
+            } catch (const exception&) {
+                queueWaitMs = -1;
+            }
+            if (queueWaitMs <= 0) {
+                cerr << "Error: --queue-wait-ms must be a positive number" << endl;
+                return 1;
+            }
+        } else if (option.rfind("--overflow=", 0) == 0) {
+            if (!parseOverflowPolicy(option.substr(11), overflow)) {
+                cerr << "Error: Unknown overflow policy " << option.substr(11) << endl;
+                return 1;
+            }
+        } else if (option == "--backpressure" || option.rfind("--backpressure=", 0) == 0) {
+            backpressure = true;
+            if (option.size() > 15) {
+                try {
+                    backpressureConfig.targetFill = stod(option.substr(15));
+                } catch (const exception&) {
+                    backpressureConfig.targetFill = 0;
+                }
+                if (backpressureConfig.targetFill <= 0 || backpressureConfig.targetFill >= 1) {
+                    cerr << "Error: --backpressure fill must be between 0 and 1" << endl;
+                    return 1;
+                }
+            }
+        } else if (option.rfind("--backpressure-latency-ms=", 0) == 0) {
+            backpressure = true;
+            int latencyMs;
+            try {
+                latencyMs = stoi(option.substr(26));
+            } catch (const exception&) {
+                latencyMs = -1;
+            }
+            if (latencyMs <= 0) {
+                cerr << "Error: --backpressure-latency-ms must be a positive number" << endl;
+                return 1;
+            }
+            backpressureConfig.latencyTarget = chrono::milliseconds(latencyMs);
+        } else if (option.rfind("--batch=", 0) == 0) {
+            int size;
+            try {
+                size = stoi(option.substr(8));
+            } catch (const exception&) {
+                size = 0;
+            }
+            if (size <= 0) {
+                cerr << "Error: --batch must be a positive number of functions" << endl;
+                return 1;
+            }
+            batch.maxFunctions = static_cast<size_t>(size);
+        } else if (option.rfind("--batch-delay-us=", 0) == 0) {
+            long long delayUs;
+            try {
+                delayUs = stoll(option.substr(17));
+            } catch (const exception&) {
+                delayUs = -1;
+            }
+            if (delayUs < 0) {
+                cerr << "Error: --batch-delay-us must not be negative" << endl;
+                return 1;
+            }
+            batch.maxDelay = chrono::microseconds(delayUs);
+        } else if (option == "--partitioned") {
+            partitioned = true;
+        } else if (option == "--ordered" || option.rfind("--ordered=", 0) == 0) {
+            ordered = true;
+            if (option.size() > 10) orderedFile = option.substr(10);
+        } else if (option.rfind("--reorder-gap-ms=", 0) == 0) {
+            try {
+                reorderGapMs = stoi(option.substr(17));
+            } catch (const exception&) {
+                reorderGapMs = -1;
+            }
+            if (reorderGapMs <= 0) {
+                cerr << "Error: --reorder-gap-ms must be a positive number" << endl;
+                return 1;
+            }
+        } else if (option.rfind("--control=", 0) == 0) {
+            controlPath = option.substr(10);
+        } else if (option == "--quiet-queues") {
+            logQueueCreation = false;
+        } else if (option == "--auto") {
+            autoTune = true;
+        } else if (option.rfind("--target-util=", 0) == 0) {
+            try {
+                target.utilization = stod(option.substr(14));
+            } catch (const exception&) {
+                target.utilization = 0;
+            }
+            if (target.utilization <= 0 || target.utilization >= 1) {
+                cerr << "Error: Target utilization must be between 0 and 1" << endl;
+                return 1;
+            }
+        } else if (option.rfind("--target-latency-ms=", 0) == 0) {
+            try {
+                target.latencyMs = stod(option.substr(20));
+            } catch (const exception&) {
+                target.latencyMs = 0;
+            }
+            if (target.latencyMs <= 0) {
+                cerr << "Error: Target latency must be a positive number of milliseconds" << endl;
+                return 1;
+            }
+        } else if (option.rfind("--calibration-ms=", 0) == 0) {
+            try {
+                calibrationMs = stoi(option.substr(17));
+            } catch (const exception&) {
+                calibrationMs = 0;
+            }
+            if (calibrationMs <= 0) {
+                cerr << "Error: Calibration time must be a positive number of milliseconds"
+                     << endl;
+                return 1;
+            }
+        } else {
+            cerr << "Error: Unknown option " << option << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (role != NodeRole::STANDALONE && nodeAddress.empty()) {
+        cerr << "Error: --node requires --connect=<socket> or --listen=<socket>" << endl;
+        return 1;
+    }
+    if (role != NodeRole::STANDALONE && (multiProcess || autoTune)) {
+        cerr << "Error: --node cannot be combined with --processes or --auto" << endl;
+        return 1;
+    }
+    // The sampler keeps references to the queues that existed at startup
+    if (!controlPath.empty() && !samplesFile.empty()) {
+        cerr << "Error: --control cannot be combined with --sample-queues" << endl;
+        return 1;
+    }
+
     try {
         int NF = stoi(argv[1]);  // Number of function threads
         int ND = stoi(argv[2]);  // Number of data threads
@@ -46,62 +456,224 @@ int main(int argc, char* argv[]) {
         cout << "=================================" << endl;
         cout << "Function threads: " << NF << endl;
         cout << "Data threads: " << ND << endl;
-        cout << "Processing threads: " << NP << endl;
+        cout << "Processing threads: " << (autoTune ? "auto" : to_string(NP)) << endl;
         cout << "Functions to apply: " << NA << endl;
         cout << endl;
 
-        // Global counter for applied functions
-        atomic<int> functionsProcessed{0};
+        PipelineConfig config;
+        config.functionThreads = NF;
+        config.dataThreads = ND;
+        config.processingThreads = NP;
+        config.maxFunctions = NA;
+        config.memoEntries = static_cast<size_t>(memoEntries);
+        config.queueWait = chrono::milliseconds(queueWaitMs);
+        config.dataOverflow = overflow;
+        config.functionOverflow = overflow;
+        config.partitioned = partitioned;
+        config.batch = batch;
 
-        // Thread pools
-        vector<unique_ptr<DataThread>> dataThreads;
-        vector<unique_ptr<FunctionThread>> functionThreads;
-        vector<unique_ptr<ProcessingThread>> processingThreads;
+        // Streams release concurrently, so lines are written under a lock
+        ofstream orderedOut;
+        mutex orderedMtx;
+        if (ordered) {
+            if (!orderedFile.empty()) {
+                orderedOut.open(orderedFile);
+                if (!orderedOut) {
+                    cerr << "Error: Could not open " << orderedFile << endl;
+                    return 1;
+                }
+            }
+            config.orderedSink = [&orderedOut, &orderedMtx](const OrderedResult& result) {
+                if (!orderedOut.is_open()) return;
+                lock_guard<mutex> lock(orderedMtx);
+                orderedOut << result.stream << " " << result.sequence << " " << result.text
+                           << "\n";
+            };
+            config.reorder.gapTimeout = chrono::milliseconds(reorderGapMs);
+        }
 
-        // Calculate queue capacities to avoid deadlocks
-        int dataQueueCapacity = calculateQueueCapacity(ND);
-        int functionQueueCapacity = calculateQueueCapacity(NF);
+        if (role == NodeRole::PRODUCER) return runProducerNode(config, nodeAddress);
 
+        if (autoTune) {
+            cout << "Calibrating generation rates for " << calibrationMs << " ms..." << endl;
+            MeasuredRates rates = measureRates(config, chrono::milliseconds(calibrationMs));
+            AutoTuneResult tuned = sizePipeline(config, rates, target);
+            printAutoTuneReport(cout, tuned, target);
+            cout << endl;
+            NP = tuned.processingThreads;
+            config.processingThreads = NP;
+            config.dataQueueCapacity = tuned.dataQueueCapacity;
+            config.functionQueueCapacity = tuned.functionQueueCapacity;
+        }
+
+        if (lowLatency) {
+            lowLatencyProfile.busyPoll = true;
+            if (lowLatencyProfile.cpus.empty()) lowLatencyProfile.cpus = lowLatencyCpus(NP);
+            cout << "Low-latency mode: busy-polling processing threads on CPUs";
+            for (int cpu : lowLatencyProfile.cpus) cout << " " << cpu;
+            cout << endl;
+            // Spinning SCHED_FIFO threads on every CPU would starve the
+            // generators and this thread for good
+            if (lowLatencyProfile.fifoPriority > 0 &&
+                static_cast<int>(lowLatencyProfile.cpus.size()) >= availableCpus()) {
+                cerr << "Warning: No CPU left for the other threads, not using SCHED_FIFO"
+                     << endl;
+                lowLatencyProfile.fifoPriority = 0;
+            }
+        }
+        config.lowLatency = lowLatencyProfile;
+        if (lockMemory && !lockProcessMemory()) {
+            cerr << "Warning: Could not lock memory (needs CAP_IPC_LOCK or a higher memlock "
+                    "limit), continuing unlocked"
+                 << endl;
+        }
+
+        // Fork the generator processes while this process has no threads
+        GeneratorProcesses processes;
+        if (multiProcess) {
+            if (!processes.start(config)) {
+                cerr << "Error: Could not start generator processes" << endl;
+                return 1;
+            }
+            processes.attachSources(config);
+            cout << "Started " << processes.processCount() << " generator processes" << endl;
+        }
+
+        // A processor node's generator threads read what the producer node sends
+        TransportReceiver receiver;
+        if (role == NodeRole::PROCESSOR) {
+            int dataCapacity = calculateQueueCapacity(ND);
+            int functionCapacity = calculateQueueCapacity(NF);
+            for (int i = 0; i < ND; ++i) {
+                config.dataSources.push_back(receiver.addDataStream(dataCapacity));
+            }
+            for (int i = 0; i < NF; ++i) {
+                config.functionSources.push_back(receiver.addFunctionStream(functionCapacity));
+            }
+            string error;
+            if (!receiver.listen(nodeAddress, error)) {
+                cerr << "Error: " << error << endl;
+                return 1;
+            }
+            cout << "Waiting for a producer node on " << nodeAddress << "..." << endl;
+            auto deadline = chrono::steady_clock::now() + chrono::seconds(60);
+            while (!receiver.isConnected() && chrono::steady_clock::now() < deadline) {
+                this_thread::sleep_for(chrono::milliseconds(10));
+            }
+            if (!receiver.isConnected()) {
+                cerr << "Error: No producer node connected" << endl;
+                return 1;
+            }
+            cout << "Producer node connected" << endl;
+        }
+        Pipeline pipeline(config);
+        const auto& dataThreads = pipeline.getDataThreads();
+        const auto& functionThreads = pipeline.getFunctionThreads();
+
+        // Queue capacities are calculated to avoid deadlocks, or chosen by --auto
         cout << "Calculated queue capacities:" << endl;
-        cout << "  Data queues: " << dataQueueCapacity << endl;
-        cout << "  Function queues: " << functionQueueCapacity << endl;
+        cout << "  Data queues: " << pipeline.getConfig().dataQueueCapacity << endl;
+        cout << "  Function queues: " << pipeline.getConfig().functionQueueCapacity << endl;
         cout << endl;
 
+        auto startupStart = chrono::steady_clock::now();
+
+        // A restored snapshot is queued before the generators add new elements
+        QueueSnapshot snapshot;
+        bool restored = !snapshotFile.empty() && loadSnapshot(snapshotFile, snapshot);
+        size_t unrestored = restored ? restoreSnapshot(snapshot, pipeline) : 0;
+
         // Create data threads
         cout << "Creating " << ND << " data threads..." << endl;
-        for (int i = 0; i < ND; ++i) {
-            dataThreads.push_back(make_unique<DataThread>(i + 1, dataQueueCapacity));
-        }
+        pipeline.startDataThreads();
 
         // Create function threads
         cout << "Creating " << NF << " function threads..." << endl;
-        for (int i = 0; i < NF; ++i) {
-            functionThreads.push_back(make_unique<FunctionThread>(i + 100, functionQueueCapacity));
+        pipeline.startFunctionThreads();
+
+        // Sample queue occupancy for the whole run, including the warm-up
+        QueueSampler sampler{chrono::milliseconds(sampleIntervalMs)};
+        if (!samplesFile.empty()) {
+            for (const auto& thread : dataThreads) sampler.addQueue(thread->getQueue(), "data");
+            for (const auto& thread : functionThreads) {
+                sampler.addQueue(thread->getQueue(), "function");
+            }
+            sampler.start();
         }
 
-        // Allow some time for data and function generation
-        cout << "Allowing threads to generate initial data..." << endl;
-        this_thread::sleep_for(chrono::milliseconds(1000));
+        // A restored snapshot fills the queues right away; otherwise allow
+        // some time for data and function generation
+        if (restored) {
+            cout << "Restored " << snapshot.valueCount() << " values and "
+                 << snapshot.functionCount() << " functions from " << snapshotFile;
+            if (unrestored > 0) {
+                cout << " (" << unrestored << " exceeded the queue capacities and were lost)";
+            }
+            cout << endl;
+        } else {
+            // Warm-up barrier: processing starts as soon as every queue is prefilled
+            cout << "Waiting for every queue to hold " << prefill << " elements..." << endl;
+            auto warmUpStart = chrono::steady_clock::now();
+            bool ready = pipeline.waitForPrefill(prefill, chrono::seconds(10));
+            auto warmUp = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() -
+                                                                     warmUpStart);
+            cout << (ready ? "Queues prefilled" : "Prefill timed out") << " after "
+                 << warmUp.count() << " ms" << endl;
+        }
 
         // Create processing threads
         cout << "Creating " << NP << " processing threads..." << endl;
-        for (int i = 0; i < NP; ++i) {
-            processingThreads.push_back(make_unique<ProcessingThread>(
-                i + 200, functionsProcessed, NA, dataThreads, functionThreads));
-        }
+        pipeline.startProcessingThreads();
 
-        cout << "All threads started. Processing..." << endl;
+        auto startup = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() -
+                                                                   startupStart);
+        cout << "All threads started in " << startup.count() << " ms. Processing..." << endl;
+        if (partitioned) {
+            cout << "Partitions (generator->processing thread):";
+            for (const auto& thread : dataThreads) {
+                cout << " " << thread->getId() << "->"
+                     << pipeline.getRegistry().partitionOwner(thread->getId());
+            }
+            for (const auto& thread : functionThreads) {
+                cout << " " << thread->getId() << "->"
+                     << pipeline.getRegistry().partitionOwner(thread->getId());
+            }
+            cout << endl;
+        }
         cout << endl;
 
+        ControlServer control(pipeline);
+        if (!controlPath.empty()) {
+            string error;
+            if (control.listen(controlPath, error)) {
+                cout << "Accepting control commands on " << controlPath << endl;
+            } else {
+                cerr << "Warning: " << error << ", running without control socket" << endl;
+            }
+        }
+
+        // Generators fed from other processes or nodes have no pacing to stretch
+        BackpressureController backpressureController(pipeline.getRegistry(),
+                                                      &pipeline.getLatencies(), backpressureConfig);
+        if (backpressure && (multiProcess || role == NodeRole::PROCESSOR)) {
+            cerr << "Warning: --backpressure needs in-process generators, ignoring it" << endl;
+            backpressure = false;
+        }
+        if (backpressure) {
+            cout << "Backpressure: holding queues at " << backpressureConfig.targetFill * 100
+                 << "% of capacity" << endl;
+            backpressureController.start();
+        }
+
         // Monitor progress
         auto startTime = chrono::steady_clock::now();
-        while (functionsProcessed.load() < NA) {
+        while (pipeline.getFunctionsProcessed() < NA) {
             this_thread::sleep_for(chrono::milliseconds(500));
 
             auto currentTime = chrono::steady_clock::now();
             auto elapsed = chrono::duration_cast<chrono::seconds>(currentTime - startTime);
 
-            cout << "Progress: " << functionsProcessed.load() << "/" << NA
+            cout << "Progress: " << pipeline.getFunctionsProcessed() << "/" << NA
                  << " functions processed (elapsed: " << elapsed.count() << "s)" << endl;
 
             // Safety timeout (optional)
@@ -114,34 +686,39 @@ int main(int argc, char* argv[]) {
         cout << endl;
         cout << "Stopping all threads..." << endl;
 
-        // Stop all threads
-        for (auto& thread : processingThreads) {
-            thread->stop();
-        }
-        for (auto& thread : dataThreads) {
-            thread->stop();
-        }
-        for (auto& thread : functionThreads) {
-            thread->stop();
-        }
-
-        // Wait for all threads to finish
+        // Stop all threads and wait for them to finish
         cout << "Waiting for threads to finish..." << endl;
-        this_thread::sleep_for(chrono::milliseconds(1000));
+        control.stop();
+        backpressureController.stop();
+        processes.stop();
+        receiver.stop();
+        pipeline.stop();
+        sampler.stop();
+
+        if (!snapshotFile.empty()) {
+            snapshot = captureSnapshot(pipeline);
+            if (saveSnapshot(snapshotFile, snapshot)) {
+                cout << "Saved " << snapshot.valueCount() << " values and "
+                     << snapshot.functionCount() << " functions to " << snapshotFile << endl;
+            } else {
+                cerr << "Error: Could not write snapshot file " << snapshotFile << endl;
+            }
+        }
 
         cout << endl;
         cout << "Final Statistics:" << endl;
         cout << "=================" << endl;
-        cout << "Functions processed: " << functionsProcessed.load() << endl;
+        cout << "Functions processed: " << pipeline.getFunctionsProcessed() << endl;
 
         // Display final queue sizes
         cout << "\nFinal queue sizes:" << endl;
         for (size_t i = 0; i < dataThreads.size(); ++i) {
-            cout << "Data thread " << (i + 1) << " (queue " << dataThreads[i]->getQueueId()
-                 << "): " << dataThreads[i]->getQueueSize() << " values" << endl;
+            cout << "Data thread " << dataThreads[i]->getId() << " (queue "
+                 << dataThreads[i]->getQueueId() << "): " << dataThreads[i]->getQueueSize()
+                 << " values" << endl;
         }
         for (size_t i = 0; i < functionThreads.size(); ++i) {
-            cout << "Function thread " << (i + 100) << " (queue "
+            cout << "Function thread " << functionThreads[i]->getId() << " (queue "
                  << functionThreads[i]->getQueueId() << "): " << functionThreads[i]->getQueueSize()
                  << " functions" << endl;
         }
@@ -150,6 +727,83 @@ int main(int argc, char* argv[]) {
         auto totalElapsed = chrono::duration_cast<chrono::seconds>(endTime - startTime);
         cout << "\nTotal execution time: " << totalElapsed.count() << " seconds" << endl;
 
+        if (role == NodeRole::PROCESSOR) {
+            TransportStats stats = receiver.getStats();
+            cout << "\nTransport: " << stats.elements << " elements, " << stats.frames
+                 << " frames, " << stats.bytes << " bytes" << endl;
+        }
+
+        // Generation-to-result latency, including the tail that busy-polling targets
+        const LatencyHistogram& latencies = pipeline.getLatencies();
+        if (latencies.count() > 0) {
+            cout << "\nLatency (generation to result): p50 " << latencies.percentile(50) / 1000
+                 << " us, p99 " << latencies.percentile(99) / 1000 << " us, p99.99 "
+                 << latencies.percentile(99.99) / 1000 << " us, max " << latencies.max() / 1000
+                 << " us" << endl;
+        }
+
+        if (overflow != OverflowPolicy::BLOCK) {
+            OverflowCounts counts = pipeline.getOverflowCounts();
+            cout << "\nOverflow (" << overflowPolicyName(overflow) << "): " << counts.dropped
+                 << " dropped, " << counts.rejected << " rejected" << endl;
+        }
+
+        if (backpressure) {
+            BackpressureStats stats = backpressureController.getStats();
+            cout << "\nBackpressure: " << stats.decreases << " rate cuts, " << stats.increases
+                 << " raises over " << stats.intervals << " intervals, generators at "
+                 << static_cast<int>(stats.meanThrottle * 100 + 0.5) << "% of their paced rate"
+                 << endl;
+        }
+
+        if (ordered) {
+            const ReorderMetrics& reorder = pipeline.getReorderMetrics();
+            cout << "\nOrdered output: " << reorder.released << " results released, "
+                 << reorder.gaps << " gaps skipped, " << reorder.late << " late, reorder depth max "
+                 << reorder.maxDepth << endl;
+            if (reorder.delay.count() > 0) {
+                cout << "Reorder delay: p50 " << reorder.delay.percentile(50) / 1000 << " us, p99 "
+                     << reorder.delay.percentile(99) / 1000 << " us, max "
+                     << reorder.delay.max() / 1000 << " us" << endl;
+            }
+        }
+
+        if (batch.maxFunctions > 1) {
+            BatchStats batches = pipeline.getBatchStats();
+            cout << "\nBatching: " << batches.functions << " functions in " << batches.batches
+                 << " batches (mean " << batches.meanSize() << ", " << batches.buckets
+                 << " buckets)" << endl;
+        }
+
+        if (memoEntries > 0) {
+            MemoStats memo = pipeline.getMemoStats();
+            cout << "\nMemo cache: " << memo.hits << " hits of " << memo.lookups()
+                 << " lookups (" << static_cast<int>(memo.hitRatio() * 100 + 0.5) << "%)"
+                 << endl;
+        }
+
+        PerfCollector::instance().report(cout, pipeline.getFunctionsProcessed());
+        LiveStats::instance().close();
+
+        if (!samplesFile.empty()) {
+            if (sampler.writeCsv(samplesFile)) {
+                cout << "\nQueue samples written to " << samplesFile << " ("
+                     << sampler.sampleCount() << " samples)" << endl;
+            } else {
+                cerr << "Error: Could not write queue samples file " << samplesFile << endl;
+            }
+        }
+
+        if (!traceFile.empty()) {
+            if (Tracer::instance().writeChromeTrace(traceFile)) {
+                cout << "\nTrace written to " << traceFile << " ("
+                     << Tracer::instance().spanCount() << " spans, "
+                     << Tracer::instance().droppedCount() << " dropped)" << endl;
+            } else {
+                cerr << "Error: Could not write trace file " << traceFile << endl;
+            }
+        }
+
     } catch (const invalid_argument& e) {
         cerr << "Error: Invalid argument - " << e.what() << endl;
         printUsage(argv[0]);
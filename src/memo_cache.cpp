@@ -0,0 +1,76 @@
+#include "memo_cache.h"
+
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+template <typename T>
+uint64_t bitsOf(T value) {
+    static_assert(sizeof(T) <= sizeof(uint64_t), "value must fit one word");
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(T));
+    return bits;
+}
+
+// Raw bits of a value, so equal keys mean bit-identical operands
+void packValue(const DataValue& value, uint64_t& re, uint64_t& im) {
+    if (const int* i = get_if<int>(&value)) {
+        re = bitsOf(*i);
+        im = 0;
+    } else if (const float* f = get_if<float>(&value)) {
+        re = bitsOf(*f);
+        im = 0;
+    } else {
+        const complex<double>& c = get<complex<double>>(value);
+        re = bitsOf(c.real());
+        im = bitsOf(c.imag());
+    }
+}
+
+}  // namespace
+
+bool MemoCache::Key::operator==(const Key& other) const {
+    return memcmp(words, other.words, sizeof(words)) == 0;
+}
+
+MemoCache::MemoCache(size_t entries) {
+    size_t size = 1;
+    while (size < entries) size <<= 1;
+    slots.resize(size);
+    mask = size - 1;
+}
+
+MemoCache::Key MemoCache::makeKey(Operation op, const DataValue& left, const DataValue& right) {
+    Key key;
+    // The low bit marks the key as used
+    key.words[0] = 1 | static_cast<uint64_t>(op) << 1 | static_cast<uint64_t>(left.index()) << 4 |
+                   static_cast<uint64_t>(right.index()) << 6;
+    packValue(left, key.words[1], key.words[2]);
+    packValue(right, key.words[3], key.words[4]);
+    return key;
+}
+
+size_t MemoCache::hash(const Key& key) {
+    uint64_t h = 0;
+    for (uint64_t word : key.words) {
+        h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 32;
+    }
+    return static_cast<size_t>(h);
+}
+
+DataValue MemoCache::apply(const ArithmeticFunction& func, const vector<DataValue>& args) {
+    Key key = makeKey(func.op, func.leftOperand(args), func.rightOperand(args));
+    Slot& slot = slots[hash(key) & mask];
+    if (slot.key == key) {
+        stats.hits++;
+        return slot.result;
+    }
+    stats.misses++;
+    DataValue result = func.apply(args);
+    slot.key = key;
+    slot.result = result;
+    return result;
+}
@@ -0,0 +1,90 @@
+#include "metrics.h"
+
+#include <limits>
+
+using namespace std;
+
+namespace {
+// Index of the highest set bit; value must be non-zero
+unsigned highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+    unsigned bit = 0;
+    while (value >>= 1) bit++;
+    return bit;
+#endif
+}
+}  // namespace
+
+size_t LatencyHistogram::bucketFor(uint64_t value) {
+    // Values below SUB_BUCKETS get exact buckets
+    if (value < SUB_BUCKETS) return static_cast<size_t>(value);
+    unsigned exponent = highestBit(value);
+    size_t subBucket =
+        static_cast<size_t>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < SUB_BUCKETS) return index;
+    size_t exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t subBucket = index % SUB_BUCKETS;
+    size_t shift = exponent - SUB_BUCKET_BITS;
+    uint64_t lower = (SUB_BUCKETS + subBucket) << shift;
+    uint64_t width = uint64_t{1} << shift;
+    // The topmost bucket would overflow
+    if (lower > numeric_limits<uint64_t>::max() - width) return numeric_limits<uint64_t>::max();
+    return lower + width - 1;
+}
+
+void LatencyHistogram::record(uint64_t valueNs) {
+    buckets[bucketFor(valueNs)].fetch_add(1, memory_order_relaxed);
+    total.fetch_add(1, memory_order_relaxed);
+    // Publishes the count increment to totals()
+    sum.fetch_add(valueNs, memory_order_release);
+    uint64_t current = maximum.load(memory_order_relaxed);
+    while (valueNs > current &&
+           !maximum.compare_exchange_weak(current, valueNs, memory_order_relaxed)) {
+    }
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n == 0 ? 0.0 : static_cast<double>(sum.load(memory_order_relaxed)) / n;
+}
+
+LatencyHistogram::Totals LatencyHistogram::totals() const {
+    Totals snapshot;
+    snapshot.sumNs = sum.load(memory_order_acquire);
+    snapshot.count = total.load(memory_order_relaxed);
+    return snapshot;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    // Sum the buckets instead of trusting total, which may be mid-update
+    uint64_t n = 0;
+    for (const auto& bucket : buckets) n += bucket.load(memory_order_relaxed);
+    if (n == 0) return 0;
+
+    double clamped = p < 0 ? 0 : (p > 100 ? 100 : p);
+    auto rank = static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(n));
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += buckets[i].load(memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t bound = bucketUpperBound(i);
+            uint64_t observedMax = max();
+            return bound < observedMax || observedMax == 0 ? bound : observedMax;
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets) bucket.store(0, memory_order_relaxed);
+    total.store(0, memory_order_relaxed);
+    sum.store(0, memory_order_relaxed);
+    maximum.store(0, memory_order_relaxed);
+}
@@ -0,0 +1,178 @@
+#include "multiprocess.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#define MULTIPROCESS_SUPPORTED 1
+#endif
+
+using namespace std;
+
+namespace {
+
+// How long a source waits on its shared queue before checking its child
+constexpr chrono::milliseconds CHILD_CHECK_INTERVAL{100};
+// How long stop() waits for a child before killing it
+constexpr chrono::milliseconds CHILD_EXIT_GRACE{2000};
+
+#ifdef MULTIPROCESS_SUPPORTED
+// Child side: generate as usual and forward everything into the shared queue
+// until the processing process closes it
+template <typename Thread, typename T>
+void bridge(Thread& thread, T (Thread::*pop)(), ShmQueue<T>& queue) {
+    try {
+        while (!queue.isClosed()) queue.push((thread.*pop)());
+    } catch (const exception&) {
+    }
+    thread.stop();
+    thread.closeQueue();
+    thread.join();
+}
+
+string queueName(const char* kind, int index) {
+    return "/pt_" + to_string(getpid()) + "_" + kind + "_" + to_string(index);
+}
+#endif
+
+}  // namespace
+
+GeneratorProcesses::~GeneratorProcesses() { stop(); }
+
+bool GeneratorProcesses::start(const PipelineConfig& config) {
+#ifdef MULTIPROCESS_SUPPORTED
+    int dataCapacity = config.dataQueueCapacity > 0 ? config.dataQueueCapacity
+                                                    : calculateQueueCapacity(config.dataThreads);
+    int functionCapacity = config.functionQueueCapacity > 0
+                               ? config.functionQueueCapacity
+                               : calculateQueueCapacity(config.functionThreads);
+    for (int i = 0; i < config.dataThreads; ++i) {
+        dataQueues.push_back(ShmQueue<DataValue>::create(queueName("data", i), dataCapacity));
+        if (!dataQueues.back()) return false;
+    }
+    for (int i = 0; i < config.functionThreads; ++i) {
+        functionQueues.push_back(
+            ShmQueue<ArithmeticFunction>::create(queueName("function", i), functionCapacity));
+        if (!functionQueues.back()) return false;
+    }
+
+    cout.flush();  // buffered output would otherwise be printed by every child
+    for (int i = 0; i < config.dataThreads + config.functionThreads; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            stop();
+            return false;
+        }
+        if (pid > 0) {
+            children.push_back({pid});
+            continue;
+        }
+
+        // Child: publishing live stats stays with the processing process
+        LiveStats::instance().detach();
+        if (i < config.dataThreads) {
+            DataThread thread(i + 1, dataCapacity, config.dataPacing);
+            bridge(thread, &DataThread::popValue, *dataQueues[i]);
+        } else {
+            int f = i - config.dataThreads;
+            FunctionThread thread(f + 100, functionCapacity, config.functionPacing);
+            bridge(thread, &FunctionThread::popFunction, *functionQueues[f]);
+        }
+        cout.flush();
+        _exit(0);  // the parent's destructors and atexit handlers are not ours to run
+    }
+    return true;
+#else
+    (void)config;
+    return false;
+#endif
+}
+
+void GeneratorProcesses::attachSources(PipelineConfig& config) {
+    config.dataSources.clear();
+    for (size_t i = 0; i < dataQueues.size(); ++i) {
+        ShmQueue<DataValue>* shared = dataQueues[i].get();
+        config.dataSources.push_back(
+            [this, shared, i](DataValue& value) { return receive(*shared, i, value); });
+    }
+    config.functionSources.clear();
+    for (size_t f = 0; f < functionQueues.size(); ++f) {
+        ShmQueue<ArithmeticFunction>* shared = functionQueues[f].get();
+        size_t child = dataQueues.size() + f;
+        config.functionSources.push_back([this, shared, child](ArithmeticFunction& function) {
+            return receive(*shared, child, function);
+        });
+    }
+}
+
+template <typename T>
+bool GeneratorProcesses::receive(ShmQueue<T>& queue, size_t child, T& elem) {
+    try {
+        while (true) {
+            if (optional<T> received = queue.popFor(CHILD_CHECK_INTERVAL)) {
+                elem = *received;
+                return true;
+            }
+            // Nothing more will come; what is queued is still delivered
+            if (!queue.isClosed() && hasExited(child)) {
+                cerr << "Warning: generator process " << children[child].pid
+                     << " exited, closing its queue" << endl;
+                queue.close();
+            }
+        }
+    } catch (const runtime_error&) {
+        return false;  // closed and drained
+    }
+}
+
+bool GeneratorProcesses::hasExited(size_t child) {
+    lock_guard<mutex> lock(childMtx);
+    Child& process = children[child];
+#ifdef MULTIPROCESS_SUPPORTED
+    if (!process.exited && waitpid(process.pid, nullptr, WNOHANG) == process.pid) {
+        process.exited = true;
+    }
+#endif
+    return process.exited;
+}
+
+vector<int> GeneratorProcesses::getPids() const {
+    vector<int> pids;
+    for (const Child& child : children) pids.push_back(child.pid);
+    return pids;
+}
+
+size_t GeneratorProcesses::exitedCount() const {
+    lock_guard<mutex> lock(childMtx);
+    size_t count = 0;
+    for (const Child& child : children) count += child.exited ? 1 : 0;
+    return count;
+}
+
+void GeneratorProcesses::stop() {
+    for (auto& queue : dataQueues) {
+        if (queue) queue->close();
+    }
+    for (auto& queue : functionQueues) {
+        if (queue) queue->close();
+    }
+#ifdef MULTIPROCESS_SUPPORTED
+    auto deadline = chrono::steady_clock::now() + CHILD_EXIT_GRACE;
+    for (size_t i = 0; i < children.size(); ++i) {
+        while (!hasExited(i) && chrono::steady_clock::now() < deadline) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        if (!hasExited(i)) {
+            kill(children[i].pid, SIGKILL);
+            lock_guard<mutex> lock(childMtx);
+            waitpid(children[i].pid, nullptr, 0);
+            children[i].exited = true;
+        }
+    }
+#endif
+}
@@ -0,0 +1,217 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <map>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+#if defined(__linux__)
+struct EventSpec {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr EventSpec EVENT_SPECS[PERF_EVENT_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+int openCounter(const EventSpec& spec) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    // User-space only for hardware events (allowed with the default perf_event_paranoid);
+    // context switches are a kernel-side software event
+    attr.exclude_kernel = spec.type == PERF_TYPE_HARDWARE ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid 0 / cpu -1: the calling thread on any CPU
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+optional<uint64_t> readCounter(int fd) {
+    if (fd < 0) return nullopt;
+    uint64_t data[3];  // value, time enabled, time running
+    if (read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) return nullopt;
+    if (data[2] == 0) return data[1] == 0 ? optional<uint64_t>(0) : nullopt;
+    // Scale up when the kernel had to multiplex the counter
+    if (data[2] < data[1]) {
+        return static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+    }
+    return data[0];
+}
+
+void closeCounters(array<int, PERF_EVENT_COUNT>& fds) {
+    for (int& fd : fds) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+}
+#endif
+
+PerfValues readCounters(const array<int, PERF_EVENT_COUNT>& fds) {
+    PerfValues values;
+#if defined(__linux__)
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) values[i] = readCounter(fds[i]);
+#else
+    (void)fds;
+#endif
+    return values;
+}
+
+string formatValue(const optional<uint64_t>& value) {
+    return value.has_value() ? to_string(value.value()) : "n/a";
+}
+
+}  // namespace
+
+PerfCollector& PerfCollector::instance() {
+    static PerfCollector collector;
+    return collector;
+}
+
+PerfCollector::~PerfCollector() {
+#if defined(__linux__)
+    for (auto& thread : threads) closeCounters(thread.fds);
+#endif
+}
+
+void PerfCollector::enable() { enabled = true; }
+
+bool PerfCollector::isEnabled() const { return enabled; }
+
+const char* PerfCollector::eventName(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::CYCLES:
+            return "cycles";
+        case PerfEvent::INSTRUCTIONS:
+            return "instructions";
+        case PerfEvent::LLC_MISSES:
+            return "llc-misses";
+        case PerfEvent::BRANCH_MISSES:
+            return "branch-misses";
+        case PerfEvent::CONTEXT_SWITCHES:
+            return "context-switches";
+    }
+    return "unknown";
+}
+
+void PerfCollector::attachCurrentThread(const string& threadType, int threadId) {
+    if (!enabled) return;
+
+    ThreadCounters counters{threadType, threadId, {}, nullopt};
+    counters.fds.fill(-1);
+    string error;
+#if defined(__linux__)
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+        counters.fds[i] = openCounter(EVENT_SPECS[i]);
+        if (counters.fds[i] < 0 && error.empty()) {
+            error = string(eventName(static_cast<PerfEvent>(i))) + ": " + strerror(errno);
+        }
+    }
+#else
+    error = "perf_event_open is only available on Linux";
+#endif
+
+    lock_guard<mutex> lock(mtx);
+    if (firstError.empty()) firstError = error;
+    threads.push_back(counters);
+}
+
+void PerfCollector::detachThread(const string& threadType, int threadId) {
+    if (!enabled) return;
+    lock_guard<mutex> lock(mtx);
+    for (auto& thread : threads) {
+        bool same = thread.threadType == threadType && thread.threadId == threadId;
+        if (!same || thread.finalValues) continue;
+        thread.finalValues = readCounters(thread.fds);
+#if defined(__linux__)
+        closeCounters(thread.fds);
+#endif
+    }
+}
+
+vector<pair<string, PerfValues>> PerfCollector::readAll() const {
+    lock_guard<mutex> lock(mtx);
+    vector<pair<string, PerfValues>> result;
+    for (const auto& thread : threads) {
+        result.emplace_back(thread.threadType,
+                            thread.finalValues ? *thread.finalValues : readCounters(thread.fds));
+    }
+    return result;
+}
+
+void PerfCollector::report(ostream& out, int functionsApplied) const {
+    if (!enabled) return;
+
+    struct Totals {
+        int threads = 0;
+        PerfValues values;
+    };
+    map<string, Totals> byType;
+    bool anyAvailable = false;
+
+    for (const auto& [type, values] : readAll()) {
+        Totals& totals = byType[type];
+        if (totals.threads++ == 0) totals.values = values;
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            if (values[i].has_value()) anyAvailable = true;
+            if (totals.threads == 1) continue;
+            // A value is only reported when every thread of the type could count it
+            if (totals.values[i].has_value() && values[i].has_value()) {
+                totals.values[i] = totals.values[i].value() + values[i].value();
+            } else {
+                totals.values[i].reset();
+            }
+        }
+    }
+
+    out << "\nPerf counters:" << endl;
+    {
+        lock_guard<mutex> lock(mtx);
+        if (!firstError.empty()) {
+            out << "  Some counters unavailable (" << firstError
+                << "); check /proc/sys/kernel/perf_event_paranoid" << endl;
+        }
+    }
+    if (!anyAvailable) {
+        out << "  No counters could be read" << endl;
+        return;
+    }
+
+    out << "  " << left << setw(18) << "thread type" << right << setw(8) << "threads";
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+        out << setw(18) << eventName(static_cast<PerfEvent>(i));
+    }
+    out << endl;
+
+    for (const auto& [type, totals] : byType) {
+        out << "  " << left << setw(18) << type << right << setw(8) << totals.threads;
+        for (const auto& value : totals.values) out << setw(18) << formatValue(value);
+        out << endl;
+
+        if (type == "ProcessingThread" && functionsApplied > 0) {
+            out << "  " << left << setw(26) << "  per applied function" << right;
+            for (const auto& value : totals.values) {
+                out << setw(18)
+                    << (value.has_value() ? to_string(value.value() / functionsApplied) : "n/a");
+            }
+            out << endl;
+        }
+    }
+}
@@ -0,0 +1,303 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// Calls create(i) for every i in [0, count) from several threads. Creating a
+// thread costs a clone and a queue allocation each, which adds up for large
+// topologies when done one at a time.
+template <typename Create>
+void createInParallel(int count, Create create) {
+    int workers = min(count, max(1, static_cast<int>(thread::hardware_concurrency())));
+    if (workers <= 1) {
+        for (int i = 0; i < count; ++i) create(i);
+        return;
+    }
+    vector<thread> pool;
+    for (int w = 0; w < workers; ++w) {
+        pool.emplace_back([&create, w, workers, count] {
+            for (int i = w; i < count; i += workers) create(i);
+        });
+    }
+    for (auto& worker : pool) worker.join();
+}
+
+// Moves the thread with the given id out of threads, stopped and with its
+// queue closed so processing threads blocked on it wake up
+template <typename Thread>
+unique_ptr<Thread> takeThread(vector<unique_ptr<Thread>>& threads, int id) {
+    auto it = find_if(threads.begin(), threads.end(),
+                      [id](const auto& thread) { return thread->getId() == id; });
+    if (it == threads.end()) return nullptr;
+    unique_ptr<Thread> thread = move(*it);
+    threads.erase(it);
+    thread->stop();
+    thread->closeQueue();
+    return thread;
+}
+
+}  // namespace
+
+int calculateQueueCapacity(int producers) { return producers * 10; }
+
+Pipeline::Pipeline(const PipelineConfig& config)
+    : config(config),
+      nextDataId(config.dataThreads + FIRST_DATA_ID),
+      nextFunctionId(config.functionThreads + FIRST_FUNCTION_ID),
+      nextProcessingId(config.processingThreads + FIRST_PROCESSING_ID) {
+    if (this->config.dataQueueCapacity <= 0) {
+        this->config.dataQueueCapacity = calculateQueueCapacity(config.dataThreads);
+    }
+    if (this->config.functionQueueCapacity <= 0) {
+        this->config.functionQueueCapacity = calculateQueueCapacity(config.functionThreads);
+    }
+}
+
+Pipeline::~Pipeline() { stop(); }
+
+void Pipeline::startDataThreads() {
+    dataThreads.resize(config.dataThreads);
+    createInParallel(config.dataThreads, [this](int i) {
+        DataSource source = i < static_cast<int>(config.dataSources.size())
+                                ? config.dataSources[i]
+                                : nullptr;
+        vector<DataValue> initial;
+        if (i < static_cast<int>(preloadedData.size())) initial = move(preloadedData[i]);
+        dataThreads[i] = make_unique<DataThread>(i + FIRST_DATA_ID, config.dataQueueCapacity,
+                                                 config.dataPacing, source, config.dataOverflow,
+                                                 initial);
+    });
+    preloadedData.clear();
+    for (const auto& thread : dataThreads) registry.add(thread.get());
+}
+
+void Pipeline::startFunctionThreads() {
+    functionThreads.resize(config.functionThreads);
+    createInParallel(config.functionThreads, [this](int i) {
+        FunctionSource source = i < static_cast<int>(config.functionSources.size())
+                                    ? config.functionSources[i]
+                                    : nullptr;
+        vector<ArithmeticFunction> initial;
+        if (i < static_cast<int>(preloadedFunctions.size())) {
+            initial = move(preloadedFunctions[i]);
+        }
+        functionThreads[i] = make_unique<FunctionThread>(
+            i + FIRST_FUNCTION_ID, config.functionQueueCapacity, config.functionPacing, source,
+            config.functionOverflow, initial);
+    });
+    preloadedFunctions.clear();
+    for (const auto& thread : functionThreads) {
+        attachReorderBuffer(*thread);
+        registry.add(thread.get());
+    }
+}
+
+void Pipeline::attachReorderBuffer(FunctionThread& thread) {
+    if (!config.orderedSink) return;
+    thread.setReorderBuffer(make_unique<ReorderBuffer>(thread.getId(), config.orderedSink,
+                                                       config.reorder, &reorderMetrics));
+}
+
+void Pipeline::startProcessingThreads() {
+    // Partitions exist before their owners start looking for them
+    for (int i = 0; i < config.processingThreads; ++i) {
+        registry.addPartitionOwner(i + FIRST_PROCESSING_ID);
+    }
+    processingThreads.resize(config.processingThreads);
+    createInParallel(config.processingThreads, [this](int i) {
+        processingThreads[i] = makeProcessingThread(i, i + FIRST_PROCESSING_ID);
+    });
+}
+
+unique_ptr<ProcessingThread> Pipeline::makeProcessingThread(int index, int id) {
+    LowLatencyProfile profile = config.lowLatency;
+    if (!profile.cpus.empty()) profile.cpus = {profile.cpus[index % profile.cpus.size()]};
+    return make_unique<ProcessingThread>(id, functionsProcessed, config.maxFunctions, registry,
+                                         config.processingPacing, &latencies, config.memoEntries,
+                                         move(profile), config.queueWait, config.partitioned,
+                                         config.batch);
+}
+
+int Pipeline::addDataThread() {
+    lock_guard<mutex> lock(topologyMtx);
+    if (nextDataId >= FIRST_FUNCTION_ID) throw runtime_error("no free data thread id");
+    int id = nextDataId++;
+    dataThreads.push_back(make_unique<DataThread>(id, config.dataQueueCapacity, config.dataPacing,
+                                                  nullptr, config.dataOverflow));
+    registry.add(dataThreads.back().get());
+    return id;
+}
+
+int Pipeline::addFunctionThread() {
+    lock_guard<mutex> lock(topologyMtx);
+    if (nextFunctionId >= FIRST_PROCESSING_ID) {
+        throw runtime_error("no free function thread id");
+    }
+    int id = nextFunctionId++;
+    functionThreads.push_back(make_unique<FunctionThread>(id, config.functionQueueCapacity,
+                                                          config.functionPacing, nullptr,
+                                                          config.functionOverflow));
+    attachReorderBuffer(*functionThreads.back());
+    registry.add(functionThreads.back().get());
+    return id;
+}
+
+bool Pipeline::retireDataThread(int id) {
+    lock_guard<mutex> lock(topologyMtx);
+    auto thread = takeThread(dataThreads, id);
+    return thread && registry.retire(move(thread));
+}
+
+bool Pipeline::retireFunctionThread(int id) {
+    lock_guard<mutex> lock(topologyMtx);
+    auto thread = takeThread(functionThreads, id);
+    return thread && registry.retire(move(thread));
+}
+
+int Pipeline::addProcessingThread() {
+    lock_guard<mutex> lock(topologyMtx);
+    if (nextProcessingId == numeric_limits<int>::max()) {
+        throw runtime_error("no free processing thread id");
+    }
+    int id = nextProcessingId++;
+    registry.addPartitionOwner(id);
+    processingThreads.push_back(
+        makeProcessingThread(static_cast<int>(processingThreads.size()), id));
+    return id;
+}
+
+bool Pipeline::retireProcessingThread(int id) {
+    unique_ptr<ProcessingThread> thread;
+    {
+        lock_guard<mutex> lock(topologyMtx);
+        auto it = find_if(processingThreads.begin(), processingThreads.end(),
+                          [id](const auto& thread) { return thread->getId() == id; });
+        if (it == processingThreads.end()) return false;
+        thread = move(*it);
+        processingThreads.erase(it);
+        registry.removePartitionOwner(id);
+    }
+    // Joins, possibly after waiting for a blocked pop to be served
+    thread.reset();
+    return true;
+}
+
+void Pipeline::setDataPacing(const Pacing& pacing) {
+    lock_guard<mutex> lock(topologyMtx);
+    config.dataPacing = pacing;
+    for (auto& thread : dataThreads) thread->setDelay(pacing.delayFor(thread->getId()));
+}
+
+void Pipeline::setFunctionPacing(const Pacing& pacing) {
+    lock_guard<mutex> lock(topologyMtx);
+    config.functionPacing = pacing;
+    for (auto& thread : functionThreads) thread->setDelay(pacing.delayFor(thread->getId()));
+}
+
+void Pipeline::setProcessingPacing(const Pacing& pacing) {
+    lock_guard<mutex> lock(topologyMtx);
+    config.processingPacing = pacing;
+    if (config.lowLatency.busyPoll) return;
+    for (auto& thread : processingThreads) thread->setDelay(pacing.delayFor(thread->getId()));
+}
+
+void Pipeline::setDataQueueCapacity(int capacity) {
+    lock_guard<mutex> lock(topologyMtx);
+    config.dataQueueCapacity = capacity;
+    for (auto& thread : dataThreads) thread->setQueueCapacity(capacity);
+}
+
+void Pipeline::setFunctionQueueCapacity(int capacity) {
+    lock_guard<mutex> lock(topologyMtx);
+    config.functionQueueCapacity = capacity;
+    for (auto& thread : functionThreads) thread->setQueueCapacity(capacity);
+}
+
+void Pipeline::setDataOverflowPolicy(OverflowPolicy policy) {
+    lock_guard<mutex> lock(topologyMtx);
+    config.dataOverflow = policy;
+    for (auto& thread : dataThreads) thread->setOverflowPolicy(policy);
+}
+
+void Pipeline::setFunctionOverflowPolicy(OverflowPolicy policy) {
+    lock_guard<mutex> lock(topologyMtx);
+    config.functionOverflow = policy;
+    for (auto& thread : functionThreads) thread->setOverflowPolicy(policy);
+}
+
+OverflowCounts Pipeline::getOverflowCounts() const {
+    OverflowCounts counts;
+    auto add = [&counts](const auto& queue) {
+        counts.dropped += queue.droppedCount();
+        counts.rejected += queue.rejectedCount();
+    };
+    for (const auto& thread : dataThreads) add(thread->getQueue());
+    for (const auto& thread : functionThreads) add(thread->getQueue());
+    return counts;
+}
+
+bool Pipeline::waitForPrefill(int level, chrono::milliseconds timeout) const {
+    auto deadline = chrono::steady_clock::now() + timeout;
+    auto filled = [level](const auto& threads, int capacity) {
+        size_t target = static_cast<size_t>(min(level, capacity));
+        return all_of(threads.begin(), threads.end(),
+                      [target](const auto& thread) { return thread->getQueueSize() >= target; });
+    };
+    while (!filled(dataThreads, config.dataQueueCapacity) ||
+           !filled(functionThreads, config.functionQueueCapacity)) {
+        if (chrono::steady_clock::now() >= deadline) return false;
+        this_thread::sleep_for(chrono::microseconds(200));
+    }
+    return true;
+}
+
+void Pipeline::preloadQueues(vector<vector<DataValue>> data,
+                             vector<vector<ArithmeticFunction>> functions) {
+    preloadedData = move(data);
+    preloadedFunctions = move(functions);
+}
+
+MemoStats Pipeline::getMemoStats() const {
+    MemoStats total;
+    for (const auto& thread : processingThreads) {
+        if (thread->getMemoCache()) total += thread->getMemoCache()->getStats();
+    }
+    return total;
+}
+
+BatchStats Pipeline::getBatchStats() const {
+    BatchStats total;
+    for (const auto& thread : processingThreads) total += thread->getBatchStats();
+    return total;
+}
+
+void Pipeline::start() {
+    startDataThreads();
+    startFunctionThreads();
+    startProcessingThreads();
+}
+
+void Pipeline::stop() {
+    for (auto& thread : processingThreads) thread->stop();
+    for (auto& thread : dataThreads) thread->stop();
+    for (auto& thread : functionThreads) thread->stop();
+
+    // Generators may be blocked on a full queue and processors on an empty one
+    for (auto& thread : dataThreads) thread->closeQueue();
+    for (auto& thread : functionThreads) thread->closeQueue();
+
+    for (auto& thread : processingThreads) thread->join();
+    for (auto& thread : dataThreads) thread->join();
+    for (auto& thread : functionThreads) thread->join();
+    // No reader is left, so every retired generator goes now
+    registry.synchronize();
+    // Nothing completes any more: release what waits behind gaps
+    for (auto& thread : functionThreads) {
+        if (thread->getReorderBuffer()) thread->getReorderBuffer()->flush();
+    }
+}
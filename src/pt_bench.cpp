@@ -0,0 +1,394 @@
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "durable_queue.h"
+#include "lookup_table.h"
+#include "memo_cache.h"
+#include "option_list.h"
+#include "random.h"
+
+using namespace std;
+
+// Microbenchmarks of individual components: pt_bench <benchmark> [options]
+
+namespace {
+
+volatile double sink;  // keeps measured results from being optimized away
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Durable queue throughput per group-commit interval
+int benchWal(int argc, char* argv[]) {
+    string directory = "pt_bench_wal";
+    int items = 5000;
+    int producers = 4;
+    vector<double> intervalsMs{0, 0.2, 1, 5};
+    bool waitForCommit = true;
+
+    for (int i = 0; i < argc; ++i) {
+        string option = argv[i];
+        auto value = [&option](const string& prefix) { return option.substr(prefix.size()); };
+        if (option.rfind("--dir=", 0) == 0) {
+            directory = value("--dir=");
+        } else if (option.rfind("--items=", 0) == 0) {
+            items = stoi(value("--items="));
+        } else if (option.rfind("--producers=", 0) == 0) {
+            producers = stoi(value("--producers="));
+        } else if (option.rfind("--intervals=", 0) == 0) {
+            intervalsMs = parseList<double>(value("--intervals="));
+        } else if (option == "--no-wait") {
+            waitForCommit = false;
+        } else {
+            cerr << "Error: Unknown wal option " << option << endl;
+            return 1;
+        }
+    }
+    if (items <= 0 || producers <= 0) {
+        cerr << "Error: --items and --producers must be positive" << endl;
+        return 1;
+    }
+
+    cout << "Durable queue: " << items << " items from " << producers << " producers into "
+         << directory << (waitForCommit ? ", each push waits for its commit" : "") << endl;
+    cout << setw(12) << "interval_ms" << setw(14) << "push_items/s" << setw(10) << "syncs"
+         << setw(12) << "items/sync" << setw(13) << "recovery_ms" << setw(11) << "recovered"
+         << setw(13) << "pop_items/s" << endl;
+
+    for (double intervalMs : intervalsMs) {
+        filesystem::remove_all(directory);
+        WalOptions options;
+        options.commitInterval = chrono::microseconds(static_cast<long long>(intervalMs * 1000));
+
+        // Concurrent producers share commits; nothing is popped yet
+        double pushSeconds;
+        WalStats stats;
+        {
+            DurableQueue<DataValue> queue(directory, items, options, waitForCommit);
+            auto start = chrono::steady_clock::now();
+            vector<thread> threads;
+            for (int p = 0; p < producers; ++p) {
+                threads.emplace_back([&queue, p, producers, items] {
+                    for (int i = p; i < items; i += producers) queue.push(i);
+                });
+            }
+            for (auto& thread : threads) thread.join();
+            pushSeconds = secondsSince(start);
+            stats = queue.getLogStats();
+            queue.close();
+        }
+
+        // Reopening replays the log; popping appends acknowledgements
+        auto start = chrono::steady_clock::now();
+        DurableQueue<DataValue> reopened(directory, items, options, false);
+        double recoverySeconds = secondsSince(start);
+        size_t recovered = reopened.recoveredCount();
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < recovered; ++i) reopened.pop();
+        double popSeconds = secondsSince(start);
+        reopened.close();
+
+        cout << fixed << setprecision(1) << setw(12) << intervalMs << setw(14)
+             << items / pushSeconds << setw(10) << stats.syncs << setw(12)
+             << (stats.syncs > 0 ? static_cast<double>(stats.appends) / stats.syncs : 0.0)
+             << setw(13) << recoverySeconds * 1000 << setw(11) << recovered << setw(13)
+             << (popSeconds > 0 ? recovered / popSeconds : 0.0) << defaultfloat << endl;
+        if (recovered != static_cast<size_t>(items)) {
+            cerr << "Error: recovered " << recovered << " of " << items << " items" << endl;
+            return 1;
+        }
+    }
+    filesystem::remove_all(directory);
+    return 0;
+}
+
+// Applications with and without the int/int lookup table, on function and
+// argument mixes shaped like the generator threads' output with a given share
+// of int values
+int benchLut(int argc, char* argv[]) {
+    int iterations = 1000000;
+    vector<double> intShares{1.0 / 3, 0.8, 1};
+
+    for (int i = 0; i < argc; ++i) {
+        string option = argv[i];
+        auto value = [&option](const string& prefix) { return option.substr(prefix.size()); };
+        if (option.rfind("--iterations=", 0) == 0) {
+            iterations = stoi(value("--iterations="));
+        } else if (option.rfind("--int-shares=", 0) == 0) {
+            intShares = parseList<double>(value("--int-shares="));
+        } else {
+            cerr << "Error: Unknown lut option " << option << endl;
+            return 1;
+        }
+    }
+    if (iterations <= 0) {
+        cerr << "Error: --iterations must be positive" << endl;
+        return 1;
+    }
+
+    cout << "Int/int lookup table: " << iterations << " applications per mix" << endl;
+    cout << setw(10) << "int_share" << setw(10) << "hit_rate" << setw(12) << "compute_ns"
+         << setw(10) << "lut_ns" << setw(10) << "speedup" << endl;
+
+    for (double intShare : intShares) {
+        mt19937 gen(12345);
+        bernoulli_distribution isInt(min(intShare, 1.0));
+        uniform_int_distribution<> otherType(1, 2);
+        uniform_int_distribution<> dataInt(DATA_MIN_VALUE, DATA_MAX_VALUE);
+        uniform_int_distribution<> constInt(-20, 20);
+        uniform_real_distribution<double> real(DATA_MIN_VALUE, DATA_MAX_VALUE);
+        uniform_int_distribution<> selector(0, 3);
+        auto randomValue = [&](uniform_int_distribution<>& ints) -> DataValue {
+            if (isInt(gen)) return ints(gen);
+            if (otherType(gen) == 1) return static_cast<float>(real(gen));
+            return complex<double>(real(gen), real(gen));
+        };
+
+        vector<ArithmeticFunction> functions(4096);
+        vector<vector<DataValue>> arguments(functions.size());
+        size_t hits = 0;
+        for (size_t f = 0; f < functions.size(); ++f) {
+            functions[f].op = static_cast<Operation>(selector(gen));
+            int pattern = selector(gen);
+            if (pattern == 1 || pattern == 3) functions[f].right_operand = randomValue(constInt);
+            if (pattern == 2 || pattern == 3) functions[f].left_operand = randomValue(constInt);
+            for (size_t a = 0; a < functions[f].requiredArgs(); ++a) {
+                arguments[f].push_back(randomValue(dataInt));
+            }
+            const DataValue& left = functions[f].left_operand.value_or(
+                arguments[f].empty() ? DataValue() : arguments[f][0]);
+            const DataValue& right = functions[f].right_operand.value_or(
+                arguments[f].empty() ? DataValue() : arguments[f].back());
+            if (holds_alternative<int>(left) && holds_alternative<int>(right)) ++hits;
+        }
+
+        auto run = [&](bool useTable) {
+            IntLookupTable::enable(useTable);
+            double checksum = 0;
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                size_t f = static_cast<size_t>(i) % functions.size();
+                try {
+                    DataValue result = functions[f].apply(arguments[f]);
+                    if (const int* value = get_if<int>(&result)) checksum += *value;
+                } catch (const runtime_error&) {
+                }
+            }
+            double ns = secondsSince(start) * 1e9 / iterations;
+            sink = checksum;
+            return ns;
+        };
+        run(false);  // warm up
+        double computeNs = run(false);
+        double lutNs = run(true);
+        IntLookupTable::enable(false);
+
+        cout << fixed << setprecision(2) << setw(10) << intShare << setw(10)
+             << static_cast<double>(hits) / functions.size() << setw(12) << computeNs
+             << setw(10) << lutNs << setw(10) << computeNs / lutNs << endl;
+    }
+    return 0;
+}
+
+// Applications with and without a memo cache, for workloads drawing their
+// arguments from pools of different sizes (mostly complex by default)
+int benchMemo(int argc, char* argv[]) {
+    int iterations = 1000000;
+    size_t entries = 4096;
+    vector<int> distinct{16, 256, 4096, 65536};
+    double complexShare = 0.8;
+
+    for (int i = 0; i < argc; ++i) {
+        string option = argv[i];
+        auto value = [&option](const string& prefix) { return option.substr(prefix.size()); };
+        if (option.rfind("--iterations=", 0) == 0) {
+            iterations = stoi(value("--iterations="));
+        } else if (option.rfind("--entries=", 0) == 0) {
+            entries = static_cast<size_t>(stoi(value("--entries=")));
+        } else if (option.rfind("--distinct=", 0) == 0) {
+            distinct = parseList<int>(value("--distinct="));
+        } else if (option.rfind("--complex-share=", 0) == 0) {
+            complexShare = stod(value("--complex-share="));
+        } else {
+            cerr << "Error: Unknown memo option " << option << endl;
+            return 1;
+        }
+    }
+    if (iterations <= 0 || entries == 0 || complexShare < 0 || complexShare > 1) {
+        cerr << "Error: --iterations and --entries must be positive, --complex-share in 0..1"
+             << endl;
+        return 1;
+    }
+
+    cout << "Memo cache: " << entries << " entries, " << iterations
+         << " applications per argument pool, " << complexShare * 100 << "% complex values"
+         << endl;
+    cout << setw(10) << "distinct" << setw(10) << "hit_rate" << setw(12) << "compute_ns"
+         << setw(10) << "memo_ns" << setw(10) << "speedup" << endl;
+
+    for (int poolSize : distinct) {
+        if (poolSize <= 0) continue;
+        mt19937 gen(12345);
+        bernoulli_distribution isComplex(complexShare);
+        uniform_int_distribution<> smallInt(-20, 20);
+        uniform_real_distribution<double> real(DATA_MIN_VALUE, DATA_MAX_VALUE);
+        uniform_int_distribution<> selector(0, 3);
+
+        vector<DataValue> pool;
+        for (int v = 0; v < poolSize; ++v) {
+            if (isComplex(gen)) {
+                pool.push_back(complex<double>(real(gen), real(gen)));
+            } else {
+                pool.push_back(smallInt(gen));
+            }
+        }
+        // Functions with constants from the function threads' small ranges
+        vector<ArithmeticFunction> functions(64);
+        for (auto& function : functions) {
+            function.op = static_cast<Operation>(selector(gen));
+            if (selector(gen) % 2 == 1) function.right_operand = smallInt(gen);
+        }
+        uniform_int_distribution<size_t> pickFunction(0, functions.size() - 1);
+        uniform_int_distribution<size_t> pickValue(0, pool.size() - 1);
+        vector<size_t> calls;
+        vector<vector<DataValue>> arguments;
+        for (int c = 0; c < 1 << 16; ++c) {
+            calls.push_back(pickFunction(gen));
+            vector<DataValue> args;
+            for (size_t a = 0; a < functions[calls.back()].requiredArgs(); ++a) {
+                args.push_back(pool[pickValue(gen)]);
+            }
+            arguments.push_back(args);
+        }
+
+        MemoCache memo(entries);
+        auto run = [&](MemoCache* cache) {
+            double checksum = 0;
+            auto start = chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i) {
+                // Step through the calls with a stride, so each pass revisits
+                // them in a different order
+                size_t c = static_cast<size_t>(i) * 7 % calls.size();
+                const ArithmeticFunction& function = functions[calls[c]];
+                try {
+                    DataValue result = cache ? cache->apply(function, arguments[c])
+                                             : function.apply(arguments[c]);
+                    if (const int* value = get_if<int>(&result)) checksum += *value;
+                } catch (const runtime_error&) {
+                }
+            }
+            sink = checksum;
+            return secondsSince(start) * 1e9 / iterations;
+        };
+        run(nullptr);  // warm up
+        double computeNs = run(nullptr);
+        double memoNs = run(&memo);
+
+        cout << fixed << setprecision(2) << setw(10) << poolSize << setw(10)
+             << memo.getStats().hitRatio() << setw(12) << computeNs << setw(10) << memoNs
+             << setw(10) << computeNs / memoNs << endl;
+    }
+    return 0;
+}
+
+// Creating per-thread generators: one std::random_device and std::mt19937
+// each, as threads used to, against SeedService seeds and the thread generator
+int benchSeeding(int argc, char* argv[]) {
+    int objects = 10000;
+    for (int i = 0; i < argc; ++i) {
+        string option = argv[i];
+        if (option.rfind("--objects=", 0) == 0) {
+            objects = stoi(option.substr(10));
+        } else {
+            cerr << "Error: Unknown seeding option " << option << endl;
+            return 1;
+        }
+    }
+    if (objects <= 0) {
+        cerr << "Error: --objects must be positive" << endl;
+        return 1;
+    }
+
+    struct DeviceSeeded {
+        random_device rd;
+        mt19937 gen{rd()};
+    };
+    auto start = chrono::steady_clock::now();
+    {
+        vector<unique_ptr<DeviceSeeded>> generators;
+        for (int i = 0; i < objects; ++i) generators.push_back(make_unique<DeviceSeeded>());
+        sink = generators.back()->gen();
+    }
+    double deviceUs = secondsSince(start) * 1e6 / objects;
+
+    start = chrono::steady_clock::now();
+    {
+        vector<unique_ptr<ThreadRng>> generators;
+        for (int i = 0; i < objects; ++i) {
+            generators.push_back(make_unique<ThreadRng>(SeedService::instance().seedFor(i)));
+        }
+        sink = (*generators.back())();
+    }
+    double serviceUs = secondsSince(start) * 1e6 / objects;
+
+    cout << "Creating " << objects << " per-thread generators" << endl;
+    cout << setw(28) << "generator" << setw(10) << "bytes" << setw(14) << "us_per_object"
+         << endl;
+    cout << fixed << setprecision(3);
+    cout << setw(28) << "random_device + mt19937" << setw(10) << sizeof(DeviceSeeded) << setw(14)
+         << deviceUs << endl;
+    cout << setw(28) << "SeedService + ThreadRng" << setw(10) << sizeof(ThreadRng) << setw(14)
+         << serviceUs << endl;
+    return 0;
+}
+
+struct Benchmark {
+    const char* name;
+    const char* options;
+    int (*run)(int argc, char* argv[]);
+};
+
+const Benchmark BENCHMARKS[] = {
+    {"wal",
+     "[--dir=<path>] [--items=<n>] [--producers=<n>] [--intervals=<ms list>] [--no-wait]",
+     benchWal},
+    {"lut", "[--iterations=<n>] [--int-shares=<0..1 list>]", benchLut},
+    {"memo", "[--iterations=<n>] [--entries=<n>] [--distinct=<list>] [--complex-share=<0..1>]",
+     benchMemo},
+    {"seeding", "[--objects=<n>]", benchSeeding},
+};
+
+void printUsage(const char* programName) {
+    cout << "Usage: " << programName << " <benchmark> [options]" << endl;
+    for (const auto& benchmark : BENCHMARKS) {
+        cout << "  " << benchmark.name << " " << benchmark.options << endl;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    string name = argv[1];
+    for (const auto& benchmark : BENCHMARKS) {
+        if (name != benchmark.name) continue;
+        try {
+            return benchmark.run(argc - 2, argv + 2);
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+    }
+    printUsage(argv[0]);
+    return name == "-h" || name == "--help" ? 0 : 1;
+}
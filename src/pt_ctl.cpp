@@ -0,0 +1,47 @@
+#include <iostream>
+#include <string>
+
+#include "control.h"
+
+using namespace std;
+
+// Command-line client of the control socket of processing_threads --control
+
+namespace {
+
+void printUsage(const char* programName) {
+    cout << "Usage: " << programName << " <socket> <command> [arguments...]" << endl;
+    cout << "  socket  - path given to processing_threads --control=<socket>" << endl;
+    cout << "  command - one of the following; the reply is printed" << endl;
+    cout << "    stats" << endl;
+    cout << "    rate <data|function|processing> <factor|max>" << endl;
+    cout << "    add <data|function|processing> [count]" << endl;
+    cout << "    remove <data|function|processing> [id]" << endl;
+    cout << "    capacity <data|function> <n>" << endl;
+    cout << "    overflow <data|function> <block|drop-newest|drop-oldest|reject>" << endl;
+    cout << "    log <off|errors|all>" << endl;
+    cout << "    snapshot <file>" << endl;
+    cout << endl;
+    cout << "Example: " << programName << " /tmp/pt.sock rate data 2" << endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    string command = argv[2];
+    for (int i = 3; i < argc; ++i) command += string(" ") + argv[i];
+
+    string reply, error;
+    if (!sendControlCommand(argv[1], command, reply, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    cout << reply;
+    // The status line is the last one
+    bool ok = reply.size() >= 3 && reply.compare(reply.size() - 3, 3, "ok\n") == 0;
+    return ok ? 0 : 1;
+}
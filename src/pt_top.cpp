@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+
+#include "live_stats.h"
+
+using namespace std;
+
+// Read-only viewer of the live statistics published by processing_threads --live-stats
+
+namespace {
+
+volatile sig_atomic_t interrupted = 0;
+
+void onInterrupt(int) { interrupted = 1; }
+
+void printUsage(const char* programName) {
+    cout << "Usage: " << programName << " [segment] [refresh_ms] [--once]" << endl;
+    cout << "  segment    - shared-memory name (default: " << LIVE_STATS_DEFAULT_NAME << ")"
+         << endl;
+    cout << "  refresh_ms - refresh interval in milliseconds (default: 1000)" << endl;
+    cout << "  --once     - print a single snapshot and exit" << endl;
+}
+
+const char* kindName(StatsKind kind) {
+    switch (kind) {
+        case StatsKind::DATA:
+            return "data";
+        case StatsKind::FUNCTION:
+            return "function";
+        case StatsKind::PROCESSING:
+            return "processing";
+    }
+    return "?";
+}
+
+// Counter values remembered between refreshes to derive rates
+struct Previous {
+    vector<uint32_t> queueGenerations;
+    vector<uint32_t> threadGenerations;
+    vector<uint64_t> pushed;
+    vector<uint64_t> popped;
+    vector<uint64_t> operations;
+    chrono::steady_clock::time_point time;
+};
+
+void render(const LiveStatsSegment& segment, Previous& previous, bool clearScreen) {
+    auto now = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(now - previous.time).count();
+    bool haveRates = previous.time != chrono::steady_clock::time_point{} && seconds > 0;
+    uint32_t queueCount = segment.queueCount.load(memory_order_acquire);
+    uint32_t threadCount = segment.threadCount.load(memory_order_acquire);
+    previous.queueGenerations.resize(queueCount);
+    previous.threadGenerations.resize(threadCount);
+    previous.pushed.resize(queueCount);
+    previous.popped.resize(queueCount);
+    previous.operations.resize(threadCount);
+
+    // Slots of destroyed queues and threads have an even generation
+    auto live = [](const auto& slot) {
+        return slot.generation.load(memory_order_acquire) % 2 == 1;
+    };
+    size_t liveQueues = count_if(segment.queues, segment.queues + queueCount, live);
+    size_t liveThreads = count_if(segment.threads, segment.threads + threadCount, live);
+
+    if (clearScreen) cout << "\033[H\033[2J";
+    cout << "processing_threads pid " << segment.pid << " - " << liveQueues << " queues, "
+         << liveThreads << " threads" << endl
+         << endl;
+
+    cout << left << setw(8) << "queue" << setw(10) << "kind" << right << setw(10) << "depth"
+         << setw(10) << "capacity" << setw(8) << "fill%" << setw(12) << "push/s" << setw(12)
+         << "pop/s" << endl;
+    for (uint32_t i = 0; i < queueCount; ++i) {
+        const QueueStats& queue = segment.queues[i];
+        uint32_t generation = queue.generation.load(memory_order_acquire);
+        if (generation % 2 == 0) continue;
+        uint64_t pushed = queue.pushed.load(memory_order_relaxed);
+        uint64_t popped = queue.popped.load(memory_order_relaxed);
+        // Elements evicted by drop-oldest left without a pop
+        uint64_t left = popped + queue.evicted.load(memory_order_relaxed);
+        int32_t capacity = queue.capacity.load(memory_order_relaxed);
+        // A reused slot restarts its counters
+        bool sameQueue = generation == previous.queueGenerations[i];
+        // The counters are read non-atomically as a set; clamp a transiently negative depth
+        uint64_t depth = pushed > left ? pushed - left : 0;
+        cout << left << setw(8) << queue.queueId << setw(10) << kindName(queue.kind) << right
+             << setw(10) << depth << setw(10) << capacity << setw(8) << fixed
+             << setprecision(0) << (capacity > 0 ? 100.0 * depth / capacity : 0.0)
+             << setprecision(1) << setw(12)
+             << (haveRates && sameQueue ? (pushed - previous.pushed[i]) / seconds : 0.0)
+             << setw(12)
+             << (haveRates && sameQueue ? (popped - previous.popped[i]) / seconds : 0.0) << endl;
+        previous.queueGenerations[i] = generation;
+        previous.pushed[i] = pushed;
+        previous.popped[i] = popped;
+    }
+
+    cout << endl
+         << left << setw(8) << "thread" << setw(12) << "kind" << right << setw(12) << "ops"
+         << setw(12) << "ops/s" << setw(14) << "avg lat(us)" << setw(14) << "max lat(us)" << endl;
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        const ThreadStats& thread = segment.threads[i];
+        uint32_t generation = thread.generation.load(memory_order_acquire);
+        if (generation % 2 == 0) continue;
+        bool sameThread = generation == previous.threadGenerations[i];
+        uint64_t operations = thread.operations.load(memory_order_relaxed);
+        uint64_t latencySum = thread.latencySumNs.load(memory_order_relaxed);
+        uint64_t latencyMax = thread.latencyMaxNs.load(memory_order_relaxed);
+        cout << left << setw(8) << thread.threadId << setw(12) << kindName(thread.kind) << right
+             << setw(12) << operations << setw(12)
+             << (haveRates && sameThread ? (operations - previous.operations[i]) / seconds : 0.0)
+             << setw(14)
+             << (operations > 0 ? latencySum / 1000.0 / operations : 0.0) << setw(14)
+             << latencyMax / 1000.0 << endl;
+        previous.threadGenerations[i] = generation;
+        previous.operations[i] = operations;
+    }
+    cout << flush;
+    previous.time = now;
+}
+
+bool processAlive(int pid) { return kill(pid, 0) == 0 || errno == EPERM; }
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    string name = LIVE_STATS_DEFAULT_NAME;
+    int refreshMs = 1000;
+    bool once = false;
+    vector<string> positional;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--once") {
+            once = true;
+        } else if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    try {
+        if (positional.size() > 0) name = positional[0];
+        if (positional.size() > 1) refreshMs = stoi(positional[1]);
+        if (positional.size() > 2 || refreshMs <= 0) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    } catch (const exception& e) {
+        cerr << "Error: Invalid argument - " << e.what() << endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    string error;
+    const LiveStatsSegment* segment = attachLiveStats(name, error);
+    if (!segment) {
+        cerr << "Error: " << error << endl;
+        cerr << "Is processing_threads running with --live-stats?" << endl;
+        return 1;
+    }
+
+    signal(SIGINT, onInterrupt);
+    Previous previous;
+    while (!interrupted) {
+        render(*segment, previous, !once);
+        if (once) break;
+        if (!processAlive(segment->pid)) {
+            cout << endl << "Process " << segment->pid << " has exited" << endl;
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(refreshMs));
+    }
+
+    detachLiveStats(segment);
+    return 0;
+}
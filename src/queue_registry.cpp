@@ -0,0 +1,154 @@
+#include "queue_registry.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "threads.h"
+
+using namespace std;
+
+// All epoch and snapshot accesses are sequentially consistent. A reader stores
+// its epoch before loading the snapshot, a writer swaps the snapshot before
+// advancing the epoch and scans the slots after: a reader the scan sees idle
+// or at the new epoch therefore loads the new snapshot.
+
+QueueRegistry::ReadGuard::~ReadGuard() { slot.store(0); }
+
+QueueRegistry::ReadGuard QueueRegistry::Reader::read() {
+    slot.store(registry.epoch.load());
+    return ReadGuard(slot, registry.current.load());
+}
+
+QueueRegistry::Reader::~Reader() {
+    lock_guard<mutex> lock(registry.writeMtx);
+    for (auto& readerSlot : registry.slots) {
+        if (&readerSlot.epoch == &slot) readerSlot.inUse = false;
+    }
+}
+
+QueueRegistry::QueueRegistry() : current(new Snapshot()) {}
+
+QueueRegistry::~QueueRegistry() { delete current.load(); }
+
+unique_ptr<QueueRegistry::Reader> QueueRegistry::registerReader() {
+    lock_guard<mutex> lock(writeMtx);
+    auto free = find_if(slots.begin(), slots.end(),
+                        [](const ReaderSlot& readerSlot) { return !readerSlot.inUse; });
+    ReaderSlot& readerSlot = free != slots.end() ? *free : slots.emplace_back();
+    readerSlot.inUse = true;
+    return unique_ptr<Reader>(new Reader(*this, readerSlot.epoch));
+}
+
+void QueueRegistry::add(DataThread* thread) {
+    vector<Retired> reclaimed;
+    lock_guard<mutex> lock(writeMtx);
+    auto next = make_unique<Snapshot>(*current.load());
+    next->dataThreads.push_back(thread);
+    publish(move(next), nullptr);
+    collectLocked(reclaimed);
+}
+
+void QueueRegistry::add(FunctionThread* thread) {
+    vector<Retired> reclaimed;
+    lock_guard<mutex> lock(writeMtx);
+    auto next = make_unique<Snapshot>(*current.load());
+    next->functionThreads.push_back(thread);
+    publish(move(next), nullptr);
+    collectLocked(reclaimed);
+}
+
+void QueueRegistry::addPartitionOwner(int processingId) {
+    vector<Retired> reclaimed;
+    lock_guard<mutex> lock(writeMtx);
+    auto next = make_unique<Snapshot>(*current.load());
+    next->partitions.add(processingId);
+    publish(move(next), nullptr);
+    collectLocked(reclaimed);
+}
+
+void QueueRegistry::removePartitionOwner(int processingId) {
+    vector<Retired> reclaimed;
+    lock_guard<mutex> lock(writeMtx);
+    auto next = make_unique<Snapshot>(*current.load());
+    next->partitions.remove(processingId);
+    publish(move(next), nullptr);
+    collectLocked(reclaimed);
+}
+
+int QueueRegistry::partitionOwner(int generatorId) const {
+    lock_guard<mutex> lock(writeMtx);
+    return current.load()->partitions.owner(static_cast<uint64_t>(generatorId));
+}
+
+bool QueueRegistry::retire(unique_ptr<DataThread> thread) {
+    return retireThread(move(thread), &Snapshot::dataThreads);
+}
+
+bool QueueRegistry::retire(unique_ptr<FunctionThread> thread) {
+    return retireThread(move(thread), &Snapshot::functionThreads);
+}
+
+template <typename Thread>
+bool QueueRegistry::retireThread(unique_ptr<Thread> thread, vector<Thread*> Snapshot::*member) {
+    // Destroying a thread joins it, so reclaimed objects die after the unlock
+    vector<Retired> reclaimed;
+    {
+        lock_guard<mutex> lock(writeMtx);
+        auto next = make_unique<Snapshot>(*current.load());
+        auto& threads = (*next).*member;
+        auto it = find(threads.begin(), threads.end(), thread.get());
+        if (it == threads.end()) return false;
+        threads.erase(it);
+        publish(move(next), move(thread));
+        collectLocked(reclaimed);
+    }
+    return true;
+}
+
+void QueueRegistry::publish(unique_ptr<Snapshot> next, unique_ptr<BaseThread> thread) {
+    next->version = current.load()->version + 1;
+    unique_ptr<Snapshot> previous(current.exchange(next.release()));
+    uint64_t retireEpoch = epoch.fetch_add(1) + 1;
+    retired.push_back({retireEpoch, move(previous), move(thread)});
+}
+
+void QueueRegistry::collectLocked(vector<Retired>& out) {
+    // Oldest epoch a reader may still hold pointers from
+    uint64_t oldest = UINT64_MAX;
+    for (const auto& readerSlot : slots) {
+        uint64_t entered = readerSlot.epoch.load();
+        if (readerSlot.inUse && entered != 0) oldest = min(oldest, entered);
+    }
+    auto unreachable = stable_partition(retired.begin(), retired.end(),
+                                        [oldest](const Retired& r) { return r.epoch > oldest; });
+    move(unreachable, retired.end(), back_inserter(out));
+    retired.erase(unreachable, retired.end());
+}
+
+void QueueRegistry::reclaim() {
+    vector<Retired> reclaimed;
+    lock_guard<mutex> lock(writeMtx);
+    collectLocked(reclaimed);
+}
+
+void QueueRegistry::synchronize() {
+    while (true) {
+        vector<Retired> reclaimed;
+        {
+            lock_guard<mutex> lock(writeMtx);
+            collectLocked(reclaimed);
+            if (retired.empty()) return;
+        }
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+}
+
+size_t QueueRegistry::retiredCount() const {
+    lock_guard<mutex> lock(writeMtx);
+    return retired.size();
+}
+
+uint64_t QueueRegistry::getVersion() const {
+    lock_guard<mutex> lock(writeMtx);
+    return current.load()->version;
+}
@@ -0,0 +1,106 @@
+#include "queue_sampler.h"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace std;
+
+QueueSampler::QueueSampler(chrono::milliseconds interval, size_t maxSamples)
+    : interval(interval), maxSamples(maxSamples > 0 ? maxSamples : 1) {}
+
+QueueSampler::~QueueSampler() { stop(); }
+
+void QueueSampler::start() {
+    if (running) return;
+    {
+        lock_guard<mutex> lock(mtx);
+        values.assign(maxSamples * sources.size(), 0);
+        timestampsUs.assign(maxSamples, 0);
+        nextRow = 0;
+        rowCount = 0;
+        startTime = chrono::steady_clock::now();
+    }
+    running = true;
+    samplerThread = thread(&QueueSampler::sampleLoop, this);
+}
+
+void QueueSampler::stop() {
+    {
+        lock_guard<mutex> lock(mtx);
+        running = false;
+    }
+    cv.notify_all();
+    if (samplerThread.joinable()) samplerThread.join();
+}
+
+void QueueSampler::sampleLoop() {
+    auto next = chrono::steady_clock::now();
+    unique_lock<mutex> lock(mtx);
+    while (running) {
+        lock.unlock();
+        sampleNow();
+        lock.lock();
+        // Fixed-rate schedule so slow samples do not stretch the interval
+        next += interval;
+        cv.wait_until(lock, next, [this] { return !running; });
+    }
+}
+
+void QueueSampler::sampleNow() {
+    // Read all queues before taking the buffer lock to keep the row tight in time
+    auto now = chrono::steady_clock::now();
+    vector<uint32_t> row;
+    row.reserve(sources.size());
+    for (const auto& source : sources) row.push_back(static_cast<uint32_t>(source.read()));
+
+    lock_guard<mutex> lock(mtx);
+    if (values.size() != maxSamples * sources.size()) {
+        // Sampling without start(): size the buffer lazily
+        values.assign(maxSamples * sources.size(), 0);
+        timestampsUs.assign(maxSamples, 0);
+        startTime = now;
+    }
+    copy(row.begin(), row.end(), values.begin() + nextRow * sources.size());
+    timestampsUs[nextRow] = chrono::duration_cast<chrono::microseconds>(now - startTime).count();
+    nextRow = (nextRow + 1) % maxSamples;
+    if (rowCount < maxSamples) rowCount++;
+}
+
+size_t QueueSampler::sampleCount() const {
+    lock_guard<mutex> lock(mtx);
+    return rowCount;
+}
+
+size_t QueueSampler::rowIndex(size_t sample) const {
+    // Oldest row first once the ring has wrapped
+    size_t oldest = rowCount < maxSamples ? 0 : nextRow;
+    return (oldest + sample) % maxSamples;
+}
+
+vector<uint32_t> QueueSampler::samplesFor(size_t queueIndex) const {
+    lock_guard<mutex> lock(mtx);
+    vector<uint32_t> result;
+    if (queueIndex >= sources.size()) return result;
+    for (size_t i = 0; i < rowCount; ++i) {
+        result.push_back(values[rowIndex(i) * sources.size() + queueIndex]);
+    }
+    return result;
+}
+
+bool QueueSampler::writeCsv(const string& path) const {
+    ofstream out(path);
+    if (!out) return false;
+
+    lock_guard<mutex> lock(mtx);
+    out << "time_ms";
+    for (const auto& source : sources) out << "," << source.kind << "_" << source.queueId;
+    out << "\n";
+
+    for (size_t i = 0; i < rowCount; ++i) {
+        size_t row = rowIndex(i);
+        out << timestampsUs[row] / 1000 << "." << timestampsUs[row] % 1000 / 100;
+        for (size_t q = 0; q < sources.size(); ++q) out << "," << values[row * sources.size() + q];
+        out << "\n";
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,35 @@
+#include "random.h"
+
+#include <random>
+
+using namespace std;
+
+SeedService& SeedService::instance() {
+    static SeedService service;
+    return service;
+}
+
+void SeedService::setSeed(uint64_t seed) {
+    lock_guard<mutex> lock(mtx);
+    base = seed;
+    fixed = true;
+    seeded = true;
+}
+
+void SeedService::clearSeed() {
+    lock_guard<mutex> lock(mtx);
+    fixed = false;
+}
+
+uint64_t SeedService::seedFor(uint64_t stream) {
+    if (!seeded.load(memory_order_acquire)) {
+        lock_guard<mutex> lock(mtx);
+        if (!seeded.load(memory_order_relaxed)) {
+            random_device device;
+            base = static_cast<uint64_t>(device()) << 32 | device();
+            seeded.store(true, memory_order_release);
+        }
+    }
+    uint64_t seed = splitmix64(base ^ splitmix64(stream));
+    return fixed ? seed : splitmix64(seed + calls.fetch_add(1, memory_order_relaxed));
+}
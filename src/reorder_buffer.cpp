@@ -0,0 +1,194 @@
+#include "reorder_buffer.h"
+
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// Slot sequence while one thread moves a result out of it
+constexpr uint64_t BUSY = UINT64_MAX;
+
+}  // namespace
+
+// Slot sequences, the head and the draining flag (a spinlock only ever tried
+// on the drain path) are sequentially consistent:
+// a completer stores its slot before reading the head or the flag, the drainer
+// advances the head or clears the flag before re-reading the slot, so at least
+// one of them sees the other's write. Slot contents are published by the slot
+// sequence and handed back by resetting it to 0.
+//
+// The emitter flag and the unemitted count pair up the same way: a stager
+// counts its result before trying the flag, the emitter clears the flag before
+// re-reading the count, so a staged result is never left without an emitter.
+
+ReorderBuffer::ReorderBuffer(int stream, OrderedSink sink, const ReorderConfig& config,
+                             ReorderMetrics* metrics)
+    : stream(stream),
+      sink(move(sink)),
+      config(config),
+      metrics(metrics),
+      slots(make_unique<Slot[]>(config.capacity)) {}
+
+ReorderBuffer::~ReorderBuffer() { flush(); }
+
+void ReorderBuffer::complete(uint64_t sequence, DataValue result, string text) {
+    store(sequence, false, move(result), move(text));
+}
+
+void ReorderBuffer::skip(uint64_t sequence) {
+    if (sequence != 0) store(sequence, true, DataValue(), string());
+}
+
+void ReorderBuffer::store(uint64_t sequence, bool skipped, DataValue result, string text) {
+    auto completedAt = chrono::steady_clock::now();
+    if (sequence < head.load()) {
+        // Unsequenced, or its gap was given up already
+        if (skipped) return;
+        while (draining.exchange(true)) this_thread::yield();
+        if (sequence != 0 && metrics) metrics->late.fetch_add(1);
+        stage(sequence, move(result), move(text), completedAt);
+        draining.store(false);
+        drain();
+        return;
+    }
+
+    Slot& slot = slots[sequence % config.capacity];
+    // Wait for the window to reach the sequence and for the slot's previous
+    // result to be released. The window wait is timed by the completer itself:
+    // with nothing pending (e.g. after a run of drop-oldest evictions) the
+    // drainer never starts the gap timeout, so the completer moves the window
+    while (sequence >= head.load() + config.capacity || slot.sequence.load() != 0) {
+        if (sequence >= head.load() + config.capacity &&
+            chrono::steady_clock::now() - completedAt >= config.gapTimeout) {
+            while (draining.exchange(true)) this_thread::yield();
+            releaseReady(false, sequence - config.capacity + 1);
+            draining.store(false);
+        }
+        drain();
+        this_thread::yield();
+    }
+    slot.skipped = skipped;
+    slot.result = move(result);
+    slot.text = move(text);
+    slot.completedAt = completedAt;
+    size_t depth = pending.fetch_add(1) + 1;
+    if (metrics) {
+        uint64_t deepest = metrics->maxDepth.load();
+        while (depth > deepest && !metrics->maxDepth.compare_exchange_weak(deepest, depth)) {
+        }
+    }
+    slot.sequence.store(sequence);
+
+    // The drainer may have given the sequence up meanwhile: take it back
+    uint64_t expected = sequence;
+    if (sequence < head.load() && slot.sequence.compare_exchange_strong(expected, BUSY)) {
+        skipped = slot.skipped;
+        result = move(slot.result);
+        text = move(slot.text);
+        slot.sequence.store(0);
+        pending.fetch_sub(1);
+        if (!skipped) {
+            while (draining.exchange(true)) this_thread::yield();
+            if (metrics) metrics->late.fetch_add(1);
+            stage(sequence, move(result), move(text), completedAt);
+            draining.store(false);
+        }
+    }
+    drain();
+}
+
+void ReorderBuffer::stage(uint64_t sequence, DataValue result, string text,
+                          chrono::steady_clock::time_point completedAt) {
+    staged.push_back({sequence, move(result), move(text), completedAt});
+    unemitted.fetch_add(1);
+}
+
+void ReorderBuffer::release(Staged& result) {
+    if (metrics) {
+        metrics->released.fetch_add(1);
+        auto waited = chrono::steady_clock::now() - result.completedAt;
+        metrics->delay.record(static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(waited).count()));
+    }
+    if (sink) sink(OrderedResult{stream, result.sequence, move(result.result), move(result.text)});
+}
+
+void ReorderBuffer::emit() {
+    vector<Staged> batch;
+    while (unemitted.load() != 0 && !emitting.exchange(true)) {
+        while (true) {
+            // The flag is only held by drainers, never across the sink
+            while (draining.exchange(true)) this_thread::yield();
+            batch.swap(staged);
+            draining.store(false);
+            if (batch.empty()) break;
+            for (Staged& result : batch) {
+                release(result);
+                unemitted.fetch_sub(1);
+            }
+            batch.clear();
+        }
+        emitting.store(false);
+        // Results staged after the last swap found the emitter flag taken
+    }
+}
+
+void ReorderBuffer::drain() {
+    while (true) {
+        if (draining.exchange(true)) break;  // the drainer re-checks after us
+        releaseReady(false);
+        draining.store(false);
+        // A result stored at the head while we drained found the flag taken
+        uint64_t next = head.load();
+        if (slots[next % config.capacity].sequence.load() != next) break;
+    }
+    emit();
+}
+
+void ReorderBuffer::releaseReady(bool giveUpGaps, uint64_t releaseBefore) {
+    while (true) {
+        uint64_t next = head.load();
+        Slot& slot = slots[next % config.capacity];
+        uint64_t expected = next;
+        bool present = slot.sequence.compare_exchange_strong(expected, BUSY);
+        if (!present && next >= releaseBefore) {
+            if (pending.load() == 0) return;
+            // Results wait behind a missing sequence
+            auto now = chrono::steady_clock::now();
+            if (stalledSince == chrono::steady_clock::time_point{}) stalledSince = now;
+            if (!giveUpGaps && now - stalledSince < config.gapTimeout) return;
+        }
+        if (!present) {
+            head.store(next + 1);
+            // Stored just before the head moved on: still in order
+            expected = next;
+            present = slot.sequence.compare_exchange_strong(expected, BUSY);
+            if (!present) {
+                if (metrics) metrics->gaps.fetch_add(1);
+                continue;
+            }
+        } else {
+            head.store(next + 1);
+        }
+        bool skipped = slot.skipped;
+        DataValue result = move(slot.result);
+        string text = move(slot.text);
+        auto completedAt = slot.completedAt;
+        slot.sequence.store(0);
+        pending.fetch_sub(1);
+        stalledSince = {};
+        if (!skipped) stage(next, move(result), move(text), completedAt);
+    }
+}
+
+void ReorderBuffer::flush() {
+    while (draining.exchange(true)) this_thread::yield();
+    releaseReady(true);
+    draining.store(false);
+    // Another thread may still be emitting what it took before us
+    while (unemitted.load() != 0) {
+        emit();
+        this_thread::yield();
+    }
+}
@@ -0,0 +1,106 @@
+#include "shm_queue.h"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SHM_QUEUE_SUPPORTED 1
+#endif
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <ctime>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t),
+              "futex words must be plain 32-bit integers");
+
+void* shmCreate(const string& name, size_t size) {
+#ifdef SHM_QUEUE_SUPPORTED
+    shm_unlink(name.c_str());  // stale segment of a crashed run
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return nullptr;
+    }
+    return memory;
+#else
+    (void)name;
+    (void)size;
+    return nullptr;
+#endif
+}
+
+void* shmAttach(const string& name, size_t& size) {
+#ifdef SHM_QUEUE_SUPPORTED
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return nullptr;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+    size = static_cast<size_t>(status.st_size);
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return memory == MAP_FAILED ? nullptr : memory;
+#else
+    (void)name;
+    (void)size;
+    return nullptr;
+#endif
+}
+
+void shmUnmap(void* memory, size_t size) {
+#ifdef SHM_QUEUE_SUPPORTED
+    if (memory) munmap(memory, size);
+#else
+    (void)memory;
+    (void)size;
+#endif
+}
+
+void shmUnlink(const string& name) {
+#ifdef SHM_QUEUE_SUPPORTED
+    shm_unlink(name.c_str());
+#else
+    (void)name;
+#endif
+}
+
+void shmWait(atomic<uint32_t>& word, uint32_t expected, chrono::milliseconds timeout) {
+#if defined(__linux__)
+    timespec relative{static_cast<time_t>(timeout.count() / 1000),
+                      static_cast<long>(timeout.count() % 1000) * 1000000};
+    // Not FUTEX_PRIVATE_FLAG: sleepers and wakers live in different processes
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &relative,
+            nullptr, 0);
+#else
+    if (word.load() == expected) this_thread::sleep_for(min(timeout, chrono::milliseconds(1)));
+#endif
+}
+
+void shmWake(atomic<uint32_t>& word, int count) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, count, nullptr, nullptr,
+            0);
+#else
+    (void)word;
+    (void)count;
+#endif
+}
@@ -0,0 +1,373 @@
+#include "simulator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <queue>
+#include <random>
+
+using namespace std;
+
+namespace {
+
+double secondsOf(chrono::microseconds duration) { return duration.count() / 1e6; }
+
+template <typename Body>
+double nanosecondsPerIteration(int iterations, Body body) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) body(i);
+    auto elapsed = chrono::steady_clock::now() - start;
+    return static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(elapsed).count()) /
+           iterations;
+}
+
+// Prevents the optimizer from discarding benchmarked results
+volatile double sink;
+
+struct Event {
+    double time;
+    uint64_t sequence;  // FIFO order for simultaneous events
+    int actor;
+    uint64_t timeout = 0;  // non-zero: the end of the actor's wait with this ticket
+
+    bool operator>(const Event& other) const {
+        return time != other.time ? time > other.time : sequence > other.sequence;
+    }
+};
+
+// A processing thread waiting on a full transfer destination
+struct Transfer {
+    uint64_t ticket = 0;  // 0 while not waiting
+    int source = 0;
+    int destination = 0;
+};
+
+// A generator or processing thread blocked on a full queue, with the item it is pushing
+struct Waiter {
+    int actor;
+    double generatedAt;
+};
+
+struct SimQueue {
+    explicit SimQueue(int capacity) : capacity(capacity) {}
+
+    int capacity;
+    size_t length = 0;
+    deque<double> generatedAt;  // function queues only: generation time per element
+    deque<Waiter> waiters;
+    double lastChange = 0;
+    double area = 0;  // integral of length over the measured window
+};
+
+class Simulation {
+   public:
+    explicit Simulation(const SimulationConfig& config)
+        : config(config),
+          nd(config.pipeline.dataThreads),
+          nf(config.pipeline.functionThreads),
+          np(config.pipeline.processingThreads),
+          transfers(config.pipeline.processingThreads),
+          windowStart(config.warmupSeconds),
+          windowEnd(config.warmupSeconds + config.durationSeconds),
+          rng(config.seed) {
+        for (int i = 0; i < nd; ++i) queues.emplace_back(config.pipeline.dataQueueCapacity);
+        for (int i = 0; i < nf; ++i) queues.emplace_back(config.pipeline.functionQueueCapacity);
+        // Same delays as the real threads with the Pipeline thread ids
+        for (int i = 0; i < nd; ++i) {
+            delays.push_back(secondsOf(config.pipeline.dataPacing.delayFor(i + 1)));
+        }
+        for (int i = 0; i < nf; ++i) {
+            delays.push_back(secondsOf(config.pipeline.functionPacing.delayFor(i + 100)));
+        }
+        for (int i = 0; i < np; ++i) {
+            delays.push_back(secondsOf(config.pipeline.processingPacing.delayFor(i + 200)));
+        }
+    }
+
+    SimulationResult run() {
+        const ServiceTimes& service = config.service;
+        for (int actor = 0; actor < nd + nf; ++actor) schedule(service.generateNs * 1e-9, actor);
+        for (int actor = nd + nf; actor < nd + nf + np; ++actor) schedule(0, actor);
+
+        while (!events.empty() && !finished) {
+            Event event = events.top();
+            if (event.time > windowEnd) break;
+            events.pop();
+            now = event.time;
+            if (event.timeout != 0) {
+                transferTimedOut(event.actor, event.timeout);
+            } else if (event.actor < nd + nf) {
+                generatorStep(event.actor);
+            } else {
+                processorStep(event.actor);
+            }
+        }
+        // Without an early stop the measured window runs to its end
+        if (!finished) now = windowEnd;
+        return collect();
+    }
+
+   private:
+    const SimulationConfig& config;
+    int nd, nf, np;
+    vector<Transfer> transfers;  // per processing thread
+    uint64_t nextTicket = 1;
+    double windowStart, windowEnd;
+    mt19937_64 rng;
+    vector<SimQueue> queues;
+    vector<double> delays;
+    priority_queue<Event, vector<Event>, greater<Event>> events;
+    uint64_t sequence = 0;
+    double now = 0;
+    bool finished = false;
+    int64_t applied = 0;
+    int64_t appliedInWindow = 0;
+    int64_t dropped = 0;
+    int64_t refused = 0;
+    int64_t lost = 0;
+    LatencyHistogram latencies;
+
+    void schedule(double time, int actor, uint64_t timeout = 0) {
+        events.push({time, sequence++, actor, timeout});
+    }
+
+    bool isFunctionQueue(int queue) const { return queue >= nd; }
+
+    void accumulate(SimQueue& queue) {
+        double from = max(queue.lastChange, windowStart);
+        double to = min(now, windowEnd);
+        if (to > from) queue.area += queue.length * (to - from);
+        queue.lastChange = now;
+    }
+
+    // Returns false if the queue is full and the actor has to wait
+    bool push(int queueIndex, int actor, double generatedAt) {
+        SimQueue& queue = queues[queueIndex];
+        if (queue.length >= static_cast<size_t>(queue.capacity)) {
+            queue.waiters.push_back({actor, generatedAt});
+            return false;
+        }
+        accumulate(queue);
+        queue.length++;
+        if (isFunctionQueue(queueIndex)) queue.generatedAt.push_back(generatedAt);
+        return true;
+    }
+
+    double pop(int queueIndex) {
+        SimQueue& queue = queues[queueIndex];
+        accumulate(queue);
+        queue.length--;
+        double generatedAt = 0;
+        if (isFunctionQueue(queueIndex)) {
+            generatedAt = queue.generatedAt.front();
+            queue.generatedAt.pop_front();
+        }
+        // The freed slot goes to the longest-waiting pusher
+        if (!queue.waiters.empty()) {
+            Waiter waiter = queue.waiters.front();
+            queue.waiters.pop_front();
+            if (waiter.actor >= nd + nf) transfers[waiter.actor - nd - nf].ticket = 0;
+            push(queueIndex, waiter.actor, waiter.generatedAt);
+            schedule(now + resumeCost(waiter.actor), waiter.actor);
+        }
+        return generatedAt;
+    }
+
+    // Time from completing a blocked push until the actor's next event
+    double resumeCost(int actor) const {
+        if (actor < nd + nf) return delays[actor] + config.service.generateNs * 1e-9;
+        return delays[actor] + config.service.transferNs * 1e-9;
+    }
+
+    void generatorStep(int actor) {
+        // The item was generated at the end of the previous service period
+        if (push(actor, actor, now)) {
+            schedule(now + delays[actor] + config.service.generateNs * 1e-9, actor);
+        }
+    }
+
+    void processorStep(int actor) {
+        const ServiceTimes& service = config.service;
+        int total = nd + nf;
+        if (total < 2) {
+            schedule(now + 0.05, actor);
+            return;
+        }
+
+        uniform_int_distribution<int> pick(0, total - 1);
+        int first = pick(rng), second;
+        do {
+            second = pick(rng);
+        } while (second == first);
+
+        double cost = service.selectNs * 1e-9;
+        bool firstIsData = first < nd;
+        bool secondIsData = second < nd;
+
+        if (firstIsData && secondIsData) {
+            if (queues[first].length > 0) {
+                pop(first);
+                cost += service.transferNs * 1e-9;
+                if (!push(second, actor, 0)) {
+                    // Resumed by a pop of the destination or by the timeout
+                    Transfer& transfer = transfers[actor - total];
+                    transfer = {nextTicket++, first, second};
+                    double wait = config.pipeline.lowLatency.busyPoll
+                                      ? 0
+                                      : secondsOf(config.pipeline.queueWait);
+                    schedule(now + cost + wait, actor, transfer.ticket);
+                    return;
+                }
+            }
+        } else if (firstIsData != secondIsData) {
+            int dataQueue = firstIsData ? first : second;
+            int functionQueue = firstIsData ? second : first;
+            if (queues[functionQueue].length > 0) {
+                double generatedAt = pop(functionQueue);
+                // Pattern 0 needs two arguments, patterns 1 and 2 one, pattern 3 none
+                int pattern = uniform_int_distribution<int>(0, 3)(rng);
+                size_t argsNeeded = pattern == 0 ? 2 : (pattern == 3 ? 0 : 1);
+                if (queues[dataQueue].length < argsNeeded) {
+                    dropped++;
+                } else {
+                    for (size_t i = 0; i < argsNeeded; ++i) pop(dataQueue);
+                    cost += service.applyNs * 1e-9;
+                    recordApplied(now + cost - generatedAt);
+                }
+            }
+        }
+        schedule(now + cost + delays[actor], actor);
+    }
+
+    // The destination stayed full: the value goes back to its source
+    void transferTimedOut(int actor, uint64_t ticket) {
+        Transfer& transfer = transfers[actor - nd - nf];
+        if (transfer.ticket != ticket) return;  // a pop resumed the push first
+        transfer.ticket = 0;
+        auto& waiters = queues[transfer.destination].waiters;
+        waiters.erase(find_if(waiters.begin(), waiters.end(),
+                              [actor](const Waiter& waiter) { return waiter.actor == actor; }));
+        refused++;
+        SimQueue& source = queues[transfer.source];
+        if (source.length < static_cast<size_t>(source.capacity)) {
+            accumulate(source);
+            source.length++;
+        } else {
+            lost++;
+        }
+        schedule(now + delays[actor], actor);
+    }
+
+    void recordApplied(double latencySeconds) {
+        applied++;
+        if (now >= windowStart) {
+            appliedInWindow++;
+            latencies.record(static_cast<uint64_t>(latencySeconds * 1e9));
+        }
+        if (applied >= config.pipeline.maxFunctions) finished = true;
+    }
+
+    SimulationResult collect() {
+        SimulationResult result;
+        double measured = min(now, windowEnd) - windowStart;
+        result.seconds = max(measured, 0.0);
+        result.functionsApplied = appliedInWindow;
+        result.throughput = result.seconds > 0 ? appliedInWindow / result.seconds : 0;
+        result.latencyP50Us = latencies.percentile(50) / 1000.0;
+        result.latencyP99Us = latencies.percentile(99) / 1000.0;
+        result.latencyMeanUs = latencies.mean() / 1000.0;
+        result.functionsDropped = dropped;
+        result.transfersRefused = refused;
+        result.valuesLost = lost;
+
+        for (int i = 0; i < nd + nf; ++i) {
+            accumulate(queues[i]);
+            double mean = result.seconds > 0 ? queues[i].area / result.seconds : 0;
+            (i < nd ? result.dataQueueLengths : result.functionQueueLengths).push_back(mean);
+        }
+        auto average = [](const vector<double>& values) {
+            double sum = 0;
+            for (double value : values) sum += value;
+            return values.empty() ? 0 : sum / values.size();
+        };
+        result.meanDataQueueLength = average(result.dataQueueLengths);
+        result.meanFunctionQueueLength = average(result.functionQueueLengths);
+        return result;
+    }
+};
+
+}  // namespace
+
+ServiceTimes calibrateServiceTimes(int iterations) {
+    mt19937 gen(12345);
+    uniform_int_distribution<> typeSelector(0, 2);
+    uniform_int_distribution<> intGenerator(DATA_MIN_VALUE, DATA_MAX_VALUE);
+    uniform_real_distribution<double> realGenerator(DATA_MIN_VALUE, DATA_MAX_VALUE);
+    auto randomValue = [&]() -> DataValue {
+        switch (typeSelector(gen)) {
+            case 0:
+                return intGenerator(gen);
+            case 1:
+                return static_cast<float>(realGenerator(gen));
+            default:
+                return complex<double>(realGenerator(gen), realGenerator(gen));
+        }
+    };
+
+    // Uncontended push + pop through the real queue
+    Queue<DataValue> queue(2);
+    DataValue value = 1;
+    double pushPopNs = nanosecondsPerIteration(iterations, [&](int) {
+        queue.push(value);
+        value = queue.pop();
+    });
+
+    double generateOnlyNs =
+        nanosecondsPerIteration(iterations, [&](int) { value = randomValue(); });
+
+    // Realistic function mix: every operation and operand pattern
+    vector<ArithmeticFunction> functions(256);
+    vector<vector<DataValue>> arguments(functions.size());
+    for (size_t i = 0; i < functions.size(); ++i) {
+        functions[i].op = static_cast<Operation>(i % 4);
+        if (i / 4 % 4 == 1 || i / 4 % 4 == 3) functions[i].right_operand = randomValue();
+        if (i / 4 % 4 == 2 || i / 4 % 4 == 3) functions[i].left_operand = randomValue();
+        for (size_t a = 0; a < functions[i].requiredArgs(); ++a) {
+            arguments[i].push_back(randomValue());
+        }
+    }
+    double applyOnlyNs = nanosecondsPerIteration(iterations, [&](int i) {
+        size_t index = static_cast<size_t>(i) % functions.size();
+        try {
+            DataValue result = functions[index].apply(arguments[index]);
+            sink = holds_alternative<int>(result) ? get<int>(result) : 0;
+        } catch (const exception&) {
+        }
+    });
+
+    uniform_int_distribution<> pick(0, 63);
+    double selectNs = nanosecondsPerIteration(iterations, [&](int) {
+        sink = pick(gen) + pick(gen) + static_cast<double>(queue.size());
+    });
+
+    ServiceTimes service;
+    service.generateNs = generateOnlyNs + pushPopNs / 2;
+    service.transferNs = pushPopNs;
+    // A function pop plus on average one argument pop
+    service.applyNs = applyOnlyNs + pushPopNs;
+    service.selectNs = selectNs;
+    sink = holds_alternative<int>(value) ? get<int>(value) : 0;
+    return service;
+}
+
+SimulationResult simulate(const SimulationConfig& config) {
+    SimulationConfig resolved = config;
+    if (resolved.pipeline.dataQueueCapacity <= 0) {
+        resolved.pipeline.dataQueueCapacity = calculateQueueCapacity(config.pipeline.dataThreads);
+    }
+    if (resolved.pipeline.functionQueueCapacity <= 0) {
+        resolved.pipeline.functionQueueCapacity =
+            calculateQueueCapacity(config.pipeline.functionThreads);
+    }
+    return Simulation(resolved).run();
+}
@@ -0,0 +1,216 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "codec.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SNAPSHOT_MMAP 1
+#endif
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t SNAPSHOT_MAGIC = 0x4e535450;  // "PTSN"
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+void putCount(string& out, size_t count) {
+    uint32_t value = static_cast<uint32_t>(count);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool getCount(const char*& cursor, const char* end, uint32_t& value) {
+    if (static_cast<size_t>(end - cursor) < sizeof(value)) return false;
+    memcpy(&value, cursor, sizeof(value));
+    cursor += sizeof(value);
+    return true;
+}
+
+template <typename T>
+bool decodeQueues(const char*& cursor, const char* end, vector<vector<T>>& queues,
+                  uint32_t queueCount) {
+    queues.assign(queueCount, {});
+    for (auto& queue : queues) {
+        uint32_t count;
+        if (!getCount(cursor, end, count)) return false;
+        // Every element takes at least one byte, which bounds a damaged count
+        if (count > static_cast<size_t>(end - cursor)) return false;
+        queue.resize(count);
+        for (auto& element : queue) {
+            if (!decode(cursor, end, element)) return false;
+        }
+    }
+    return true;
+}
+
+bool parseSnapshot(const char* cursor, const char* end, QueueSnapshot& snapshot) {
+    uint32_t magic, version, dataCount, functionCount;
+    if (!getCount(cursor, end, magic) || !getCount(cursor, end, version) ||
+        !getCount(cursor, end, dataCount) || !getCount(cursor, end, functionCount)) {
+        return false;
+    }
+    if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) return false;
+    return decodeQueues(cursor, end, snapshot.dataQueues, dataCount) &&
+           decodeQueues(cursor, end, snapshot.functionQueues, functionCount) && cursor == end;
+}
+
+// Writes the whole file and syncs it, so the rename below can only ever
+// expose complete contents
+bool writeDurably(const string& path, const string& bytes) {
+#ifdef SNAPSHOT_MMAP
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    size_t written = 0;
+    while (written < bytes.size()) {
+        ssize_t count = write(fd, bytes.data() + written, bytes.size() - written);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        written += static_cast<size_t>(count);
+    }
+    bool synced = written == bytes.size() && fsync(fd) == 0;
+    return close(fd) == 0 && synced;
+#else
+    ofstream file(path, ios::binary | ios::trunc);
+    return static_cast<bool>(file.write(bytes.data(), static_cast<streamsize>(bytes.size())));
+#endif
+}
+
+// Makes a rename in path's directory durable
+bool syncDirectory(const string& path) {
+#ifdef SNAPSHOT_MMAP
+    size_t slash = path.find_last_of('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+#else
+    (void)path;
+    return true;
+#endif
+}
+
+template <typename T>
+bool fits(const vector<T>& queue, int capacity) {
+    return queue.size() < static_cast<size_t>(max(capacity, 0));
+}
+
+}  // namespace
+
+size_t QueueSnapshot::valueCount() const {
+    size_t count = 0;
+    for (const auto& queue : dataQueues) count += queue.size();
+    return count;
+}
+
+size_t QueueSnapshot::functionCount() const {
+    size_t count = 0;
+    for (const auto& queue : functionQueues) count += queue.size();
+    return count;
+}
+
+QueueSnapshot captureSnapshot(const Pipeline& pipeline) {
+    QueueSnapshot snapshot;
+    for (const auto& thread : pipeline.getDataThreads()) {
+        snapshot.dataQueues.push_back(thread->getQueue().contents());
+    }
+    for (const auto& thread : pipeline.getFunctionThreads()) {
+        snapshot.functionQueues.push_back(thread->getQueue().contents());
+    }
+    return snapshot;
+}
+
+bool saveSnapshot(const string& path, const QueueSnapshot& snapshot) {
+    string bytes;
+    putCount(bytes, SNAPSHOT_MAGIC);
+    putCount(bytes, SNAPSHOT_VERSION);
+    putCount(bytes, snapshot.dataQueues.size());
+    putCount(bytes, snapshot.functionQueues.size());
+    for (const auto& queue : snapshot.dataQueues) {
+        putCount(bytes, queue.size());
+        for (const auto& value : queue) encode(bytes, value);
+    }
+    for (const auto& queue : snapshot.functionQueues) {
+        putCount(bytes, queue.size());
+        for (const auto& function : queue) encode(bytes, function);
+    }
+
+    string temporary = path + ".tmp";
+    if (!writeDurably(temporary, bytes) || rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return syncDirectory(path);
+}
+
+bool loadSnapshot(const string& path, QueueSnapshot& snapshot) {
+#ifdef SNAPSHOT_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(status.st_size);
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return false;
+    // Decoding walks the file front to back exactly once
+    madvise(memory, size, MADV_SEQUENTIAL);
+    const char* begin = static_cast<const char*>(memory);
+    bool parsed = parseSnapshot(begin, begin + size, snapshot);
+    munmap(memory, size);
+    return parsed;
+#else
+    ifstream file(path, ios::binary);
+    if (!file) return false;
+    string bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    return parseSnapshot(bytes.data(), bytes.data() + bytes.size(), snapshot);
+#endif
+}
+
+size_t restoreSnapshot(const QueueSnapshot& snapshot, Pipeline& pipeline) {
+    const PipelineConfig& config = pipeline.getConfig();
+    vector<vector<DataValue>> data(config.dataThreads);
+    vector<vector<ArithmeticFunction>> functions(config.functionThreads);
+    size_t dropped = 0;
+
+    for (size_t q = 0; q < snapshot.dataQueues.size(); ++q) {
+        for (const auto& value : snapshot.dataQueues[q]) {
+            if (data.empty() || !fits(data[q % data.size()], config.dataQueueCapacity)) {
+                dropped++;
+                continue;
+            }
+            data[q % data.size()].push_back(value);
+        }
+    }
+
+    auto restoredAt = chrono::steady_clock::now();
+    for (size_t q = 0; q < snapshot.functionQueues.size(); ++q) {
+        for (ArithmeticFunction function : snapshot.functionQueues[q]) {
+            if (functions.empty() ||
+                !fits(functions[q % functions.size()], config.functionQueueCapacity)) {
+                dropped++;
+                continue;
+            }
+            function.generatedAt = restoredAt;
+            functions[q % functions.size()].push_back(function);
+        }
+    }
+
+    pipeline.preloadQueues(move(data), move(functions));
+    return dropped;
+}
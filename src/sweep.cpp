@@ -0,0 +1,358 @@
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "low_latency.h"
+#include "option_list.h"
+#include "pipeline.h"
+#include "queue_sampler.h"
+#include "simulator.h"
+
+using namespace std;
+
+// Runs processing_threads in-process over a grid of configurations and writes
+// one row of throughput, latency and CPU figures per configuration. With
+// --simulate each row also carries the discrete-event simulator's prediction
+// for the same configuration, which validates the model against measurements.
+
+namespace {
+
+struct SweepOptions {
+    vector<int> functionThreads{1, 2, 4};
+    vector<int> dataThreads{2, 4};
+    vector<int> processingThreads{1, 2, 4};
+    vector<int> capacities{0};         // 0: calculateQueueCapacity()
+    vector<double> pacingScales{0.1};  // multiplies the default pacing; 0 disables it
+    int durationMs = 1000;
+    int warmupMs = 250;
+    bool json = false;
+    bool simulate = false;  // add simulator predictions
+    bool measure = true;    // run the real pipeline
+    bool lowLatency = false;  // busy-polling processing threads pinned to their own CPUs
+    string output = "sweep_results.csv";
+};
+
+struct SweepResult {
+    PipelineConfig config;
+    double pacingScale;
+    double seconds;
+    int functions;
+    double throughput;
+    double latencyP50Us;
+    double latencyP90Us;
+    double latencyP99Us;
+    double latencyP9999Us;
+    double latencyMaxUs;
+    double cpuCores;        // CPU seconds per wall-clock second
+    double cpuUtilization;  // cpuCores / hardware threads
+    double meanDataQueue;
+    double meanFunctionQueue;
+    bool measured = false;
+    bool simulated = false;
+    SimulationResult simulation;
+};
+
+void printUsage(const char* programName) {
+    cout << "Usage: " << programName << " [options]" << endl;
+    cout << "  --nf=<list>        function thread counts (default: 1,2,4)" << endl;
+    cout << "  --nd=<list>        data thread counts (default: 2,4)" << endl;
+    cout << "  --np=<list>        processing thread counts (default: 1,2,4)" << endl;
+    cout << "  --capacity=<list>  queue capacities, 0 = producers * 10 (default: 0)" << endl;
+    cout << "  --pacing=<list>    pacing scale factors, 0 = no sleeps (default: 0.1)" << endl;
+    cout << "  --duration=<ms>    measured time per configuration (default: 1000)" << endl;
+    cout << "  --warmup=<ms>      unmeasured time before each measurement (default: 250)"
+         << endl;
+    cout << "  --low-latency      busy-poll processing threads pinned to their own CPUs" << endl;
+    cout << "  --simulate         add discrete-event simulator predictions to each row" << endl;
+    cout << "  --simulate-only    only simulate; nothing is run on this machine" << endl;
+    cout << "  --format=csv|json  output format (default: csv)" << endl;
+    cout << "  --output=<file>    result file (default: sweep_results.csv)" << endl;
+    cout << endl;
+    cout << "Example: " << programName << " --nf=2 --nd=4 --np=1,2,4,8 --pacing=0" << endl;
+}
+
+double cpuSeconds() { return static_cast<double>(clock()) / CLOCKS_PER_SEC; }
+
+double meanOf(const vector<uint32_t>& samples) {
+    double sum = 0;
+    for (uint32_t sample : samples) sum += sample;
+    return samples.empty() ? 0 : sum / samples.size();
+}
+
+void runConfiguration(SweepResult& result, const SweepOptions& options) {
+    Pipeline pipeline(result.config);
+    pipeline.start();
+    this_thread::sleep_for(chrono::milliseconds(options.warmupMs));
+
+    // Queue lengths over the measured period, for comparison with the simulator
+    QueueSampler sampler(chrono::milliseconds(5));
+    for (const auto& thread : pipeline.getDataThreads()) {
+        sampler.addQueue(thread->getQueue(), "data");
+    }
+    for (const auto& thread : pipeline.getFunctionThreads()) {
+        sampler.addQueue(thread->getQueue(), "function");
+    }
+    sampler.start();
+
+    pipeline.getLatencies().reset();
+    int functionsBefore = pipeline.getFunctionsProcessed();
+    double cpuBefore = cpuSeconds();
+    auto startTime = chrono::steady_clock::now();
+
+    this_thread::sleep_for(chrono::milliseconds(options.durationMs));
+
+    int functionsAfter = pipeline.getFunctionsProcessed();
+    double cpuAfter = cpuSeconds();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    sampler.stop();
+    pipeline.stop();
+
+    const LatencyHistogram& latencies = pipeline.getLatencies();
+    unsigned hardwareThreads = max(1u, thread::hardware_concurrency());
+    size_t dataQueues = pipeline.getDataThreads().size();
+    size_t queueCount = dataQueues + pipeline.getFunctionThreads().size();
+    double dataSum = 0, functionSum = 0;
+    for (size_t q = 0; q < queueCount; ++q) {
+        (q < dataQueues ? dataSum : functionSum) += meanOf(sampler.samplesFor(q));
+    }
+
+    result.config = pipeline.getConfig();
+    result.measured = true;
+    result.seconds = seconds;
+    result.functions = functionsAfter - functionsBefore;
+    result.throughput = result.functions / seconds;
+    result.latencyP50Us = latencies.percentile(50) / 1000.0;
+    result.latencyP90Us = latencies.percentile(90) / 1000.0;
+    result.latencyP99Us = latencies.percentile(99) / 1000.0;
+    result.latencyP9999Us = latencies.percentile(99.99) / 1000.0;
+    result.latencyMaxUs = latencies.max() / 1000.0;
+    result.cpuCores = (cpuAfter - cpuBefore) / seconds;
+    result.cpuUtilization = result.cpuCores / hardwareThreads;
+    result.meanDataQueue = dataQueues > 0 ? dataSum / dataQueues : 0;
+    result.meanFunctionQueue =
+        queueCount > dataQueues ? functionSum / (queueCount - dataQueues) : 0;
+}
+
+void simulateConfiguration(SweepResult& result, const ServiceTimes& service,
+                           const SweepOptions& options) {
+    SimulationConfig simulation;
+    simulation.pipeline = result.config;
+    simulation.service = service;
+    simulation.warmupSeconds = options.warmupMs / 1000.0;
+    simulation.durationSeconds = options.durationMs / 1000.0;
+    result.simulation = simulate(simulation);
+    result.simulated = true;
+}
+
+// Empty CSV fields / JSON nulls for columns of a skipped phase
+template <typename T>
+string field(bool available, T value, bool json) {
+    if (!available) return json ? "null" : "";
+    ostringstream out;
+    out << value;
+    return out.str();
+}
+
+void writeCsv(ostream& out, const vector<SweepResult>& results) {
+    out << "nf,nd,np,data_capacity,function_capacity,pacing,seconds,functions,throughput_per_s,"
+           "latency_p50_us,latency_p90_us,latency_p99_us,latency_p9999_us,latency_max_us,cpu_cores,"
+           "cpu_utilization,mean_data_queue,mean_function_queue,sim_throughput_per_s,"
+           "sim_latency_p50_us,sim_latency_p99_us,sim_mean_data_queue,sim_mean_function_queue\n";
+    for (const auto& r : results) {
+        bool m = r.measured, s = r.simulated;
+        out << r.config.functionThreads << "," << r.config.dataThreads << ","
+            << r.config.processingThreads << "," << r.config.dataQueueCapacity << ","
+            << r.config.functionQueueCapacity << "," << r.pacingScale << ","
+            << field(m, r.seconds, false) << "," << field(m, r.functions, false) << ","
+            << field(m, r.throughput, false) << "," << field(m, r.latencyP50Us, false) << ","
+            << field(m, r.latencyP90Us, false) << "," << field(m, r.latencyP99Us, false) << ","
+            << field(m, r.latencyP9999Us, false) << "," << field(m, r.latencyMaxUs, false) << ","
+            << field(m, r.cpuCores, false) << "," << field(m, r.cpuUtilization, false) << ","
+            << field(m, r.meanDataQueue, false) << "," << field(m, r.meanFunctionQueue, false)
+            << ","
+            << field(s, r.simulation.throughput, false) << ","
+            << field(s, r.simulation.latencyP50Us, false) << ","
+            << field(s, r.simulation.latencyP99Us, false) << ","
+            << field(s, r.simulation.meanDataQueueLength, false) << ","
+            << field(s, r.simulation.meanFunctionQueueLength, false) << "\n";
+    }
+}
+
+void writeJson(ostream& out, const vector<SweepResult>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        bool m = r.measured, s = r.simulated;
+        out << "  {\"nf\": " << r.config.functionThreads << ", \"nd\": " << r.config.dataThreads
+            << ", \"np\": " << r.config.processingThreads
+            << ", \"data_capacity\": " << r.config.dataQueueCapacity
+            << ", \"function_capacity\": " << r.config.functionQueueCapacity
+            << ", \"pacing\": " << r.pacingScale << ", \"seconds\": " << field(m, r.seconds, true)
+            << ", \"functions\": " << field(m, r.functions, true)
+            << ", \"throughput_per_s\": " << field(m, r.throughput, true)
+            << ", \"latency_p50_us\": " << field(m, r.latencyP50Us, true)
+            << ", \"latency_p90_us\": " << field(m, r.latencyP90Us, true)
+            << ", \"latency_p99_us\": " << field(m, r.latencyP99Us, true)
+            << ", \"latency_p9999_us\": " << field(m, r.latencyP9999Us, true)
+            << ", \"latency_max_us\": " << field(m, r.latencyMaxUs, true)
+            << ", \"cpu_cores\": " << field(m, r.cpuCores, true)
+            << ", \"cpu_utilization\": " << field(m, r.cpuUtilization, true)
+            << ", \"mean_data_queue\": " << field(m, r.meanDataQueue, true)
+            << ", \"mean_function_queue\": " << field(m, r.meanFunctionQueue, true)
+            << ", \"sim_throughput_per_s\": " << field(s, r.simulation.throughput, true)
+            << ", \"sim_latency_p50_us\": " << field(s, r.simulation.latencyP50Us, true)
+            << ", \"sim_latency_p99_us\": " << field(s, r.simulation.latencyP99Us, true)
+            << ", \"sim_mean_data_queue\": " << field(s, r.simulation.meanDataQueueLength, true)
+            << ", \"sim_mean_function_queue\": "
+            << field(s, r.simulation.meanFunctionQueueLength, true) << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    SweepOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            string option = argv[i];
+            auto value = [&option](const string& prefix) { return option.substr(prefix.size()); };
+            if (option == "-h" || option == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            } else if (option.rfind("--nf=", 0) == 0) {
+                options.functionThreads = parseList<int>(value("--nf="));
+            } else if (option.rfind("--nd=", 0) == 0) {
+                options.dataThreads = parseList<int>(value("--nd="));
+            } else if (option.rfind("--np=", 0) == 0) {
+                options.processingThreads = parseList<int>(value("--np="));
+            } else if (option.rfind("--capacity=", 0) == 0) {
+                options.capacities = parseList<int>(value("--capacity="));
+            } else if (option.rfind("--pacing=", 0) == 0) {
+                options.pacingScales = parseList<double>(value("--pacing="));
+            } else if (option.rfind("--duration=", 0) == 0) {
+                options.durationMs = stoi(value("--duration="));
+            } else if (option.rfind("--warmup=", 0) == 0) {
+                options.warmupMs = stoi(value("--warmup="));
+            } else if (option == "--low-latency") {
+                options.lowLatency = true;
+            } else if (option == "--simulate") {
+                options.simulate = true;
+            } else if (option == "--simulate-only") {
+                options.simulate = true;
+                options.measure = false;
+            } else if (option == "--format=json") {
+                options.json = true;
+            } else if (option == "--format=csv") {
+                options.json = false;
+            } else if (option.rfind("--output=", 0) == 0) {
+                options.output = value("--output=");
+            } else {
+                cerr << "Error: Unknown option " << option << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        if (options.durationMs <= 0 || options.warmupMs < 0) {
+            throw invalid_argument("duration must be positive and warm-up non-negative");
+        }
+    } catch (const exception& e) {
+        cerr << "Error: Invalid argument - " << e.what() << endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Thread chatter would dominate the measured work
+    BaseThread::setLogLevel(LogLevel::OFF);
+
+    size_t total = options.functionThreads.size() * options.dataThreads.size() *
+                   options.processingThreads.size() * options.capacities.size() *
+                   options.pacingScales.size();
+    cout << "Running " << total << " configurations (" << options.warmupMs << " ms warm-up + "
+         << options.durationMs << " ms each)" << endl;
+
+    ServiceTimes service;
+    if (options.simulate) {
+        service = calibrateServiceTimes();
+        cout << "Calibrated service times (ns): generate " << service.generateNs << ", transfer "
+             << service.transferNs << ", apply " << service.applyNs << ", select "
+             << service.selectNs << endl;
+    }
+
+    // Progress lines set their own number format; later output keeps the default
+    ios_base::fmtflags coutFlags = cout.flags();
+    streamsize coutPrecision = cout.precision();
+    vector<SweepResult> results;
+    for (int nf : options.functionThreads) {
+        for (int nd : options.dataThreads) {
+            for (int np : options.processingThreads) {
+                for (int capacity : options.capacities) {
+                    for (double pacing : options.pacingScales) {
+                        PipelineConfig config;
+                        config.functionThreads = nf;
+                        config.dataThreads = nd;
+                        config.processingThreads = np;
+                        // Resolved here so --simulate-only rows report real capacities
+                        config.dataQueueCapacity =
+                            capacity > 0 ? capacity : calculateQueueCapacity(nd);
+                        config.functionQueueCapacity =
+                            capacity > 0 ? capacity : calculateQueueCapacity(nf);
+                        config.dataPacing = DATA_PACING.scaled(pacing);
+                        config.functionPacing = FUNCTION_PACING.scaled(pacing);
+                        config.processingPacing = PROCESSING_PACING.scaled(pacing);
+                        if (options.lowLatency) {
+                            config.lowLatency.busyPoll = true;
+                            config.lowLatency.cpus = lowLatencyCpus(np);
+                        }
+
+                        SweepResult result;
+                        result.config = config;
+                        result.pacingScale = pacing;
+                        if (options.measure) runConfiguration(result, options);
+                        if (options.simulate) simulateConfiguration(result, service, options);
+                        results.push_back(result);
+
+                        cout << "[" << results.size() << "/" << total << "] NF=" << nf
+                             << " ND=" << nd << " NP=" << np << " capacity=" << capacity
+                             << " pacing=" << pacing << ":" << fixed << setprecision(1);
+                        if (result.measured) {
+                            cout << " measured " << result.throughput << " functions/s, p99 "
+                                 << result.latencyP99Us << " us, p99.99 " << result.latencyP9999Us
+                                 << " us, max " << result.latencyMaxUs << " us, "
+                                 << setprecision(2)
+                                 << result.cpuCores << " cores" << setprecision(1);
+                        }
+                        if (result.simulated) {
+                            cout << (result.measured ? ";" : "") << " simulated "
+                                 << result.simulation.throughput << " functions/s, p99 "
+                                 << result.simulation.latencyP99Us << " us";
+                        }
+                        cout << endl;
+                        cout.flags(coutFlags);
+                        cout.precision(coutPrecision);
+                    }
+                }
+            }
+        }
+    }
+
+    ofstream out(options.output);
+    if (!out) {
+        cerr << "Error: Could not write " << options.output << endl;
+        return 1;
+    }
+    if (options.json) {
+        writeJson(out, results);
+    } else {
+        writeCsv(out, results);
+    }
+    cout << "Results written to " << options.output << endl;
+    return 0;
+}
@@ -3,8 +3,51 @@
 #include <algorithm>
 #include <chrono>
 
+#include "batch.h"
+#include "hash_ring.h"
+#include "lookup_table.h"
+#include "low_latency.h"
+#include "memo_cache.h"
+#include "perf_counters.h"
+#include "reorder_buffer.h"
+#include "tracing.h"
+
 using namespace std;
 
+namespace {
+uint64_t nanosecondsSince(chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+}
+
+// Counts a push in the queue's live stats. Evictions are mirrored from the
+// queue's own counter, which is exact however many elements one push evicted;
+// the maximum keeps racing pushers from moving it backwards.
+template <typename T>
+void countPush(QueueStats* stats, PushResult result, const Queue<T>& queue) {
+    if (!stats || !wasQueued(result)) return;
+    stats->pushed.fetch_add(1, memory_order_relaxed);
+    if (result != PushResult::EVICTED_OLDEST) return;
+    uint64_t evicted = queue.evictedCount();
+    uint64_t published = stats->evicted.load(memory_order_relaxed);
+    while (evicted > published &&
+           !stats->evicted.compare_exchange_weak(published, evicted, memory_order_relaxed)) {
+    }
+}
+}  // namespace
+
+// Pacing implementation
+chrono::microseconds Pacing::delayFor(int threadId) const {
+    return base + step * (spread > 0 ? threadId % spread : 0);
+}
+
+Pacing Pacing::scaled(double factor) const {
+    auto scale = [factor](chrono::microseconds value) {
+        return chrono::microseconds(static_cast<long long>(value.count() * factor));
+    };
+    return {scale(base), scale(step), spread};
+}
+
 // ArithmeticFunction implementation
 size_t ArithmeticFunction::requiredArgs() const {
     size_t needed = 0;
@@ -57,28 +100,121 @@ string ArithmeticFunction::valueToString(const DataValue& val) const {
         val);
 }
 
+const DataValue& ArithmeticFunction::leftOperand(const vector<DataValue>& args) const {
+    return left_operand.has_value() ? *left_operand : args[0];
+}
+
+const DataValue& ArithmeticFunction::rightOperand(const vector<DataValue>& args) const {
+    return right_operand.has_value() ? *right_operand : args[left_operand.has_value() ? 0 : 1];
+}
+
+DataValue ArithmeticFunction::apply(const vector<DataValue>& args) const {
+    const DataValue& left = leftOperand(args);
+    const DataValue& right = rightOperand(args);
+
+    if (IntLookupTable::isEnabled()) {
+        const int* a = get_if<int>(&left);
+        const int* b = get_if<int>(&right);
+        if (a && b && IntLookupTable::covers(*a, *b)) {
+            return IntLookupTable::instance().lookup(op, *a, *b);
+        }
+    }
+
+    return visit(
+        [this](const auto& x, const auto& y) -> DataValue {
+            using T = common_type_t<decay_t<decltype(x)>, decay_t<decltype(y)>>;
+            if constexpr (is_same_v<T, complex<double>>) {
+                complex<double> a(x), b(y);
+                switch (op) {
+                    case Operation::ADD:
+                        return a + b;
+                    case Operation::SUBTRACT:
+                        return a - b;
+                    case Operation::MULTIPLY:
+                        return a * b;
+                    case Operation::DIVIDE:
+                        if (abs(b) < 1e-10) throw runtime_error("Division by zero");
+                        return a / b;
+                }
+            } else {
+                T a = static_cast<T>(x), b = static_cast<T>(y);
+                switch (op) {
+                    case Operation::ADD:
+                        return a + b;
+                    case Operation::SUBTRACT:
+                        return a - b;
+                    case Operation::MULTIPLY:
+                        return a * b;
+                    case Operation::DIVIDE:
+                        if (abs(static_cast<double>(b)) < 1e-10)
+                            throw runtime_error("Division by zero");
+                        return a / b;
+                }
+            }
+            throw runtime_error("Unknown operation");
+        },
+        left, right);
+}
+
 // BaseThread implementation
-BaseThread::BaseThread(int id) : threadId(id), gen(rd()) {}
+atomic<LogLevel> BaseThread::logLevel{LogLevel::ALL};
+
+BaseThread::BaseThread(int id)
+    : threadId(id), gen(SeedService::instance().seedFor(static_cast<uint64_t>(id))) {}
 BaseThread::~BaseThread() {
     stop();
     if (workerThread.joinable()) workerThread.join();
+    if (runningType) PerfCollector::instance().detachThread(runningType, threadId);
+    LiveStats::instance().unregisterThread(liveStats);
 }
-void BaseThread::start() { workerThread = thread(&BaseThread::workLoop, this); }
+void BaseThread::start() { workerThread = thread(&BaseThread::run, this); }
 void BaseThread::stop() { shouldStop = true; }
+void BaseThread::join() {
+    if (workerThread.joinable() && workerThread.get_id() != this_thread::get_id()) {
+        workerThread.join();
+    }
+}
 int BaseThread::getId() const { return threadId; }
 bool BaseThread::isRunning() const { return !shouldStop && workerThread.joinable(); }
-void BaseThread::log(const string& message) {
+void BaseThread::setLogLevel(LogLevel level) { logLevel = level; }
+LogLevel BaseThread::getLogLevel() { return logLevel; }
+bool BaseThread::shouldLog(LogLevel level) {
+    return static_cast<int>(level) <= static_cast<int>(logLevel.load(memory_order_relaxed));
+}
+void BaseThread::log(const string& message, LogLevel level) {
+    if (!shouldLog(level)) return;
     cout << "[Thread " << threadId << "] " << message << endl;
 }
+void BaseThread::run() {
+    runningType = getTypeName();
+    PerfCollector::instance().attachCurrentThread(runningType, threadId);
+    Tracer::instance().attachCurrentThread(getTypeName(), threadId);
+    workLoop();
+}
+void BaseThread::sleepFor(chrono::microseconds duration) {
+    if (duration.count() <= 0) return;
+    ScopedSpan span(SpanType::SLEEP);
+    this_thread::sleep_for(duration);
+}
+chrono::microseconds BaseThread::throttledDelay() const {
+    return chrono::microseconds(static_cast<long long>(delay.load().count() / throttle.load()));
+}
 
 // DataThread implementation
-DataThread::DataThread(int id, int queueCapacity)
+DataThread::DataThread(int id, int queueCapacity, const Pacing& pacing, DataSource source,
+                       OverflowPolicy overflow, const vector<DataValue>& initial)
     : BaseThread(id),
-      dataQueue(make_unique<Queue<DataValue>>(queueCapacity)),
+      dataQueue(make_unique<Queue<DataValue>>(queueCapacity, overflow)),
+      source(move(source)),
       typeSelector(0, 2),
       intGenerator(DATA_MIN_VALUE, DATA_MAX_VALUE),
       floatGenerator(static_cast<float>(DATA_MIN_VALUE), static_cast<float>(DATA_MAX_VALUE)),
       complexGenerator(static_cast<double>(DATA_MIN_VALUE), static_cast<double>(DATA_MAX_VALUE)) {
+    delay = pacing.delayFor(id);
+    queueStats = LiveStats::instance().registerQueue(dataQueue->getId(), StatsKind::DATA,
+                                                     queueCapacity);
+    liveStats = LiveStats::instance().registerThread(id, StatsKind::DATA);
+    for (const auto& value : initial) tryPushValue(value);
     log("Data thread created with queue ID: " + to_string(dataQueue->getId()) +
         ", capacity: " + to_string(queueCapacity));
     start();
@@ -87,23 +223,78 @@ DataThread::DataThread(int id, int queueCapacity)
 DataThread::~DataThread() {
     stop();
     if (workerThread.joinable()) workerThread.join();
+    LiveStats::instance().unregisterQueue(queueStats);
 }
+const char* DataThread::getTypeName() const { return "DataThread"; }
 int DataThread::getQueueId() const { return dataQueue->getId(); }
 size_t DataThread::getQueueSize() const { return dataQueue->size(); }
 bool DataThread::isQueueEmpty() const { return dataQueue->empty(); }
-DataValue DataThread::popValue() { return dataQueue->pop(); }
-void DataThread::pushValue(const DataValue& value) { dataQueue->push(value); }
+const Queue<DataValue>& DataThread::getQueue() const { return *dataQueue; }
+void DataThread::closeQueue() { dataQueue->close(); }
+DataValue DataThread::popValue() {
+    DataValue value = dataQueue->pop();
+    if (queueStats) queueStats->popped.fetch_add(1, memory_order_relaxed);
+    return value;
+}
+optional<DataValue> DataThread::popValueFor(chrono::microseconds timeout) {
+    optional<DataValue> value = dataQueue->popFor(timeout);
+    if (value && queueStats) queueStats->popped.fetch_add(1, memory_order_relaxed);
+    return value;
+}
+PushResult DataThread::pushValueFor(const DataValue& value, chrono::microseconds timeout) {
+    PushResult result = dataQueue->pushFor(value, timeout);
+    countPush(queueStats, result, *dataQueue);
+    return result;
+}
+PushResult DataThread::pushValue(const DataValue& value) {
+    PushResult result = dataQueue->push(value);
+    countPush(queueStats, result, *dataQueue);
+    return result;
+}
+bool DataThread::tryPushValue(const DataValue& value) {
+    if (!dataQueue->tryPush(value)) return false;
+    if (queueStats) queueStats->pushed.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+bool DataThread::tryPopValue(DataValue& value) {
+    if (!dataQueue->tryPop(value)) return false;
+    if (queueStats) queueStats->popped.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void DataThread::setQueueCapacity(int capacity) {
+    dataQueue->setMaxCapacity(capacity);
+    if (queueStats) queueStats->capacity.store(capacity, memory_order_relaxed);
+}
+void DataThread::setOverflowPolicy(OverflowPolicy policy) { dataQueue->setOverflowPolicy(policy); }
 
 void DataThread::workLoop() {
     log("Started working");
     while (!shouldStop) {
         try {
-            DataValue value = generateRandomValue();
-            dataQueue->push(value);
-            logGeneratedValue(value);
-            this_thread::sleep_for(chrono::milliseconds(200 + (threadId % 5) * 50));
+            DataValue value;
+            if (source) {
+                ScopedSpan span(SpanType::POP_BLOCKED);
+                if (!source(value)) break;
+            } else {
+                ScopedSpan span(SpanType::GENERATE);
+                value = generateRandomValue();
+            }
+            auto pushStart = chrono::steady_clock::now();
+            PushResult result;
+            {
+                ScopedSpan span(SpanType::PUSH_BLOCKED);
+                result = pushValue(value);
+            }
+            if (liveStats) liveStats->recordOperation(nanosecondsSince(pushStart));
+            if (wasQueued(result)) {
+                logGeneratedValue(value);
+            } else if (result != PushResult::CLOSED) {
+                log("Queue full, generated value discarded");
+            }
+            if (!source) sleepFor(throttledDelay());
         } catch (const exception& e) {
-            log("Error: " + string(e.what()));
+            log("Error: " + string(e.what()), LogLevel::ERRORS);
             break;
         }
     }
@@ -125,6 +316,7 @@ DataValue DataThread::generateRandomValue() {
 }
 
 void DataThread::logGeneratedValue(const DataValue& value) {
+    if (!shouldLog(LogLevel::ALL)) return;
     string message = "Generated: ";
     visit(
         [&message](const auto& v) {
@@ -141,14 +333,22 @@ void DataThread::logGeneratedValue(const DataValue& value) {
 }
 
 // FunctionThread implementation
-FunctionThread::FunctionThread(int id, int queueCapacity)
+FunctionThread::FunctionThread(int id, int queueCapacity, const Pacing& pacing,
+                               FunctionSource source, OverflowPolicy overflow,
+                               const vector<ArithmeticFunction>& initial)
     : BaseThread(id),
-      functionQueue(make_unique<Queue<ArithmeticFunction>>(queueCapacity)),
+      functionQueue(make_unique<Queue<ArithmeticFunction>>(queueCapacity, overflow)),
+      source(move(source)),
       operationSelector(0, 3),
       patternSelector(0, 3),
       intConstGenerator(-20, 20),
       floatConstGenerator(-10.0f, 10.0f),
       dataTypeSelector(0, 2) {
+    delay = pacing.delayFor(id);
+    queueStats = LiveStats::instance().registerQueue(functionQueue->getId(), StatsKind::FUNCTION,
+                                                     queueCapacity);
+    liveStats = LiveStats::instance().registerThread(id, StatsKind::FUNCTION);
+    for (const auto& func : initial) tryPushFunction(func);
     log("Function thread created with queue ID: " + to_string(functionQueue->getId()) +
         ", capacity: " + to_string(queueCapacity));
     start();
@@ -157,22 +357,82 @@ FunctionThread::FunctionThread(int id, int queueCapacity)
 FunctionThread::~FunctionThread() {
     stop();
     if (workerThread.joinable()) workerThread.join();
+    LiveStats::instance().unregisterQueue(queueStats);
 }
+const char* FunctionThread::getTypeName() const { return "FunctionThread"; }
 int FunctionThread::getQueueId() const { return functionQueue->getId(); }
 size_t FunctionThread::getQueueSize() const { return functionQueue->size(); }
 bool FunctionThread::isQueueEmpty() const { return functionQueue->empty(); }
-ArithmeticFunction FunctionThread::popFunction() { return functionQueue->pop(); }
+const Queue<ArithmeticFunction>& FunctionThread::getQueue() const { return *functionQueue; }
+void FunctionThread::closeQueue() { functionQueue->close(); }
+ArithmeticFunction FunctionThread::popFunction() {
+    ArithmeticFunction func = functionQueue->pop();
+    if (queueStats) queueStats->popped.fetch_add(1, memory_order_relaxed);
+    return func;
+}
+optional<ArithmeticFunction> FunctionThread::popFunctionFor(chrono::microseconds timeout) {
+    optional<ArithmeticFunction> func = functionQueue->popFor(timeout);
+    if (func && queueStats) queueStats->popped.fetch_add(1, memory_order_relaxed);
+    return func;
+}
+PushResult FunctionThread::pushFunction(const ArithmeticFunction& func) {
+    PushResult result = functionQueue->push(func);
+    countPush(queueStats, result, *functionQueue);
+    return result;
+}
+bool FunctionThread::tryPushFunction(const ArithmeticFunction& func) {
+    if (!functionQueue->tryPush(func)) return false;
+    if (queueStats) queueStats->pushed.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+bool FunctionThread::tryPopFunction(ArithmeticFunction& func) {
+    if (!functionQueue->tryPop(func)) return false;
+    if (queueStats) queueStats->popped.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void FunctionThread::setQueueCapacity(int capacity) {
+    functionQueue->setMaxCapacity(capacity);
+    if (queueStats) queueStats->capacity.store(capacity, memory_order_relaxed);
+}
+void FunctionThread::setOverflowPolicy(OverflowPolicy policy) {
+    functionQueue->setOverflowPolicy(policy);
+}
+void FunctionThread::setReorderBuffer(unique_ptr<ReorderBuffer> buffer) {
+    reorderBuffer = move(buffer);
+}
 
 void FunctionThread::workLoop() {
     log("Started working");
     while (!shouldStop) {
         try {
-            ArithmeticFunction func = generateRandomFunction();
-            functionQueue->push(func);
-            logGeneratedFunction(func);
-            this_thread::sleep_for(chrono::milliseconds(300 + (threadId % 5) * 75));
+            ArithmeticFunction func;
+            if (source) {
+                ScopedSpan span(SpanType::POP_BLOCKED);
+                if (!source(func)) break;
+            } else {
+                ScopedSpan span(SpanType::GENERATE);
+                func = generateRandomFunction();
+            }
+            auto pushStart = chrono::steady_clock::now();
+            if (!source) func.generatedAt = pushStart;
+            func.sequence = nextSequence;
+            PushResult result;
+            {
+                ScopedSpan span(SpanType::PUSH_BLOCKED);
+                result = pushFunction(func);
+            }
+            // Refused functions leave no gap in the sequence
+            if (wasQueued(result)) ++nextSequence;
+            if (liveStats) liveStats->recordOperation(nanosecondsSince(pushStart));
+            if (wasQueued(result)) {
+                logGeneratedFunction(func);
+            } else if (result != PushResult::CLOSED) {
+                log("Queue full, generated function discarded");
+            }
+            if (!source) sleepFor(throttledDelay());
         } catch (const exception& e) {
-            log("Error: " + string(e.what()));
+            log("Error: " + string(e.what()), LogLevel::ERRORS);
             break;
         }
     }
@@ -214,67 +474,145 @@ DataValue FunctionThread::generateRandomConstant() {
 }
 
 void FunctionThread::logGeneratedFunction(const ArithmeticFunction& func) {
+    if (!shouldLog(LogLevel::ALL)) return;
     log("Generated function: " + func.description() + " (needs " + to_string(func.requiredArgs()) +
         " args) (queue size: " + to_string(functionQueue->size()) + ")");
 }
 
 // ProcessingThread implementation
 ProcessingThread::ProcessingThread(int id, atomic<int>& processed, int maxFunctions,
-                                   const vector<unique_ptr<DataThread>>& dataThreads,
-                                   const vector<unique_ptr<FunctionThread>>& functionThreads)
+                                   QueueRegistry& registry, const Pacing& pacing,
+                                   LatencyHistogram* latencies, size_t memoEntries,
+                                   LowLatencyProfile lowLatency, chrono::microseconds queueWait,
+                                   bool partitioned, BatchConfig batch)
     : BaseThread(id),
       functionsProcessed(processed),
       maxFunctions(maxFunctions),
-      dataThreads(dataThreads),
-      functionThreads(functionThreads),
-      queueSelector(0, numeric_limits<int>::max()) {
+      latencies(latencies),
+      memo(memoEntries > 0 ? make_unique<MemoCache>(memoEntries) : nullptr),
+      lowLatency(move(lowLatency)),
+      queueWait(queueWait),
+      queueSelector(0, numeric_limits<int>::max()),
+      registryReader(registry.registerReader()),
+      partitioned(partitioned),
+      batch(batch) {
+    // Busy-polling threads never sleep between iterations
+    if (!this->lowLatency.busyPoll) delay = pacing.delayFor(id);
+    liveStats = LiveStats::instance().registerThread(id, StatsKind::PROCESSING);
     log("Processing thread created");
     start();
 }
 
+// The worker must be gone before the cache it uses is destroyed
+ProcessingThread::~ProcessingThread() {
+    stop();
+    join();
+}
+
+const char* ProcessingThread::getTypeName() const { return "ProcessingThread"; }
+
+void ProcessingThread::applyLowLatencyProfile() {
+    if (!lowLatency.cpus.empty() && !pinCurrentThread(lowLatency.cpus)) {
+        log("Could not pin to the requested CPUs, running unpinned", LogLevel::ERRORS);
+    }
+    if (lowLatency.fifoPriority > 0 && !setFifoPriority(lowLatency.fifoPriority)) {
+        log("SCHED_FIFO not permitted, keeping default scheduling", LogLevel::ERRORS);
+    }
+    if (lowLatency.busyPoll) prefaultStack(64 * 1024);
+}
+
+bool ProcessingThread::spinPopValue(DataThread* dataThread, DataValue& value) {
+    while (!dataThread->tryPopValue(value)) {
+        if (shouldStop) return false;
+        cpuRelax();
+    }
+    return true;
+}
+
 void ProcessingThread::workLoop() {
     log("Started processing");
+    applyLowLatencyProfile();
     while (!shouldStop && functionsProcessed.load() < maxFunctions) {
         try {
-            if (dataThreads.empty() && functionThreads.empty()) {
-                this_thread::sleep_for(chrono::milliseconds(100));
-                continue;
-            }
-
-            auto [firstIdx, secondIdx] = selectTwoRandomQueues();
-            if (firstIdx == -1 || secondIdx == -1) {
-                this_thread::sleep_for(chrono::milliseconds(50));
-                continue;
-            }
-
-            auto dataSize = static_cast<int>(dataThreads.size());
-            bool firstIsData = firstIdx < dataSize;
-            bool secondIsData = secondIdx < dataSize;
-
-            if (firstIsData && secondIsData) {
-                processDataToData(dataThreads[firstIdx].get(), dataThreads[secondIdx].get());
-            } else if (!firstIsData && !secondIsData) {
-                log("Both queues are function queues, ignoring");
-            } else {
-                DataThread* dataThread =
-                    firstIsData ? dataThreads[firstIdx].get() : dataThreads[secondIdx].get();
-                FunctionThread* funcThread = firstIsData
-                                                 ? functionThreads[secondIdx - dataSize].get()
-                                                 : functionThreads[firstIdx - dataSize].get();
-                processFunctionWithData(funcThread, dataThread);
+            bool picked = false;
+            {
+                // The picked generators stay alive until the guard is released
+                auto topology = registryReader->read();
+                if (partitioned && topology->version != partitionVersion) {
+                    refreshPartition(*topology);
+                }
+                const auto& dataThreads = partitioned ? ownedData : topology->dataThreads;
+                const auto& functionThreads =
+                    partitioned ? ownedFunctions : topology->functionThreads;
+                auto dataSize = static_cast<int>(dataThreads.size());
+                auto [firstIdx, secondIdx] =
+                    selectTwoRandomQueues(dataSize + static_cast<int>(functionThreads.size()));
+                picked = firstIdx != -1 && secondIdx != -1;
+                if (picked) {
+                    bool firstIsData = firstIdx < dataSize;
+                    bool secondIsData = secondIdx < dataSize;
+                    if (firstIsData && secondIsData) {
+                        processDataToData(dataThreads[firstIdx], dataThreads[secondIdx]);
+                    } else if (!firstIsData && !secondIsData) {
+                        log("Both queues are function queues, ignoring");
+                    } else {
+                        DataThread* dataThread =
+                            firstIsData ? dataThreads[firstIdx] : dataThreads[secondIdx];
+                        FunctionThread* funcThread =
+                            firstIsData ? functionThreads[secondIdx - dataSize]
+                                        : functionThreads[firstIdx - dataSize];
+                        processFunctionWithData(funcThread, dataThread);
+                    }
+                }
             }
-
-            this_thread::sleep_for(chrono::milliseconds(100 + (threadId % 3) * 50));
+            // Sleep outside the read section so retired generators can be reclaimed
+            sleepFor(picked ? delay.load() : chrono::milliseconds(50));
         } catch (const exception& e) {
-            log("Error: " + string(e.what()));
-            this_thread::sleep_for(chrono::milliseconds(100));
+            log("Error: " + string(e.what()), LogLevel::ERRORS);
+            if (!lowLatency.busyPoll) sleepFor(chrono::milliseconds(100));
         }
     }
     log("Finished processing");
 }
 
-pair<int, int> ProcessingThread::selectTwoRandomQueues() {
-    auto totalQueues = static_cast<int>(dataThreads.size() + functionThreads.size());
+QueuePartition partitionFor(const QueueRegistry::Snapshot& topology, int processingId) {
+    auto owned = [&topology, processingId](auto* thread) {
+        return topology.partitions.owner(static_cast<uint64_t>(thread->getId())) == processingId;
+    };
+    // Values without functions (or the reverse) would never be used
+    auto borrowed = [processingId](const auto& threads) {
+        vector<uint64_t> keys;
+        for (auto* thread : threads) keys.push_back(static_cast<uint64_t>(thread->getId()));
+        return threads[static_cast<size_t>(HashRing::nearest(processingId, keys))];
+    };
+    QueuePartition partition;
+    copy_if(topology.dataThreads.begin(), topology.dataThreads.end(),
+            back_inserter(partition.data), owned);
+    copy_if(topology.functionThreads.begin(), topology.functionThreads.end(),
+            back_inserter(partition.functions), owned);
+    if (partition.data.empty() && !partition.functions.empty() &&
+        !topology.dataThreads.empty()) {
+        partition.data.push_back(borrowed(topology.dataThreads));
+    }
+    if (partition.functions.empty() && !partition.data.empty() &&
+        !topology.functionThreads.empty()) {
+        partition.functions.push_back(borrowed(topology.functionThreads));
+    }
+    return partition;
+}
+
+void ProcessingThread::refreshPartition(const QueueRegistry::Snapshot& topology) {
+    QueuePartition partition = partitionFor(topology, threadId);
+    ownedData = move(partition.data);
+    ownedFunctions = move(partition.functions);
+    partitionVersion = topology.version;
+    if (shouldLog(LogLevel::ALL)) {
+        log("Partition: " + to_string(ownedData.size()) + " data and " +
+            to_string(ownedFunctions.size()) + " function queues");
+    }
+}
+
+pair<int, int> ProcessingThread::selectTwoRandomQueues(int totalQueues) {
     if (totalQueues < 2) return {-1, -1};
 
     uniform_int_distribution<> dist(0, totalQueues - 1);
@@ -289,80 +627,243 @@ void ProcessingThread::processDataToData(DataThread* source, DataThread* dest) {
     if (!source || !dest || source->isQueueEmpty()) return;
     try {
         if (!source->isQueueEmpty()) {
-            DataValue value = source->popValue();
-            dest->pushValue(value);
-            log("Transferred " + valueToString(value) + " from queue " +
-                to_string(source->getQueueId()) + " to queue " + to_string(dest->getQueueId()));
+            ScopedSpan transferSpan(SpanType::TRANSFER);
+            if (lowLatency.busyPoll) {
+                // Never wait on a full destination: put the value back instead
+                DataValue value;
+                if (!source->tryPopValue(value)) return;
+                if (!dest->tryPushValue(value) && !source->tryPushValue(value)) {
+                    log("Transfer dropped a value, both queues are full", LogLevel::ERRORS);
+                }
+                return;
+            }
+            optional<DataValue> value;
+            {
+                ScopedSpan span(SpanType::POP_BLOCKED);
+                value = source->popValueFor(queueWait);
+            }
+            if (!value) return;  // drained by another thread since the check
+            PushResult result;
+            {
+                ScopedSpan span(SpanType::PUSH_BLOCKED);
+                result = dest->pushValueFor(*value, queueWait);
+            }
+            // A value the destination did not take goes back to its source
+            bool refused = result == PushResult::REJECTED || result == PushResult::TIMED_OUT;
+            if (refused && !source->tryPushValue(*value)) {
+                log("Transfer dropped a value, both queues are full", LogLevel::ERRORS);
+            }
+            if (!wasQueued(result)) return;
+            if (shouldLog(LogLevel::ALL)) {
+                log("Transferred " + valueToString(*value) + " from queue " +
+                    to_string(source->getQueueId()) + " to queue " +
+                    to_string(dest->getQueueId()));
+            }
         }
     } catch (const exception& e) {
-        log("Transfer error: " + string(e.what()));
+        log("Transfer error: " + string(e.what()), LogLevel::ERRORS);
     }
 }
 
 void ProcessingThread::processFunctionWithData(FunctionThread* functionThread,
                                                DataThread* dataThread) {
     if (!functionThread || !dataThread || functionThread->isQueueEmpty()) return;
+    if (batch.maxFunctions > 1) {
+        processFunctionBatch(functionThread, dataThread);
+        return;
+    }
+    ReorderBuffer* ordered = functionThread->getReorderBuffer();
+    uint64_t consumed = 0;  // sequence of the function while this thread holds it
     try {
-        ArithmeticFunction func = functionThread->popFunction();
+        ArithmeticFunction func;
+        if (lowLatency.busyPoll) {
+            if (!functionThread->tryPopFunction(func)) return;
+        } else {
+            ScopedSpan span(SpanType::POP_BLOCKED);
+            optional<ArithmeticFunction> popped = functionThread->popFunctionFor(queueWait);
+            if (!popped) return;
+            func = *popped;
+        }
+        consumed = func.sequence;
         size_t argsNeeded = func.requiredArgs();
 
         if (dataThread->getQueueSize() < argsNeeded) {
-            log("Not enough data values for function (need " + to_string(argsNeeded) + ", have " +
-                to_string(dataThread->getQueueSize()) + ")");
+            if (shouldLog(LogLevel::ALL)) {
+                log("Not enough data values for function (need " + to_string(argsNeeded) +
+                    ", have " + to_string(dataThread->getQueueSize()) + ")");
+            }
+            if (ordered) ordered->skip(consumed);
             return;
         }
 
         vector<DataValue> args;
-        for (size_t i = 0; i < argsNeeded; ++i) args.push_back(dataThread->popValue());
+        {
+            ScopedSpan span(SpanType::POP_BLOCKED);
+            for (size_t i = 0; i < argsNeeded; ++i) {
+                if (lowLatency.busyPoll) {
+                    DataValue arg;
+                    if (!spinPopValue(dataThread, arg)) break;
+                    args.push_back(arg);
+                    continue;
+                }
+                optional<DataValue> arg = dataThread->popValueFor(queueWait);
+                if (!arg) break;
+                args.push_back(*arg);
+            }
+        }
+        if (args.size() < argsNeeded) {
+            // The data queue stalled or we were stopped: hand everything back
+            bool returned = functionThread->tryPushFunction(func);
+            if (!returned && ordered) ordered->skip(consumed);
+            for (const auto& arg : args) returned = dataThread->tryPushValue(arg) && returned;
+            log(returned ? "Gave up waiting for data values, elements put back"
+                         : "Gave up waiting for data values, elements lost",
+                returned ? LogLevel::ALL : LogLevel::ERRORS);
+            return;
+        }
 
-        DataValue result = applyFunction(func, args);
-        log(formatFunctionExecution(func, args, result));
+        DataValue result;
+        {
+            ScopedSpan span(SpanType::APPLY);
+            result = applyFunction(func, args);
+        }
+        if (shouldLog(LogLevel::ALL)) log(formatFunctionExecution(func, args, result));
+        if (ordered) {
+            consumed = 0;
+            ordered->complete(func.sequence, result, formatFunctionExecution(func, args, result));
+        }
         functionsProcessed.fetch_add(1);
+        if (func.generatedAt != chrono::steady_clock::time_point{}) {
+            uint64_t latencyNs = nanosecondsSince(func.generatedAt);
+            if (liveStats) liveStats->recordOperation(latencyNs);
+            if (latencies) latencies->record(latencyNs);
+        }
     } catch (const exception& e) {
-        log("Function application error: " + string(e.what()));
+        log("Function application error: " + string(e.what()), LogLevel::ERRORS);
+        if (ordered) ordered->skip(consumed);
     }
 }
 
-DataValue ProcessingThread::applyFunction(const ArithmeticFunction& func,
-                                          const vector<DataValue>& args) {
-    DataValue left = func.left_operand.has_value() ? func.left_operand.value() : args[0];
-    DataValue right = func.right_operand.has_value() ? func.right_operand.value()
-                                                     : args[func.left_operand.has_value() ? 0 : 1];
-
-    return visit(
-        [&func](const auto& x, const auto& y) -> DataValue {
-            using T = common_type_t<decay_t<decltype(x)>, decay_t<decltype(y)>>;
-            if constexpr (is_same_v<T, complex<double>>) {
-                complex<double> a(x), b(y);
-                switch (func.op) {
-                    case Operation::ADD:
-                        return a + b;
-                    case Operation::SUBTRACT:
-                        return a - b;
-                    case Operation::MULTIPLY:
-                        return a * b;
-                    case Operation::DIVIDE:
-                        if (abs(b) < 1e-10) throw runtime_error("Division by zero");
-                        return a / b;
+void ProcessingThread::processFunctionBatch(FunctionThread* functionThread,
+                                            DataThread* dataThread) {
+    ReorderBuffer* ordered = functionThread->getReorderBuffer();
+    vector<BatchItem> items;
+    size_t done = 0;  // items already completed or handed back
+    try {
+        // Never take more than the run still needs
+        int remaining = max(1, maxFunctions - functionsProcessed.load());
+        size_t limit = min(batch.maxFunctions, static_cast<size_t>(remaining));
+        {
+            ScopedSpan span(SpanType::POP_BLOCKED);
+            chrono::steady_clock::time_point deadline;
+            while (items.size() < limit) {
+                ArithmeticFunction func;
+                if (!functionThread->tryPopFunction(func)) {
+                    if (lowLatency.busyPoll) break;
+                    // The first function waits like an unbatched pop, the rest
+                    // only until the batching delay has passed
+                    auto wait = items.empty()
+                                    ? queueWait
+                                    : chrono::duration_cast<chrono::microseconds>(
+                                          deadline - chrono::steady_clock::now());
+                    if (wait.count() <= 0) break;
+                    optional<ArithmeticFunction> popped = functionThread->popFunctionFor(wait);
+                    if (!popped) break;
+                    func = *popped;
                 }
-            } else {
-                T a = static_cast<T>(x), b = static_cast<T>(y);
-                switch (func.op) {
-                    case Operation::ADD:
-                        return a + b;
-                    case Operation::SUBTRACT:
-                        return a - b;
-                    case Operation::MULTIPLY:
-                        return a * b;
-                    case Operation::DIVIDE:
-                        if (abs(static_cast<double>(b)) < 1e-10)
-                            throw runtime_error("Division by zero");
-                        return a / b;
+                if (items.empty()) deadline = chrono::steady_clock::now() + batch.maxDelay;
+                items.push_back({func, {}, DataValue(), false, {}});
+            }
+        }
+        if (items.empty()) return;
+
+        // Arguments in batch order; only the first function waits for data
+        size_t ready = 0;
+        {
+            ScopedSpan span(SpanType::POP_BLOCKED);
+            for (; ready < items.size(); ++ready) {
+                BatchItem& item = items[ready];
+                size_t needed = item.function.requiredArgs();
+                while (item.args.size() < needed) {
+                    DataValue value;
+                    if (dataThread->tryPopValue(value)) {
+                        item.args.push_back(value);
+                        continue;
+                    }
+                    if (ready > 0 || lowLatency.busyPoll) break;
+                    optional<DataValue> arg = dataThread->popValueFor(queueWait);
+                    if (!arg) break;
+                    item.args.push_back(*arg);
                 }
+                if (item.args.size() < needed) break;
             }
-            throw runtime_error("Unknown operation");
-        },
-        left, right);
+        }
+        // Functions the data queue could not serve go back with their values
+        bool returned = true;
+        for (size_t i = ready; i < items.size(); ++i) {
+            for (const auto& arg : items[i].args) {
+                returned = dataThread->tryPushValue(arg) && returned;
+            }
+            if (!functionThread->tryPushFunction(items[i].function)) {
+                returned = false;
+                if (ordered) ordered->skip(items[i].function.sequence);
+            }
+        }
+        if (!returned) log("Batch could not return every element, some lost", LogLevel::ERRORS);
+        items.erase(items.begin() + static_cast<ptrdiff_t>(ready), items.end());
+        if (items.empty()) return;
+
+        {
+            ScopedSpan span(SpanType::APPLY);
+            if (memo || IntLookupTable::isEnabled()) {
+                // Their per-function shortcuts beat the batch kernel
+                for (auto& item : items) {
+                    try {
+                        item.result = applyFunction(item.function, item.args);
+                    } catch (const exception& e) {
+                        item.failed = true;
+                        item.error = e.what();
+                    }
+                }
+            } else {
+                batchStats.buckets += applyBatch(items);
+            }
+        }
+        ++batchStats.batches;
+        batchStats.functions += items.size();
+
+        for (; done < items.size(); ++done) {
+            const BatchItem& item = items[done];
+            if (item.failed) {
+                log("Function application error: " + item.error, LogLevel::ERRORS);
+                if (ordered) ordered->skip(item.function.sequence);
+                continue;
+            }
+            if (shouldLog(LogLevel::ALL)) {
+                log(formatFunctionExecution(item.function, item.args, item.result));
+            }
+            if (ordered) {
+                ordered->complete(item.function.sequence, item.result,
+                                  formatFunctionExecution(item.function, item.args, item.result));
+            }
+            functionsProcessed.fetch_add(1);
+            if (item.function.generatedAt != chrono::steady_clock::time_point{}) {
+                uint64_t latencyNs = nanosecondsSince(item.function.generatedAt);
+                if (liveStats) liveStats->recordOperation(latencyNs);
+                if (latencies) latencies->record(latencyNs);
+            }
+        }
+    } catch (const exception& e) {
+        log("Batch error: " + string(e.what()), LogLevel::ERRORS);
+        for (; done < items.size(); ++done) {
+            if (ordered) ordered->skip(items[done].function.sequence);
+        }
+    }
+}
+
+DataValue ProcessingThread::applyFunction(const ArithmeticFunction& func,
+                                          const vector<DataValue>& args) {
+    return memo ? memo->apply(func, args) : func.apply(args);
 }
 
 string ProcessingThread::formatFunctionExecution(const ArithmeticFunction& func,
@@ -0,0 +1,126 @@
+#include "tracing.h"
+
+#include <fstream>
+#include <limits>
+
+using namespace std;
+
+thread_local Tracer::ThreadBuffer* Tracer::currentBuffer = nullptr;
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::enable(size_t maxSpansPerThread) {
+    lock_guard<mutex> lock(mtx);
+    maxSpans = maxSpansPerThread;
+    epoch = Clock::now();
+    enabled = true;
+}
+
+const char* Tracer::spanName(SpanType type) {
+    switch (type) {
+        case SpanType::GENERATE:
+            return "generate";
+        case SpanType::PUSH_BLOCKED:
+            return "push-blocked";
+        case SpanType::POP_BLOCKED:
+            return "pop-blocked";
+        case SpanType::APPLY:
+            return "apply";
+        case SpanType::TRANSFER:
+            return "transfer";
+        case SpanType::SLEEP:
+            return "sleep";
+    }
+    return "unknown";
+}
+
+void Tracer::attachCurrentThread(const string& threadType, int threadId) {
+    if (!isEnabled()) return;
+
+    auto buffer = make_unique<ThreadBuffer>();
+    buffer->threadType = threadType;
+    buffer->threadId = threadId;
+
+    lock_guard<mutex> lock(mtx);
+    // Grow on demand; most runs record far fewer spans than the limit
+    buffer->spans.reserve(min<size_t>(maxSpans, 4096));
+    currentBuffer = buffer.get();
+    buffers.push_back(move(buffer));
+}
+
+void Tracer::record(SpanType type, Clock::time_point start, Clock::time_point end) {
+    ThreadBuffer* buffer = currentBuffer;
+    if (!buffer) return;
+
+    auto startNs = chrono::duration_cast<chrono::nanoseconds>(start - epoch).count();
+    auto durationNs = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    if (startNs < 0) return;  // started before tracing was enabled
+    durationNs = min<int64_t>(durationNs, numeric_limits<uint32_t>::max());
+
+    lock_guard<mutex> lock(buffer->mtx);
+    if (buffer->spans.size() >= maxSpans) {
+        buffer->dropped++;
+        return;
+    }
+    buffer->spans.push_back(
+        {static_cast<uint64_t>(startNs), static_cast<uint32_t>(durationNs), type});
+}
+
+size_t Tracer::spanCount() const {
+    lock_guard<mutex> lock(mtx);
+    size_t total = 0;
+    for (const auto& buffer : buffers) {
+        lock_guard<mutex> bufferLock(buffer->mtx);
+        total += buffer->spans.size();
+    }
+    return total;
+}
+
+size_t Tracer::droppedCount() const {
+    lock_guard<mutex> lock(mtx);
+    size_t total = 0;
+    for (const auto& buffer : buffers) {
+        lock_guard<mutex> bufferLock(buffer->mtx);
+        total += buffer->dropped;
+    }
+    return total;
+}
+
+bool Tracer::writeChromeTrace(const string& path) const {
+    ofstream out(path);
+    if (!out) return false;
+
+    lock_guard<mutex> lock(mtx);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&]() -> ostream& {
+        if (!first) out << ",";
+        first = false;
+        return out << "\n";
+    };
+
+    for (const auto& buffer : buffers) {
+        lock_guard<mutex> bufferLock(buffer->mtx);
+        separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                    << buffer->threadId << ",\"args\":{\"name\":\"" << buffer->threadType << " "
+                    << buffer->threadId << "\"}}";
+        for (const auto& span : buffer->spans) {
+            // Trace-event timestamps are in microseconds
+            separator() << "{\"name\":\"" << spanName(span.type)
+                        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                        << ",\"ts\":" << span.startNs / 1000 << "." << span.startNs % 1000 / 100
+                        << ",\"dur\":" << span.durationNs / 1000 << "."
+                        << span.durationNs % 1000 / 100 << "}";
+        }
+        if (buffer->dropped > 0) {
+            separator() << "{\"name\":\"dropped_spans\",\"ph\":\"C\",\"pid\":1,\"tid\":"
+                        << buffer->threadId << ",\"ts\":0,\"args\":{\"dropped\":"
+                        << buffer->dropped << "}}";
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
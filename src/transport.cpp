@@ -0,0 +1,599 @@
+#include "transport.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iostream>
+
+#include "codec.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define TRANSPORT_SUPPORTED 1
+#endif
+
+using namespace std;
+
+namespace {
+
+enum FrameKind : uint8_t { HELLO_FRAME = 1, DATA_FRAME = 2, CREDIT_FRAME = 3, CLOSE_FRAME = 4 };
+enum StreamType : uint8_t { DATA_STREAM = 0, FUNCTION_STREAM = 1 };
+
+constexpr size_t FRAME_HEADER_SIZE = 4 + 1 + 2 + 4;
+constexpr uint32_t MAX_FRAME_SIZE = 16 << 20;
+constexpr int IO_TIMEOUT_MS = 100;
+
+struct Frame {
+    uint8_t kind;
+    uint16_t stream;
+    uint32_t count;
+    const char* payload;
+    size_t size;
+};
+
+void appendFrame(string& out, uint8_t kind, uint16_t stream, uint32_t count,
+                 const string& payload = string()) {
+    uint32_t length = static_cast<uint32_t>(FRAME_HEADER_SIZE - 4 + payload.size());
+    size_t start = out.size();
+    out.resize(start + FRAME_HEADER_SIZE);
+    memcpy(&out[start], &length, 4);
+    memcpy(&out[start + 4], &kind, 1);
+    memcpy(&out[start + 5], &stream, 2);
+    memcpy(&out[start + 7], &count, 4);
+    out += payload;
+}
+
+// Next complete frame at offset; false if more bytes are needed. A length
+// that cannot be valid sets error.
+bool nextFrame(const string& buffer, size_t& offset, Frame& frame, bool& error) {
+    if (buffer.size() - offset < FRAME_HEADER_SIZE) return false;
+    uint32_t length;
+    memcpy(&length, &buffer[offset], 4);
+    if (length < FRAME_HEADER_SIZE - 4 || length > MAX_FRAME_SIZE) {
+        error = true;
+        return false;
+    }
+    if (buffer.size() - offset < 4 + static_cast<size_t>(length)) return false;
+    memcpy(&frame.kind, &buffer[offset + 4], 1);
+    memcpy(&frame.stream, &buffer[offset + 5], 2);
+    memcpy(&frame.count, &buffer[offset + 7], 4);
+    frame.payload = buffer.data() + offset + FRAME_HEADER_SIZE;
+    frame.size = length - (FRAME_HEADER_SIZE - 4);
+    offset += 4 + length;
+    return true;
+}
+
+// Drops consumed bytes once they dominate the buffer
+void compact(string& buffer, size_t& offset) {
+    if (offset > 0 && offset * 2 >= buffer.size()) {
+        buffer.erase(0, offset);
+        offset = 0;
+    }
+}
+
+#ifdef TRANSPORT_SUPPORTED
+// Reads everything available; false on end of stream or error
+bool readAvailable(int fd, string& buffer) {
+    char chunk[65536];
+    while (true) {
+        ssize_t count = ::read(fd, chunk, sizeof(chunk));
+        if (count > 0) {
+            buffer.append(chunk, static_cast<size_t>(count));
+        } else if (count == 0) {
+            return false;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+}
+
+// Writes as much as the socket takes; false on error
+bool writeAvailable(int fd, string& buffer, size_t& offset) {
+    while (offset < buffer.size()) {
+        ssize_t count = ::send(fd, buffer.data() + offset, buffer.size() - offset, MSG_NOSIGNAL);
+        if (count > 0) {
+            offset += static_cast<size_t>(count);
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    buffer.clear();
+    offset = 0;
+    return true;
+}
+
+void setNonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+
+void signalEvent(int fd) {
+    if (fd < 0) return;
+    uint64_t one = 1;
+    ssize_t ignored = ::write(fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void drainEvent(int fd) {
+    uint64_t count;
+    ssize_t ignored = ::read(fd, &count, sizeof(count));
+    (void)ignored;
+}
+
+bool socketAddress(const string& path, sockaddr_un& address, string& error) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long: " + path;
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+void watch(int epollFd, int fd, uint32_t events, int operation = EPOLL_CTL_ADD) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epollFd, operation, fd, &event);
+}
+#endif
+
+}  // namespace
+
+// Sender
+
+struct TransportSender::Stream {
+    uint8_t type;
+    function<bool(string&)> next;  // pops one element and appends its encoding
+
+    mutex mtx;
+    condition_variable cv;
+    uint64_t credits = 0;
+    deque<pair<string, uint32_t>> batches;  // encoded elements and their count
+    thread puller;
+};
+
+TransportSender::TransportSender() = default;
+
+TransportSender::~TransportSender() { stop(); }
+
+void TransportSender::addStream(DataSource source) {
+    auto stream = make_unique<Stream>();
+    stream->type = DATA_STREAM;
+    stream->next = [source](string& out) {
+        DataValue value;
+        if (!source(value)) return false;
+        encode(out, value);
+        return true;
+    };
+    streams.push_back(move(stream));
+}
+
+void TransportSender::addStream(FunctionSource source) {
+    auto stream = make_unique<Stream>();
+    stream->type = FUNCTION_STREAM;
+    stream->next = [source](string& out) {
+        ArithmeticFunction function;
+        if (!source(function)) return false;
+        encode(out, function);
+        return true;
+    };
+    streams.push_back(move(stream));
+}
+
+bool TransportSender::connect(const string& path, string& error) {
+#ifdef TRANSPORT_SUPPORTED
+    sockaddr_un address;
+    if (!socketAddress(path, address, error)) return false;
+    socketFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (socketFd < 0 ||
+        ::connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        error = "cannot connect to " + path + ": " + strerror(errno);
+        if (socketFd >= 0) ::close(socketFd);
+        socketFd = -1;
+        return false;
+    }
+
+    // The stream layout lets the receiver check that both sides agree
+    string layout;
+    for (const auto& stream : streams) layout.push_back(static_cast<char>(stream->type));
+    string hello;
+    appendFrame(hello, HELLO_FRAME, 0, static_cast<uint32_t>(streams.size()), layout);
+    if (::send(socketFd, hello.data(), hello.size(), MSG_NOSIGNAL) !=
+        static_cast<ssize_t>(hello.size())) {
+        error = string("cannot send stream layout: ") + strerror(errno);
+        ::close(socketFd);
+        socketFd = -1;
+        return false;
+    }
+    setNonBlocking(socketFd);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    connected = true;
+    ioThread = thread(&TransportSender::ioLoop, this);
+    for (auto& stream : streams) {
+        stream->puller = thread(&TransportSender::pullLoop, this, ref(*stream));
+    }
+    return true;
+#else
+    (void)path;
+    error = "socket transport requires Linux (epoll)";
+    return false;
+#endif
+}
+
+void TransportSender::pullLoop(Stream& stream) {
+    while (true) {
+        {
+            unique_lock<mutex> lock(stream.mtx);
+            if (stream.credits == 0) {
+                lock_guard<mutex> statsLock(statsMtx);
+                stats.creditStalls++;
+            }
+            stream.cv.wait(lock, [&] { return stream.credits > 0 || stopping || !connected; });
+            if (stopping || !connected) return;
+            stream.credits--;
+        }
+        string bytes;
+        if (!stream.next(bytes)) return;  // source exhausted
+        {
+            lock_guard<mutex> lock(stream.mtx);
+            if (stream.batches.empty() || stream.batches.back().second >= TRANSPORT_MAX_BATCH) {
+                stream.batches.emplace_back(string(), 0);
+            }
+            stream.batches.back().first += bytes;
+            stream.batches.back().second++;
+        }
+        wake();
+    }
+}
+
+void TransportSender::wake() {
+#ifdef TRANSPORT_SUPPORTED
+    signalEvent(wakeFd);
+#endif
+}
+
+void TransportSender::ioLoop() {
+#ifdef TRANSPORT_SUPPORTED
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    watch(epollFd, socketFd, EPOLLIN);
+    watch(epollFd, wakeFd, EPOLLIN);
+    string in, out;
+    size_t inOffset = 0, outOffset = 0;
+    bool wantWrite = false;
+    bool closeSent = false;  // queued once, however many rounds out takes to drain
+
+    while (connected) {
+        epoll_event events[4];
+        int ready = epoll_wait(epollFd, events, 4, IO_TIMEOUT_MS);
+        for (int i = 0; i < ready; ++i) {
+            if (events[i].data.fd == wakeFd) {
+                drainEvent(wakeFd);
+            } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                if (!readAvailable(socketFd, in)) connected = false;
+            }
+        }
+
+        Frame frame;
+        bool error = false;
+        while (nextFrame(in, inOffset, frame, error)) {
+            if (frame.kind == CREDIT_FRAME && frame.stream < streams.size()) {
+                Stream& stream = *streams[frame.stream];
+                lock_guard<mutex> lock(stream.mtx);
+                stream.credits += frame.count;
+                stream.cv.notify_one();
+            } else if (frame.kind == CLOSE_FRAME) {
+                connected = false;
+            }
+        }
+        compact(in, inOffset);
+        if (error) connected = false;
+
+        // Everything pulled since the last round leaves in as few frames as possible
+        bool finishing = closing;  // read before the final collection
+        for (size_t s = 0; s < streams.size(); ++s) {
+            deque<pair<string, uint32_t>> batches;
+            {
+                lock_guard<mutex> lock(streams[s]->mtx);
+                batches.swap(streams[s]->batches);
+            }
+            for (const auto& [bytes, count] : batches) {
+                appendFrame(out, DATA_FRAME, static_cast<uint16_t>(s), count, bytes);
+                lock_guard<mutex> lock(statsMtx);
+                stats.frames++;
+                stats.elements += count;
+                stats.bytes += FRAME_HEADER_SIZE + bytes.size();
+            }
+        }
+        if (finishing && !closeSent) {
+            appendFrame(out, CLOSE_FRAME, 0, 0);
+            closeSent = true;
+        }
+
+        if (connected && !writeAvailable(socketFd, out, outOffset)) connected = false;
+        bool drained = out.empty();
+        if (drained == wantWrite) {
+            wantWrite = !drained;
+            watch(epollFd, socketFd, EPOLLIN | (wantWrite ? EPOLLOUT : 0u), EPOLL_CTL_MOD);
+        }
+        if (finishing && drained) break;
+    }
+
+    connected = false;
+    for (auto& stream : streams) {
+        lock_guard<mutex> lock(stream->mtx);
+        stream->cv.notify_all();
+    }
+    ::close(epollFd);
+#endif
+}
+
+void TransportSender::stop() {
+    stopping = true;
+    for (auto& stream : streams) {
+        {
+            lock_guard<mutex> lock(stream->mtx);
+            stream->cv.notify_all();
+        }
+        if (stream->puller.joinable()) stream->puller.join();
+    }
+    closing = true;
+    wake();
+    if (ioThread.joinable()) ioThread.join();
+#ifdef TRANSPORT_SUPPORTED
+    if (socketFd >= 0) ::close(socketFd);
+    if (wakeFd >= 0) ::close(wakeFd);
+#endif
+    socketFd = wakeFd = -1;
+    connected = false;
+}
+
+TransportStats TransportSender::getStats() const {
+    lock_guard<mutex> lock(statsMtx);
+    return stats;
+}
+
+// Receiver
+
+struct TransportReceiver::Stream {
+    uint8_t type;
+    int capacity;
+    uint32_t creditBatch;  // consumed elements that trigger an early credit frame
+    unique_ptr<Queue<DataValue>> values;
+    unique_ptr<Queue<ArithmeticFunction>> functions;
+    atomic<uint32_t> consumed{0};
+};
+
+TransportReceiver::TransportReceiver() = default;
+
+TransportReceiver::~TransportReceiver() { stop(); }
+
+DataSource TransportReceiver::addDataStream(int capacity) {
+    auto stream = make_shared<Stream>();
+    stream->type = DATA_STREAM;
+    stream->capacity = capacity;
+    stream->creditBatch = static_cast<uint32_t>(max(1, capacity / 4));
+    stream->values = make_unique<Queue<DataValue>>(capacity);
+    streams.push_back(stream);
+    return [this, stream](DataValue& value) {
+        try {
+            value = stream->values->pop();
+        } catch (const runtime_error&) {
+            return false;
+        }
+#ifdef TRANSPORT_SUPPORTED
+        if (stream->consumed.fetch_add(1) + 1 >= stream->creditBatch) signalEvent(wakeFd);
+#endif
+        return true;
+    };
+}
+
+FunctionSource TransportReceiver::addFunctionStream(int capacity) {
+    auto stream = make_shared<Stream>();
+    stream->type = FUNCTION_STREAM;
+    stream->capacity = capacity;
+    stream->creditBatch = static_cast<uint32_t>(max(1, capacity / 4));
+    stream->functions = make_unique<Queue<ArithmeticFunction>>(capacity);
+    streams.push_back(stream);
+    return [this, stream](ArithmeticFunction& function) {
+        try {
+            function = stream->functions->pop();
+        } catch (const runtime_error&) {
+            return false;
+        }
+#ifdef TRANSPORT_SUPPORTED
+        if (stream->consumed.fetch_add(1) + 1 >= stream->creditBatch) signalEvent(wakeFd);
+#endif
+        return true;
+    };
+}
+
+bool TransportReceiver::listen(const string& path, string& error) {
+#ifdef TRANSPORT_SUPPORTED
+    sockaddr_un address;
+    if (!socketAddress(path, address, error)) return false;
+    ::unlink(path.c_str());  // stale socket of a crashed run
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 ||
+        ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, 1) != 0) {
+        error = "cannot listen on " + path + ": " + strerror(errno);
+        if (listenFd >= 0) ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    socketPath = path;
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ioThread = thread(&TransportReceiver::ioLoop, this);
+    return true;
+#else
+    (void)path;
+    error = "socket transport requires Linux (epoll)";
+    return false;
+#endif
+}
+
+void TransportReceiver::closeStreams() {
+    for (auto& stream : streams) {
+        if (stream->values) stream->values->close();
+        if (stream->functions) stream->functions->close();
+    }
+}
+
+void TransportReceiver::ioLoop() {
+#ifdef TRANSPORT_SUPPORTED
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    watch(epollFd, listenFd, EPOLLIN);
+    watch(epollFd, wakeFd, EPOLLIN);
+    int connection = -1;
+    bool accepted = false;  // one sender per receiver
+    bool ready = false;     // stream layout checked
+    bool wantWrite = false;
+    string in, out;
+    size_t inOffset = 0, outOffset = 0;
+
+    auto disconnect = [&] {
+        if (connection >= 0) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, connection, nullptr);
+            ::close(connection);
+        }
+        connection = -1;
+        connected = false;
+        // Sources drain what arrived, then report the end
+        closeStreams();
+    };
+
+    while (!stopping) {
+        epoll_event events[4];
+        int count = epoll_wait(epollFd, events, 4, IO_TIMEOUT_MS);
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                drainEvent(wakeFd);
+            } else if (fd == listenFd) {
+                int client = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (client < 0) continue;
+                if (accepted) {
+                    ::close(client);
+                    continue;
+                }
+                accepted = true;
+                connection = client;
+                connected = true;
+                watch(epollFd, connection, EPOLLIN);
+            } else if (fd == connection && !readAvailable(connection, in)) {
+                disconnect();
+            }
+        }
+
+        Frame frame;
+        bool error = false;
+        while (connection >= 0 && nextFrame(in, inOffset, frame, error)) {
+            if (frame.kind == HELLO_FRAME) {
+                bool matches = frame.count == streams.size() && frame.size == streams.size();
+                for (size_t s = 0; matches && s < streams.size(); ++s) {
+                    matches = static_cast<uint8_t>(frame.payload[s]) == streams[s]->type;
+                }
+                if (!matches) {
+                    cerr << "Transport: sender streams do not match this node's data/function "
+                            "threads"
+                         << endl;
+                    error = true;
+                    break;
+                }
+                ready = true;
+                for (size_t s = 0; s < streams.size(); ++s) {
+                    appendFrame(out, CREDIT_FRAME, static_cast<uint16_t>(s),
+                                static_cast<uint32_t>(streams[s]->capacity));
+                }
+            } else if (frame.kind == DATA_FRAME && ready && frame.stream < streams.size()) {
+                Stream& stream = *streams[frame.stream];
+                const char* cursor = frame.payload;
+                const char* end = frame.payload + frame.size;
+                for (uint32_t e = 0; e < frame.count && !error; ++e) {
+                    // Credits guarantee room; a full queue means a broken sender
+                    if (stream.type == DATA_STREAM) {
+                        DataValue value;
+                        error = !decode(cursor, end, value) || !stream.values->tryPush(value);
+                    } else {
+                        ArithmeticFunction function;
+                        error = !decode(cursor, end, function);
+                        // Latency is measured from the arrival on this node
+                        function.generatedAt = chrono::steady_clock::now();
+                        error = error || !stream.functions->tryPush(function);
+                    }
+                }
+                lock_guard<mutex> lock(statsMtx);
+                stats.frames++;
+                stats.elements += frame.count;
+                stats.bytes += FRAME_HEADER_SIZE + frame.size;
+            } else if (frame.kind == CLOSE_FRAME) {
+                disconnect();
+            } else {
+                error = true;
+            }
+            if (error) break;
+        }
+        compact(in, inOffset);
+        if (error) disconnect();
+
+        // Return credits for everything consumed so far
+        if (connection >= 0 && ready) {
+            for (size_t s = 0; s < streams.size(); ++s) {
+                uint32_t consumed = streams[s]->consumed.exchange(0);
+                if (consumed > 0) {
+                    appendFrame(out, CREDIT_FRAME, static_cast<uint16_t>(s), consumed);
+                }
+            }
+        }
+        if (connection >= 0) {
+            if (!writeAvailable(connection, out, outOffset)) {
+                disconnect();
+            } else if (out.empty() == wantWrite) {
+                wantWrite = !out.empty();
+                watch(epollFd, connection, EPOLLIN | (wantWrite ? EPOLLOUT : 0u), EPOLL_CTL_MOD);
+            }
+        }
+    }
+
+    // Tell the sender to stop before closing
+    if (connection >= 0) {
+        string close;
+        appendFrame(close, CLOSE_FRAME, 0, 0);
+        ssize_t ignored = ::send(connection, close.data(), close.size(), MSG_NOSIGNAL);
+        (void)ignored;
+    }
+    disconnect();
+    ::close(epollFd);
+#endif
+}
+
+void TransportReceiver::stop() {
+    stopping = true;
+#ifdef TRANSPORT_SUPPORTED
+    signalEvent(wakeFd);
+#endif
+    if (ioThread.joinable()) ioThread.join();
+#ifdef TRANSPORT_SUPPORTED
+    if (listenFd >= 0) ::close(listenFd);
+    if (wakeFd >= 0) ::close(wakeFd);
+    if (!socketPath.empty()) ::unlink(socketPath.c_str());
+#endif
+    listenFd = wakeFd = -1;
+    socketPath.clear();
+    closeStreams();
+}
+
+TransportStats TransportReceiver::getStats() const {
+    lock_guard<mutex> lock(statsMtx);
+    return stats;
+}
@@ -0,0 +1,336 @@
+#include "wal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define WAL_SUPPORTED 1
+#endif
+
+using namespace std;
+namespace fs = std::filesystem;
+
+namespace {
+
+enum : uint8_t { PUSH_RECORD = 1, POP_RECORD = 2 };
+
+// length (payload bytes), checksum, type, sequence
+constexpr size_t HEADER_SIZE = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint8_t) +
+                               sizeof(uint64_t);
+
+// FNV-1a over type, sequence and payload
+uint32_t checksum(uint8_t type, uint64_t sequence, const char* payload, size_t length) {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 16777619u;
+    };
+    mix(&type, sizeof(type));
+    mix(&sequence, sizeof(sequence));
+    mix(payload, length);
+    return hash;
+}
+
+bool syncFile(int fd) {
+#if defined(__APPLE__)
+    return fsync(fd) == 0;
+#elif defined(WAL_SUPPORTED)
+    return fdatasync(fd) == 0;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+void closeFile(int fd) {
+#ifdef WAL_SUPPORTED
+    ::close(fd);
+#else
+    (void)fd;
+#endif
+}
+
+// Index n of a segment file named wal-<n>.log
+bool parseSegmentName(const string& name, uint64_t& index) {
+    if (name.size() <= 8 || name.compare(0, 4, "wal-") != 0 ||
+        name.compare(name.size() - 4, 4, ".log") != 0) {
+        return false;
+    }
+    string digits = name.substr(4, name.size() - 8);
+    if (digits.find_first_not_of("0123456789") != string::npos) return false;
+    index = stoull(digits);
+    return true;
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const WalOptions& options) : options(options) {}
+
+WriteAheadLog::~WriteAheadLog() { close(); }
+
+string WriteAheadLog::segmentPath(uint64_t index) const {
+    char name[32];
+    snprintf(name, sizeof(name), "wal-%016llu.log", static_cast<unsigned long long>(index));
+    return (fs::path(directory) / name).string();
+}
+
+bool WriteAheadLog::startSegment(uint64_t index) {
+#ifdef WAL_SUPPORTED
+    int file = ::open(segmentPath(index).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (file < 0) return false;
+    fd = file;
+    segmentSize = 0;
+    segments.push_back({index, nextSequence, 0});
+    return true;
+#else
+    (void)index;
+    return false;
+#endif
+}
+
+bool WriteAheadLog::open(const string& path, vector<pair<uint64_t, string>>& recovered) {
+    lock_guard<mutex> lock(mtx);
+    if (fd >= 0) return false;
+    recovered.clear();
+
+    error_code error;
+    fs::create_directories(path, error);
+    if (!fs::is_directory(path, error)) return false;
+    directory = path;
+
+    vector<uint64_t> indices;
+    for (const auto& entry : fs::directory_iterator(path, error)) {
+        uint64_t index;
+        if (parseSegmentName(entry.path().filename().string(), index)) indices.push_back(index);
+    }
+    sort(indices.begin(), indices.end());
+
+    // Replay: a push adds its sequence, a pop removes it
+    map<uint64_t, string> pending;
+    segments.clear();
+    nextSequence = 0;
+    for (uint64_t index : indices) {
+        ifstream file(segmentPath(index), ios::binary);
+        if (!file) return false;
+        string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        segments.push_back({index, nextSequence, 0});
+
+        const char* cursor = contents.data();
+        const char* end = cursor + contents.size();
+        while (static_cast<size_t>(end - cursor) >= HEADER_SIZE) {
+            uint32_t length, sum;
+            uint8_t type;
+            uint64_t sequence;
+            memcpy(&length, cursor, sizeof(length));
+            memcpy(&sum, cursor + 4, sizeof(sum));
+            memcpy(&type, cursor + 8, sizeof(type));
+            memcpy(&sequence, cursor + 9, sizeof(sequence));
+            const char* payload = cursor + HEADER_SIZE;
+            if (static_cast<size_t>(end - payload) < length) break;
+            if (sum != checksum(type, sequence, payload, length)) break;
+            if (type == PUSH_RECORD) {
+                pending[sequence] = string(payload, length);
+                nextSequence = max(nextSequence, sequence + 1);
+            } else if (type == POP_RECORD) {
+                pending.erase(sequence);
+            } else {
+                break;
+            }
+            cursor = payload + length;
+        }
+    }
+
+    for (auto& [sequence, payload] : pending) {
+        auto segment = upper_bound(segments.begin(), segments.end(), sequence,
+                                   [](uint64_t value, const Segment& candidate) {
+                                       return value < candidate.firstSequence;
+                                   });
+        prev(segment)->outstanding++;
+        recovered.emplace_back(sequence, move(payload));
+    }
+
+    uint64_t nextIndex = indices.empty() ? 0 : indices.back() + 1;
+    if (!startSegment(nextIndex)) {
+        segments.clear();
+        return false;
+    }
+    deletePoppedSegments();
+
+    written = durable = 0;
+    stats = WalStats();
+    stopping = false;
+    if (options.commitInterval.count() > 0) {
+        committer = thread(&WriteAheadLog::commitLoop, this);
+    }
+    return true;
+}
+
+void WriteAheadLog::close() {
+    {
+        lock_guard<mutex> lock(mtx);
+        if (fd < 0) return;
+        stopping = true;
+    }
+    commitCv.notify_all();
+    if (committer.joinable()) committer.join();
+
+    lock_guard<mutex> lock(mtx);
+    for (int retired : retiredFds) {
+        syncFile(retired);
+        closeFile(retired);
+    }
+    retiredFds.clear();
+    syncFile(fd);
+    closeFile(fd);
+    fd = -1;
+    durable = written;
+    segments.clear();
+    durableCv.notify_all();
+}
+
+bool WriteAheadLog::isOpen() const {
+    lock_guard<mutex> lock(mtx);
+    return fd >= 0;
+}
+
+void WriteAheadLog::rotateIfFull() {
+    if (segmentSize < options.segmentBytes) return;
+    // The committer syncs and closes the old file; without one it happens here
+    if (options.commitInterval.count() > 0) {
+        retiredFds.push_back(fd);
+    } else {
+        syncFile(fd);
+        closeFile(fd);
+    }
+    fd = -1;
+    if (!startSegment(segments.back().index + 1)) {
+        throw runtime_error("Could not create write-ahead log segment");
+    }
+}
+
+uint64_t WriteAheadLog::append(uint8_t type, uint64_t sequence, const string& payload) {
+#ifdef WAL_SUPPORTED
+    string record(HEADER_SIZE, '\0');
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    uint32_t sum = checksum(type, sequence, payload.data(), payload.size());
+    memcpy(&record[0], &length, sizeof(length));
+    memcpy(&record[4], &sum, sizeof(sum));
+    memcpy(&record[8], &type, sizeof(type));
+    memcpy(&record[9], &sequence, sizeof(sequence));
+    record += payload;
+
+    const char* data = record.data();
+    size_t remaining = record.size();
+    while (remaining > 0) {
+        ssize_t count = ::write(fd, data, remaining);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("Write-ahead log write failed: ") + strerror(errno));
+        }
+        data += count;
+        remaining -= static_cast<size_t>(count);
+    }
+
+    segmentSize += record.size();
+    written += record.size();
+    stats.appends++;
+    stats.bytes += record.size();
+    if (options.commitInterval.count() == 0) {
+        if (!syncFile(fd)) throw runtime_error("Write-ahead log sync failed");
+        stats.syncs++;
+        durable = written;
+    }
+    return written;
+#else
+    (void)type;
+    (void)sequence;
+    (void)payload;
+    throw runtime_error("Write-ahead log is not supported on this platform");
+#endif
+}
+
+uint64_t WriteAheadLog::appendPush(const string& payload, uint64_t& sequence) {
+    lock_guard<mutex> lock(mtx);
+    if (fd < 0) throw runtime_error("Write-ahead log is not open");
+    // Rotate first so the new segment's firstSequence covers this push
+    rotateIfFull();
+    sequence = nextSequence++;
+    uint64_t position = append(PUSH_RECORD, sequence, payload);
+    segments.back().outstanding++;
+    return position;
+}
+
+uint64_t WriteAheadLog::appendPop(uint64_t sequence) {
+    lock_guard<mutex> lock(mtx);
+    if (fd < 0) throw runtime_error("Write-ahead log is not open");
+    rotateIfFull();
+    uint64_t position = append(POP_RECORD, sequence, string());
+    acknowledge(sequence);
+    return position;
+}
+
+void WriteAheadLog::acknowledge(uint64_t sequence) {
+    auto segment = upper_bound(segments.begin(), segments.end(), sequence,
+                               [](uint64_t value, const Segment& candidate) {
+                                   return value < candidate.firstSequence;
+                               });
+    if (segment == segments.begin()) return;  // already in a deleted segment
+    segment = prev(segment);
+    if (segment->outstanding > 0) segment->outstanding--;
+    deletePoppedSegments();
+}
+
+void WriteAheadLog::deletePoppedSegments() {
+    // Only a prefix can go: later segments hold pops of earlier pushes
+    while (segments.size() > 1 && segments.front().outstanding == 0) {
+        error_code error;
+        fs::remove(segmentPath(segments.front().index), error);
+        segments.erase(segments.begin());
+    }
+}
+
+void WriteAheadLog::waitDurable(uint64_t position) {
+    unique_lock<mutex> lock(mtx);
+    durableCv.wait(lock, [this, position] { return durable >= position || fd < 0; });
+}
+
+WalStats WriteAheadLog::getStats() const {
+    lock_guard<mutex> lock(mtx);
+    WalStats current = stats;
+    current.segments = segments.size();
+    return current;
+}
+
+void WriteAheadLog::commitLoop() {
+    unique_lock<mutex> lock(mtx);
+    while (!stopping) {
+        commitCv.wait_for(lock, options.commitInterval, [this] { return stopping; });
+        if (stopping || (written == durable && retiredFds.empty())) continue;
+
+        // One sync covers every record appended so far; appends continue meanwhile
+        uint64_t target = written;
+        int current = fd;
+        vector<int> retired;
+        retired.swap(retiredFds);
+        lock.unlock();
+        for (int file : retired) {
+            syncFile(file);
+            closeFile(file);
+        }
+        syncFile(current);
+        lock.lock();
+
+        stats.syncs++;
+        durable = max(durable, target);
+        durableCv.notify_all();
+    }
+}
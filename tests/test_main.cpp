@@ -1,4 +1,12 @@
+#include <algorithm>
 #include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
 #include <chrono>
 #include <iostream>
 #include <memory>
@@ -6,8 +14,38 @@
 #include <thread>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "autotune.h"
+#include "backpressure.h"
+#include "batch.h"
+#include "codec.h"
+#include "control.h"
+#include "durable_queue.h"
+#include "hash_ring.h"
+#include "live_stats.h"
+#include "lookup_table.h"
+#include "low_latency.h"
+#include "memo_cache.h"
+#include "metrics.h"
+#include "multiprocess.h"
+#include "option_list.h"
+#include "perf_counters.h"
+#include "pipeline.h"
 #include "queue.h"
+#include "queue_registry.h"
+#include "queue_sampler.h"
+#include "random.h"
+#include "reorder_buffer.h"
+#include "shm_queue.h"
+#include "simulator.h"
+#include "snapshot.h"
 #include "threads.h"
+#include "tracing.h"
+#include "transport.h"
 
 using namespace std;
 
@@ -45,6 +83,65 @@ void test_queue_basic_functionality() {
     TEST(queue.empty(), "Queue is empty after all pops");
 }
 
+// Test lock-free size()/empty() under concurrent producers and consumers
+void test_queue_lock_free_size() {
+    cout << "\n=== Testing Queue Lock-Free Size ===" << endl;
+
+    Queue<int> queue(8);
+    TEST(queue.empty() && queue.size() == 0, "New queue reports empty");
+
+    atomic<bool> done{false};
+    atomic<bool> withinCapacity{true};
+    thread observer([&] {
+        while (!done) {
+            if (queue.size() > static_cast<size_t>(queue.getMaxCapacity())) withinCapacity = false;
+        }
+    });
+
+    vector<thread> workers;
+    for (int p = 0; p < 2; ++p) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i) queue.push(i);
+        });
+        workers.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i) queue.pop();
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    done = true;
+    observer.join();
+
+    TEST(withinCapacity, "Observed size never exceeds capacity");
+    TEST(queue.empty() && queue.size() == 0, "Size settles to zero once quiescent");
+}
+
+// Test that close() releases blocked callers
+void test_queue_close() {
+    cout << "\n=== Testing Queue Close ===" << endl;
+
+    Queue<int> queue(1);
+    bool popThrew = false;
+    thread consumer([&] {
+        try {
+            queue.pop();
+        } catch (const runtime_error&) {
+            popThrew = true;
+        }
+    });
+    this_thread::sleep_for(chrono::milliseconds(50));
+    queue.close();
+    consumer.join();
+    TEST(popThrew, "Blocked pop is released by close");
+
+    Queue<int> full(1);
+    full.push(1);
+    thread producer([&] { full.push(2); });
+    this_thread::sleep_for(chrono::milliseconds(50));
+    full.close();
+    producer.join();
+    TEST(full.size() == 1 && full.pop() == 1, "Blocked push is released and discarded");
+}
+
 // Test queue with different data types
 void test_queue_with_variant() {
     cout << "\n=== Testing Queue with DataValue Types ===" << endl;
@@ -210,6 +307,1574 @@ void test_arithmetic_function_evaluation() {
     cout << "  " << func3.description() << endl;
 }
 
+// Test perf counter collection (must degrade gracefully without perf support)
+void test_perf_counters() {
+    cout << "\n=== Testing Perf Counter Collection ===" << endl;
+
+    PerfCollector& collector = PerfCollector::instance();
+    collector.enable();
+    size_t before = collector.readAll().size();
+    auto openFds = [] {
+        auto entries = filesystem::directory_iterator("/proc/self/fd");
+        return distance(filesystem::begin(entries), filesystem::end(entries));
+    };
+    auto fdsBefore = openFds();
+
+    {
+        DataThread thread(1);
+        this_thread::sleep_for(chrono::milliseconds(300));
+        thread.stop();
+    }
+
+    auto counters = collector.readAll();
+    TEST(counters.size() == before + 1, "Thread registers its counters at start");
+    TEST(!counters.empty() && counters.back().first == "DataThread",
+         "Counters are attributed to the thread type");
+    TEST(openFds() == fdsBefore, "Destroyed thread closes its counters and keeps its values");
+
+    ostringstream report;
+    collector.report(report, 0);
+    TEST(report.str().find("Perf counters:") != string::npos,
+         "Report is produced with or without perf support");
+}
+
+// Test timeline tracing and Chrome trace export
+void test_tracing() {
+    cout << "\n=== Testing Timeline Tracing ===" << endl;
+
+    Tracer& tracer = Tracer::instance();
+    tracer.enable();
+
+    {
+        DataThread thread(1);
+        this_thread::sleep_for(chrono::milliseconds(300));
+        thread.stop();
+    }
+
+    TEST(tracer.spanCount() > 0, "Worker activity is recorded as spans");
+
+    const string path = "test_trace.json";
+    TEST(tracer.writeChromeTrace(path), "Trace file is written");
+
+    ifstream in(path);
+    string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    TEST(contents.find("\"traceEvents\"") != string::npos, "Trace uses trace-event format");
+    TEST(contents.find("\"generate\"") != string::npos &&
+             contents.find("\"push-blocked\"") != string::npos,
+         "Trace contains generate and push spans");
+    TEST(contents.find("DataThread 1") != string::npos, "Trace names the thread");
+    remove(path.c_str());
+}
+
+// Test live statistics published through shared memory
+void test_live_stats() {
+    cout << "\n=== Testing Live Statistics Segment ===" << endl;
+
+    const string name = "/pt_test_live_stats";
+    if (!LiveStats::instance().open(name)) {
+        cout << "Shared memory unavailable, skipping" << endl;
+        return;
+    }
+
+    {
+        DataThread thread(1);
+        this_thread::sleep_for(chrono::milliseconds(300));
+        thread.popValue();
+        thread.stop();
+    }
+
+    string error;
+    const LiveStatsSegment* segment = attachLiveStats(name, error);
+    TEST(segment != nullptr, "Viewer can attach to the segment read-only");
+    if (segment) {
+        uint32_t queues = segment->queueCount.load();
+        TEST(queues >= 1, "Queue is registered in the segment");
+        if (queues >= 1) {
+            const QueueStats& queue = segment->queues[queues - 1];
+            TEST(queue.kind == StatsKind::DATA && queue.capacity == 50,
+                 "Queue slot describes the data queue");
+            TEST(queue.pushed.load() >= 1 && queue.popped.load() == 1,
+                 "Push and pop counters are published");
+        }
+        TEST(segment->threadCount.load() >= 1 &&
+                 segment->threads[segment->threadCount.load() - 1].operations.load() >= 1,
+             "Thread operation counter is published");
+
+        uint32_t threads = segment->threadCount.load();
+        TEST(segment->queues[queues - 1].generation.load() % 2 == 0 &&
+                 segment->threads[threads - 1].generation.load() % 2 == 0,
+             "Destroyed thread frees its queue and thread slots");
+        {
+            DataThread replacement(2);
+            replacement.stop();
+            TEST(segment->queueCount.load() == queues && segment->threadCount.load() == threads,
+                 "New thread reuses the freed slots");
+            TEST(segment->queues[queues - 1].generation.load() % 2 == 1 &&
+                     segment->queues[queues - 1].popped.load() == 0,
+                 "Reused slot starts with fresh counters");
+            replacement.setQueueCapacity(80);
+            TEST(segment->queues[queues - 1].capacity.load() == 80,
+                 "Capacity changes are published");
+
+            replacement.join();
+            replacement.setQueueCapacity(2);
+            replacement.setOverflowPolicy(OverflowPolicy::DROP_OLDEST);
+            for (int i = 0; i < 5; ++i) replacement.pushValue(i);
+            const QueueStats& slot = segment->queues[queues - 1];
+            TEST(slot.evicted.load() >= 3 &&
+                     slot.pushed.load() - slot.popped.load() - slot.evicted.load() ==
+                         replacement.getQueueSize(),
+                 "Evicted elements are published, keeping the depth exact");
+        }
+        detachLiveStats(segment);
+    }
+    LiveStats::instance().close();
+}
+
+// Test queue occupancy sampling and CSV export
+void test_queue_sampler() {
+    cout << "\n=== Testing Queue Occupancy Sampler ===" << endl;
+
+    Queue<int> first;
+    Queue<DataValue> second;
+    QueueSampler sampler(chrono::milliseconds(5), 3);
+    sampler.addQueue(first, "data");
+    sampler.addQueue(second, "function");
+
+    for (int i = 1; i <= 4; ++i) {
+        first.push(i);
+        if (i % 2 == 0) second.push(i);
+        sampler.sampleNow();
+    }
+
+    TEST(sampler.sampleCount() == 3, "Ring buffer keeps at most maxSamples rows");
+    TEST(sampler.samplesFor(0) == vector<uint32_t>({2, 3, 4}),
+         "Oldest samples are overwritten first");
+    TEST(sampler.samplesFor(1) == vector<uint32_t>({1, 1, 2}), "Each queue has its own column");
+
+    const string path = "test_queue_samples.csv";
+    TEST(sampler.writeCsv(path), "Samples are exported as CSV");
+    ifstream in(path);
+    string header;
+    getline(in, header);
+    TEST(header == "time_ms,data_" + to_string(first.getId()) + ",function_" +
+                       to_string(second.getId()),
+         "CSV header names every queue");
+    remove(path.c_str());
+
+    QueueSampler background(chrono::milliseconds(5));
+    background.addQueue(first, "data");
+    background.start();
+    this_thread::sleep_for(chrono::milliseconds(100));
+    background.stop();
+    TEST(background.sampleCount() >= 5, "Background thread samples at the configured interval");
+}
+
+// Test latency histogram percentiles
+void test_latency_histogram() {
+    cout << "\n=== Testing Latency Histogram ===" << endl;
+
+    LatencyHistogram histogram;
+    TEST(histogram.percentile(50) == 0 && histogram.count() == 0, "Empty histogram reports 0");
+
+    for (uint64_t us = 1; us <= 1000; ++us) histogram.record(us * 1000);
+    TEST(histogram.count() == 1000 && histogram.max() == 1000000, "Count and max are exact");
+
+    auto withinSixPercent = [](uint64_t actual, uint64_t expected) {
+        return actual >= expected && actual <= expected + expected / 16;
+    };
+    TEST(withinSixPercent(histogram.percentile(50), 500000), "p50 is within bucket precision");
+    TEST(withinSixPercent(histogram.percentile(99), 990000), "p99 is within bucket precision");
+    TEST(histogram.percentile(100) == 1000000, "p100 is the maximum");
+
+    histogram.reset();
+    TEST(histogram.count() == 0 && histogram.max() == 0, "Reset clears the histogram");
+}
+
+// Test a full pipeline run and shutdown without pacing
+void test_pipeline() {
+    cout << "\n=== Testing Pipeline ===" << endl;
+
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+
+    PipelineConfig config;
+    config.functionThreads = 2;
+    config.dataThreads = 2;
+    config.processingThreads = 2;
+    config.dataPacing = DATA_PACING.scaled(0.01);
+    config.functionPacing = FUNCTION_PACING.scaled(0.01);
+    config.processingPacing = PROCESSING_PACING.scaled(0);
+
+    Pipeline pipeline(config);
+    TEST(pipeline.getConfig().dataQueueCapacity == calculateQueueCapacity(2),
+         "Default capacity follows the producer count");
+    pipeline.start();
+    this_thread::sleep_for(chrono::milliseconds(500));
+
+    auto stopStart = chrono::steady_clock::now();
+    pipeline.stop();
+    auto stopTime = chrono::steady_clock::now() - stopStart;
+
+    TEST(pipeline.getFunctionsProcessed() > 0, "Pipeline applies functions");
+    TEST(pipeline.getLatencies().count() ==
+             static_cast<uint64_t>(pipeline.getFunctionsProcessed()),
+         "Latency is recorded for every applied function");
+    TEST(stopTime < chrono::seconds(1), "Stop releases blocked threads promptly");
+
+    BaseThread::setLogLevel(previous);
+}
+
+// Test the discrete-event model against known bounds
+void test_simulator() {
+    cout << "\n=== Testing Simulator ===" << endl;
+
+    ServiceTimes service = calibrateServiceTimes(10000);
+    TEST(service.generateNs > 0 && service.transferNs > 0 && service.applyNs > 0,
+         "Calibration measures positive service times");
+
+    SimulationConfig config;
+    config.pipeline.functionThreads = 2;
+    config.pipeline.dataThreads = 4;
+    config.pipeline.processingThreads = 64;
+    config.pipeline.dataPacing = DATA_PACING.scaled(0.1);
+    config.pipeline.functionPacing = FUNCTION_PACING.scaled(0.1);
+    config.pipeline.processingPacing = PROCESSING_PACING.scaled(0.1);
+    config.service = service;
+    config.durationSeconds = 5;
+
+    SimulationResult first = simulate(config);
+    SimulationResult second = simulate(config);
+    TEST(first.functionsApplied == second.functionsApplied &&
+             first.meanDataQueueLength == second.meanDataQueueLength,
+         "Same seed gives the same simulation");
+
+    // Function threads 100 and 101 generate every 30 ms and 37.5 ms
+    double generationRate = 1 / 0.030 + 1 / 0.0375;
+    TEST(first.throughput > 0 && first.throughput <= generationRate * 1.05,
+         "Throughput is bounded by the function generation rate");
+    TEST(first.meanFunctionQueueLength < 1, "Many processors keep function queues short");
+    TEST(first.dataQueueLengths.size() == 4 && first.functionQueueLengths.size() == 2,
+         "Queue lengths are reported per queue");
+
+    config.pipeline.maxFunctions = 10;
+    SimulationResult limited = simulate(config);
+    TEST(limited.functionsApplied <= 10, "maxFunctions stops the simulation");
+
+    // Transfers between two full data queues time out and return their value
+    SimulationConfig full;
+    full.pipeline.functionThreads = 0;
+    full.pipeline.dataThreads = 2;
+    full.pipeline.processingThreads = 4;
+    full.pipeline.dataQueueCapacity = 1;
+    full.pipeline.dataPacing = DATA_PACING.scaled(0.01);
+    full.pipeline.processingPacing = PROCESSING_PACING.scaled(0.01);
+    full.service = service;
+    SimulationResult refused = simulate(full);
+    TEST(refused.transfersRefused > 0 && refused.valuesLost <= refused.transfersRefused,
+         "Refused transfers put their value back instead of blocking");
+    full.pipeline.lowLatency.busyPoll = true;
+    SimulationResult polled = simulate(full);
+    TEST(polled.transfersRefused > refused.transfersRefused,
+         "Busy-polling transfers give up on a full destination at once");
+}
+
+// Test auto-tuning decisions on fixed measured rates
+void test_autotune() {
+    cout << "\n=== Testing Auto-Tuner ===" << endl;
+
+    PipelineConfig config;
+    config.functionThreads = 2;
+    config.dataThreads = 4;
+    MeasuredRates rates;
+    rates.functionRate = 50;
+    rates.dataRate = 100;
+
+    AutoTuneTarget target;
+    target.utilization = 0.5;
+    AutoTuneResult result = sizePipeline(config, rates, target);
+    TEST(result.utilization > 0 && result.utilization <= 0.5, "Utilization target is met");
+    TEST(result.processingThreads > 1, "Fast generators need several processing threads");
+    TEST(result.functionQueueCapacity >= 1 &&
+             result.dataQueueCapacity >= calculateQueueCapacity(config.dataThreads),
+         "Capacities keep the deadlock-avoiding minimum");
+    TEST(!result.dataLimited, "Enough data for the function rate");
+
+    AutoTuneTarget latency;
+    latency.latencyMs = result.latencyMs / 2;
+    AutoTuneResult fast = sizePipeline(config, rates, latency);
+    TEST(fast.latencyMs <= latency.latencyMs, "Latency target is met");
+    TEST(fast.processingThreads > result.processingThreads,
+         "A tighter latency target needs more threads");
+
+    config.functionThreads = 0;
+    config.processingThreads = 3;
+    AutoTuneResult none = sizePipeline(config, rates, target);
+    TEST(none.processingThreads == 3 && none.utilization == 0,
+         "Topologies without functions are left unchanged");
+
+    ostringstream report;
+    report << setprecision(4);
+    printAutoTuneReport(report, result, target);
+    report.str("");
+    report << 1.23456;
+    TEST(report.str() == "1.235", "The report restores the caller's number format");
+}
+
+// Test binary encoding of values and functions
+void test_codec() {
+    cout << "\n=== Testing Codec ===" << endl;
+
+    vector<DataValue> values{42, -7.5f, complex<double>(1.5, -2.25)};
+    string bytes;
+    for (const auto& value : values) encode(bytes, value);
+    const char* cursor = bytes.data();
+    const char* end = cursor + bytes.size();
+    bool same = true;
+    for (const auto& value : values) {
+        DataValue decoded;
+        same = same && decode(cursor, end, decoded) && decoded == value;
+    }
+    TEST(same && cursor == end, "Values survive encode/decode");
+
+    ArithmeticFunction function;
+    function.op = Operation::DIVIDE;
+    function.right_operand = complex<double>(3, 4);
+    bytes.clear();
+    encode(bytes, function);
+    ArithmeticFunction decoded;
+    cursor = bytes.data();
+    TEST(decode(cursor, bytes.data() + bytes.size(), decoded) &&
+             decoded.description() == function.description(),
+         "Functions survive encode/decode");
+
+    cursor = bytes.data();
+    TEST(!decode(cursor, bytes.data() + bytes.size() - 1, decoded),
+         "Truncated input is rejected");
+}
+
+// Test write-ahead-logged queue recovery
+void test_durable_queue() {
+    cout << "\n=== Testing Durable Queue ===" << endl;
+
+    string directory = (filesystem::temp_directory_path() / "pt_test_wal").string();
+    filesystem::remove_all(directory);
+    WalOptions options;
+    options.segmentBytes = 256;  // many small segments
+
+    {
+        DurableQueue<DataValue> queue(directory, 100, options);
+        for (int i = 0; i < 50; ++i) queue.push(i);
+        for (int i = 0; i < 20; ++i) queue.pop();
+        TEST(queue.getLogStats().syncs > 0, "Commits are synced");
+        queue.close();
+    }
+
+    {
+        DurableQueue<DataValue> queue(directory, 10, options);
+        TEST(queue.recoveredCount() == 30, "Unpopped pushes are recovered");
+        TEST(queue.getMaxCapacity() == 30, "Capacity grows to hold recovered elements");
+        TEST(get<int>(queue.pop()) == 20, "Recovered elements keep their order");
+        for (int i = 21; i < 50; ++i) queue.pop();
+        TEST(queue.getLogStats().segments == 1, "Fully popped segments are deleted");
+        queue.push(complex<double>(1, 2));
+        queue.close();
+        bool threw = false;
+        try {
+            queue.pop();
+        } catch (const runtime_error&) {
+            threw = true;
+        }
+        TEST(threw && queue.size() == 1, "Element stays queued when its pop cannot be logged");
+    }
+
+    // A record torn by a crash ends the replay of its segment
+    vector<filesystem::path> segments;
+    for (const auto& entry : filesystem::directory_iterator(directory)) {
+        segments.push_back(entry.path());
+    }
+    sort(segments.begin(), segments.end());
+    {
+        ofstream tail(segments.back(), ios::binary | ios::app);
+        tail << "torn";
+    }
+    {
+        DurableQueue<DataValue> queue(directory, 10, options);
+        TEST(queue.recoveredCount() == 1 && queue.pop() == DataValue(complex<double>(1, 2)),
+             "Recovery stops cleanly at a torn record");
+        queue.close();
+    }
+
+    filesystem::remove_all(directory);
+}
+
+// Test queue snapshots through a file and back into a pipeline
+void test_snapshot() {
+    cout << "\n=== Testing Snapshot ===" << endl;
+
+    Queue<int> queue(2);
+    TEST(queue.tryPush(1) && queue.tryPush(2) && !queue.tryPush(3), "tryPush stops when full");
+    TEST(queue.contents() == vector<int>({1, 2}) && queue.size() == 2,
+         "contents() copies without removing");
+
+    QueueSnapshot snapshot;
+    snapshot.dataQueues = {{1, 2.5f, complex<double>(0, 1), 4}, {5, 6, 7, 8}};
+    ArithmeticFunction function;
+    function.op = Operation::SUBTRACT;
+    function.left_operand = 9;
+    snapshot.functionQueues = {{function}};
+
+    string path = (filesystem::temp_directory_path() / "pt_test_snapshot.bin").string();
+    TEST(saveSnapshot(path, snapshot), "Snapshot is saved");
+    QueueSnapshot loaded;
+    TEST(loadSnapshot(path, loaded) && loaded.dataQueues == snapshot.dataQueues &&
+             loaded.functionCount() == 1 &&
+             loaded.functionQueues[0][0].description() == function.description(),
+         "Snapshot loads back unchanged");
+
+    filesystem::resize_file(path, filesystem::file_size(path) - 1);
+    TEST(!loadSnapshot(path, loaded), "Damaged snapshot is rejected");
+    filesystem::remove(path);
+
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    PipelineConfig config;
+    config.dataThreads = 1;
+    config.functionThreads = 1;
+    config.dataQueueCapacity = 3;
+    Pipeline pipeline(config);
+    size_t dropped = restoreSnapshot(snapshot, pipeline);
+    pipeline.startDataThreads();
+    pipeline.startFunctionThreads();
+    TEST(dropped == 5, "Restore counts the elements beyond the queue capacity");
+    auto restoredValues = pipeline.getDataThreads()[0]->getQueue().contents();
+    TEST(restoredValues.size() == 3 && restoredValues[0] == DataValue(1) &&
+             restoredValues[2] == DataValue(complex<double>(0, 1)),
+         "Restored elements are queued before the generator's own");
+    pipeline.stop();
+    BaseThread::setLogLevel(previous);
+}
+
+// Test the shared-memory queue within and across processes
+void test_shm_queue() {
+    cout << "\n=== Testing Shared-Memory Queue ===" << endl;
+
+    string name = "/pt_test_shm_queue";
+    auto queue = ShmQueue<DataValue>::create(name, 4);
+    if (!queue) {
+        cout << "Shared memory unavailable, skipping" << endl;
+        return;
+    }
+    auto attached = ShmQueue<DataValue>::attach(name);
+    TEST(attached && attached->getMaxCapacity() == 4, "Second handle attaches by name");
+    TEST(!ShmQueue<ArithmeticFunction>::attach(name), "Attach rejects another element type");
+
+    queue->push(1);
+    queue->push(complex<double>(2, 3));
+    TEST(attached->size() == 2 && get<int>(attached->pop()) == 1,
+         "Elements pushed on one handle pop on the other");
+    TEST(queue->tryPush(4) && queue->tryPush(5) && queue->tryPush(6) && !queue->tryPush(7),
+         "tryPush stops when full");
+    while (!queue->empty()) queue->pop();
+
+#if defined(__unix__) || defined(__APPLE__)
+    // A child process pushes more than fits, so both sides block on futexes
+    const int count = 2000;
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (int i = 0; i < count; ++i) attached->push(i);
+        _exit(0);
+    }
+    bool ordered = true;
+    for (int i = 0; i < count; ++i) ordered = ordered && get<int>(queue->pop()) == i;
+    waitpid(pid, nullptr, 0);
+    TEST(ordered, "Elements cross processes in order");
+#endif
+
+    queue->close();
+    bool threw = false;
+    try {
+        attached->pop();
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    TEST(threw, "pop throws once the queue is closed and empty");
+
+    // Generator threads can forward a source instead of generating
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    int remaining = 3;
+    DataThread sourced(1, 10, DATA_PACING, [&remaining](DataValue& value) {
+        if (remaining == 0) return false;
+        value = remaining--;
+        return true;
+    });
+    this_thread::sleep_for(chrono::milliseconds(100));
+    sourced.stop();
+    sourced.join();
+    TEST(sourced.getQueueSize() == 3 && get<int>(sourced.popValue()) == 3,
+         "DataThread forwards its source unpaced");
+
+#if defined(__unix__) || defined(__APPLE__)
+    // A crashed generator process ends its source instead of blocking it
+    PipelineConfig config;
+    config.dataThreads = 1;
+    config.dataQueueCapacity = 4;
+    config.dataPacing = DATA_PACING.scaled(0.05);
+    {
+        GeneratorProcesses crashed;
+        if (crashed.start(config)) {
+            crashed.attachSources(config);
+            DataValue value;
+            TEST(config.dataSources[0](value), "Source receives from its generator process");
+            kill(crashed.getPids()[0], SIGKILL);
+            auto killedAt = chrono::steady_clock::now();
+            while (config.dataSources[0](value)) {
+            }
+            TEST(crashed.exitedCount() == 1 &&
+                     chrono::steady_clock::now() - killedAt < chrono::seconds(2),
+                 "Source ends once its generator process has died");
+        }
+    }
+    // A hung one is killed at shutdown
+    {
+        GeneratorProcesses hung;
+        if (hung.start(config)) {
+            kill(hung.getPids()[0], SIGSTOP);
+            auto stopAt = chrono::steady_clock::now();
+            hung.stop();
+            TEST(hung.exitedCount() == 1 &&
+                     chrono::steady_clock::now() - stopAt < chrono::seconds(5),
+                 "Shutdown does not wait forever for a hung generator process");
+        }
+    }
+#endif
+    BaseThread::setLogLevel(previous);
+}
+
+// Test socket transport between a sender and a receiver
+void test_transport() {
+    cout << "\n=== Testing Socket Transport ===" << endl;
+
+    string path = (filesystem::temp_directory_path() / "pt_test_transport.sock").string();
+    TransportReceiver receiver;
+    DataSource values = receiver.addDataStream(8);
+    FunctionSource functions = receiver.addFunctionStream(4);
+    string error;
+    if (!receiver.listen(path, error)) {
+        cout << "Socket transport unavailable (" << error << "), skipping" << endl;
+        return;
+    }
+
+    // Far more elements than the receiving queues hold, so credits must flow back
+    const int count = 2000;
+    int nextValue = 0, nextFunction = 0;
+    TransportSender sender;
+    sender.addStream([&nextValue](DataValue& value) {
+        if (nextValue == count) return false;
+        value = nextValue++;
+        return true;
+    });
+    sender.addStream([&nextFunction](ArithmeticFunction& function) {
+        if (nextFunction == count / 10) return false;
+        function.op = Operation::ADD;
+        function.right_operand = nextFunction++;
+        return true;
+    });
+    TEST(sender.connect(path, error), "Sender connects to the receiver");
+
+    bool ordered = true;
+    for (int i = 0; i < count; ++i) {
+        DataValue value;
+        ordered = ordered && values(value) && get<int>(value) == i;
+    }
+    for (int i = 0; i < count / 10; ++i) {
+        ArithmeticFunction function;
+        ordered = ordered && functions(function) && get<int>(*function.right_operand) == i;
+    }
+    TEST(ordered, "Elements of every stream arrive in order");
+
+    sender.stop();
+    DataValue value;
+    TEST(!values(value), "Receiver sources end once the sender closed");
+    TransportStats sent = sender.getStats();
+    TransportStats received = receiver.getStats();
+    TEST(sent.elements == static_cast<uint64_t>(count + count / 10) &&
+             received.elements == sent.elements,
+         "Stats count every element on both sides");
+    TEST(sent.creditStalls > 0, "Sender waits for credit when the remote queue is full");
+    receiver.stop();
+    TEST(!filesystem::exists(path), "Receiver removes its socket file");
+}
+
+// Test int/int lookup table against computed results
+void test_lookup_table() {
+    cout << "\n=== Testing Int Lookup Table ===" << endl;
+
+    const IntLookupTable& table = IntLookupTable::instance();
+    bool same = true;
+    for (int op = 0; op < 4; ++op) {
+        for (int a = DATA_MIN_VALUE; a <= DATA_MAX_VALUE; a += 7) {
+            for (int b = DATA_MIN_VALUE; b <= DATA_MAX_VALUE; b += 3) {
+                if (b == 0) continue;
+                ArithmeticFunction func;
+                func.op = static_cast<Operation>(op);
+                DataValue computed = func.apply({a, b});
+                same = same && get<int>(computed) == table.lookup(func.op, a, b);
+            }
+        }
+    }
+    TEST(same, "Table matches computed int results");
+    TEST(IntLookupTable::covers(DATA_MIN_VALUE, DATA_MAX_VALUE) &&
+             !IntLookupTable::covers(DATA_MAX_VALUE + 1, 0),
+         "Table covers exactly the data range");
+
+    bool threw = false;
+    try {
+        table.lookup(Operation::DIVIDE, 5, 0);
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    TEST(threw, "Division by zero entries throw");
+
+    IntLookupTable::enable(true);
+    ArithmeticFunction func;
+    func.op = Operation::MULTIPLY;
+    func.right_operand = -20;
+    bool viaTable = get<int>(func.apply({100})) == -2000 &&
+                    holds_alternative<float>(func.apply({2.5f}));
+    func.op = Operation::DIVIDE;
+    func.right_operand = 0;
+    threw = false;
+    try {
+        func.apply({7});
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    IntLookupTable::enable(false);
+    TEST(viaTable && threw, "apply uses the table for int/int and computes other types");
+}
+
+// Test memoized function results
+void test_memo_cache() {
+    cout << "\n=== Testing Memo Cache ===" << endl;
+
+    MemoCache memo(100);
+    TEST(memo.capacity() == 128, "Capacity rounds up to a power of two");
+
+    ArithmeticFunction func;
+    func.op = Operation::MULTIPLY;
+    func.right_operand = complex<double>(0, 1);
+    vector<DataValue> args{complex<double>(2, 3)};
+    DataValue first = memo.apply(func, args);
+    DataValue second = memo.apply(func, args);
+    TEST(first == func.apply(args) && second == first, "Cached result equals the computed one");
+    TEST(memo.getStats().hits == 1 && memo.getStats().misses == 1, "Repeat lookup hits");
+
+    // Equal numbers of different types give different results
+    func.op = Operation::DIVIDE;
+    func.right_operand = 2;
+    DataValue asInt = memo.apply(func, {DataValue(5)});
+    DataValue asFloat = memo.apply(func, {DataValue(5.0f)});
+    TEST(get<int>(asInt) == 2 && get<float>(asFloat) == 2.5f, "Operand types are part of the key");
+
+    func.right_operand = 0;
+    bool threw = false;
+    for (int i = 0; i < 2; ++i) {
+        try {
+            memo.apply(func, {DataValue(1)});
+        } catch (const runtime_error&) {
+            threw = true;
+        }
+    }
+    TEST(threw && memo.getStats().hits == 1, "Division by zero is not cached");
+
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    PipelineConfig config;
+    config.functionThreads = 2;
+    config.dataThreads = 2;
+    config.processingThreads = 2;
+    config.dataPacing = DATA_PACING.scaled(0.01);
+    config.functionPacing = FUNCTION_PACING.scaled(0.01);
+    config.processingPacing = PROCESSING_PACING.scaled(0.01);
+    config.memoEntries = 256;
+    Pipeline pipeline(config);
+    pipeline.start();
+    this_thread::sleep_for(chrono::milliseconds(300));
+    pipeline.stop();
+    BaseThread::setLogLevel(previous);
+    TEST(pipeline.getMemoStats().lookups() >=
+             static_cast<uint64_t>(pipeline.getFunctionsProcessed()),
+         "Processing threads apply functions through their caches");
+}
+
+// Test the warm-up barrier and parallel thread creation
+void test_prefill() {
+    cout << "\n=== Testing Prefill Barrier ===" << endl;
+
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    logQueueCreation = false;
+
+    PipelineConfig config;
+    config.functionThreads = 16;
+    config.dataThreads = 32;
+    config.dataPacing = DATA_PACING.scaled(0.05);
+    config.functionPacing = FUNCTION_PACING.scaled(0.05);
+    Pipeline pipeline(config);
+    pipeline.startDataThreads();
+    pipeline.startFunctionThreads();
+
+    bool ordered = true;
+    for (int i = 0; i < config.dataThreads; ++i) {
+        ordered = ordered && pipeline.getDataThreads()[i]->getId() == i + 1;
+    }
+    for (int i = 0; i < config.functionThreads; ++i) {
+        ordered = ordered && pipeline.getFunctionThreads()[i]->getId() == i + 100;
+    }
+    TEST(ordered, "Threads created in parallel keep their ids and order");
+    TEST(pipeline.waitForPrefill(0, chrono::milliseconds(0)), "Level 0 does not wait");
+
+    bool ready = pipeline.waitForPrefill(3, chrono::seconds(5));
+    bool filled = true;
+    for (const auto& thread : pipeline.getDataThreads()) {
+        filled = filled && thread->getQueueSize() >= 3;
+    }
+    for (const auto& thread : pipeline.getFunctionThreads()) {
+        filled = filled && thread->getQueueSize() >= 3;
+    }
+    TEST(ready && filled, "Barrier returns once every queue reached the level");
+    TEST(!pipeline.waitForPrefill(1000, chrono::milliseconds(50)),
+         "Barrier gives up after the timeout");
+    pipeline.stop();
+
+    logQueueCreation = true;
+    BaseThread::setLogLevel(previous);
+}
+
+// Test the list parser shared by the sweep and benchmark tools
+void test_option_list() {
+    cout << "\n=== Testing Option Lists ===" << endl;
+
+    TEST(parseList<int>("1,2,4") == vector<int>({1, 2, 4}) &&
+             parseList<double>("0.5") == vector<double>({0.5}),
+         "Comma-separated numbers are parsed");
+    int rejected = 0;
+    for (const char* text : {"", "1,x", "2,-1", "1,,2"}) {
+        try {
+            parseList<int>(text);
+        } catch (const invalid_argument&) {
+            ++rejected;
+        }
+    }
+    TEST(rejected == 4, "Malformed, negative and empty items are rejected");
+}
+
+// Test seed derivation and the compact generator
+void test_seeding() {
+    cout << "\n=== Testing Seed Service ===" << endl;
+
+    SeedService& seeds = SeedService::instance();
+    TEST(seeds.seedFor(1) != seeds.seedFor(1), "Unfixed seeds differ on every call");
+
+    seeds.setSeed(42);
+    uint64_t first = seeds.seedFor(1);
+    TEST(first == seeds.seedFor(1) && first != seeds.seedFor(2),
+         "A fixed seed derives one seed per stream id");
+
+    Xoshiro128 a(first), b(first), c(seeds.seedFor(2));
+    bool same = true, different = false;
+    double sum = 0;
+    const int draws = 100000;
+    for (int i = 0; i < draws; ++i) {
+        uint32_t value = a();
+        same = same && value == b();
+        different = different || value != c();
+        sum += value / 4294967296.0;
+    }
+    TEST(same && different, "Generators repeat for equal seeds only");
+    TEST(sum / draws > 0.49 && sum / draws < 0.51, "Output is uniform on average");
+    TEST(sizeof(ThreadRng) <= sizeof(std::mt19937), "Thread generator is not larger than mt19937");
+
+    seeds.clearSeed();
+    TEST(seeds.seedFor(1) != seeds.seedFor(1), "Clearing the seed restores unfixed seeds");
+}
+
+// Test the low-latency profile: CPU lists, non-blocking pops and busy-polling
+void test_low_latency() {
+    cout << "\n=== Testing Low-Latency Profile ===" << endl;
+
+    TEST(parseCpuList("0-2,5") == vector<int>({0, 1, 2, 5}), "CPU lists expand ranges");
+    bool threw = false;
+    try {
+        parseCpuList("3-1");
+    } catch (const invalid_argument&) {
+        threw = true;
+    }
+    TEST(threw, "Reversed CPU ranges are rejected");
+
+    vector<int> cpus = lowLatencyCpus(1);
+    TEST(cpus.size() == 1 && cpus[0] >= 0, "A CPU is chosen for a busy-polling thread");
+#if defined(__linux__)
+    bool pinned = false;
+    thread([&] { pinned = pinCurrentThread(cpus); }).join();
+    TEST(pinned, "Threads can be pinned to the chosen CPU");
+#endif
+
+    Queue<int> queue(2);
+    int value = 0;
+    TEST(!queue.tryPop(value), "tryPop fails on an empty queue");
+    queue.push(7);
+    TEST(queue.tryPop(value) && value == 7 && queue.empty(), "tryPop takes the front element");
+
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    PipelineConfig config;
+    config.functionThreads = 2;
+    config.dataThreads = 2;
+    config.processingThreads = 1;
+    config.dataPacing = DATA_PACING.scaled(0.01);
+    config.functionPacing = FUNCTION_PACING.scaled(0.01);
+    config.lowLatency.busyPoll = true;
+    Pipeline pipeline(config);
+    pipeline.start();
+    this_thread::sleep_for(chrono::milliseconds(300));
+    auto stopStart = chrono::steady_clock::now();
+    pipeline.stop();
+    auto stopTime = chrono::steady_clock::now() - stopStart;
+    BaseThread::setLogLevel(previous);
+    TEST(pipeline.getFunctionsProcessed() > 0, "Busy-polling threads apply functions");
+    TEST(stopTime < chrono::seconds(1), "Busy-polling threads stop promptly");
+}
+
+void test_queue_registry() {
+    cout << "\n=== Testing Queue Registry ===" << endl;
+
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    logQueueCreation = false;
+
+    {
+        QueueRegistry registry;
+        auto reader = registry.registerReader();
+        auto first = make_unique<DataThread>(1, 10, DATA_PACING.scaled(0.05));
+        auto second = make_unique<DataThread>(2, 10, DATA_PACING.scaled(0.05));
+        registry.add(first.get());
+        registry.add(second.get());
+        TEST(registry.getVersion() == 2, "Every change publishes a new snapshot");
+        {
+            auto snapshot = reader->read();
+            TEST(snapshot->dataThreads.size() == 2 && snapshot->dataThreads[1] == second.get(),
+                 "Reader sees the registered threads in order");
+
+            second->stop();
+            second->closeQueue();
+            TEST(registry.retire(move(second)), "Registered thread can be retired");
+            registry.reclaim();
+            TEST(registry.retiredCount() > 0 && snapshot->dataThreads.size() == 2,
+                 "Snapshot held by a reader survives the retirement");
+        }
+        registry.reclaim();
+        TEST(registry.retiredCount() == 0, "Retired thread is reclaimed after the grace period");
+        TEST(reader->read()->dataThreads.size() == 1, "New read sections see the new topology");
+        TEST(!registry.retire(make_unique<DataThread>(3, 10)), "Unknown thread is not retired");
+        first->stop();
+        first->closeQueue();
+    }
+
+    PipelineConfig config;
+    config.functionThreads = 1;
+    config.dataThreads = 1;
+    config.processingThreads = 2;
+    config.dataPacing = DATA_PACING.scaled(0.05);
+    config.functionPacing = FUNCTION_PACING.scaled(0.05);
+    config.processingPacing = PROCESSING_PACING.scaled(0.05);
+    Pipeline pipeline(config);
+    pipeline.start();
+
+    int dataId = pipeline.addDataThread();
+    int functionId = pipeline.addFunctionThread();
+    TEST(dataId == 2 && functionId == 101, "Added generators get the next free ids");
+    this_thread::sleep_for(chrono::milliseconds(200));
+    TEST(pipeline.retireDataThread(1) && pipeline.retireFunctionThread(100),
+         "Initial generators can be retired while processing runs");
+    TEST(!pipeline.retireDataThread(1), "Retiring twice fails");
+    int before = pipeline.getFunctionsProcessed();
+    this_thread::sleep_for(chrono::milliseconds(300));
+    TEST(pipeline.getFunctionsProcessed() > before,
+         "Processing continues on the generators added at runtime");
+    TEST(pipeline.getDataThreads().size() == 1 && pipeline.getDataThreads()[0]->getId() == 2,
+         "Pipeline keeps only the live generators");
+    pipeline.stop();
+    TEST(pipeline.getRegistry().retiredCount() == 0, "Stopping reclaims every retired generator");
+
+    // Ids stay in their kind's range
+    PipelineConfig crowded;
+    crowded.dataThreads = 98;
+    crowded.functionThreads = 99;
+    Pipeline full(crowded);
+    bool dataRejected = false, functionRejected = false;
+    dataId = full.addDataThread();
+    functionId = full.addFunctionThread();
+    try {
+        full.addDataThread();
+    } catch (const runtime_error&) {
+        dataRejected = true;
+    }
+    try {
+        full.addFunctionThread();
+    } catch (const runtime_error&) {
+        functionRejected = true;
+    }
+    TEST(dataId == 99 && functionId == 199 && dataRejected && functionRejected,
+         "Adding beyond a kind's id range fails");
+
+    logQueueCreation = true;
+    BaseThread::setLogLevel(previous);
+}
+
+void test_control() {
+    cout << "\n=== Testing Control Socket ===" << endl;
+
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    logQueueCreation = false;
+
+    PipelineConfig config;
+    config.functionThreads = 1;
+    config.dataThreads = 2;
+    config.processingThreads = 1;
+    config.dataPacing = DATA_PACING.scaled(0.05);
+    config.functionPacing = FUNCTION_PACING.scaled(0.05);
+    config.processingPacing = PROCESSING_PACING.scaled(0.05);
+    Pipeline pipeline(config);
+    pipeline.start();
+    ControlServer control(pipeline);
+
+    auto succeeded = [](const string& reply) {
+        return reply.size() >= 3 && reply.compare(reply.size() - 3, 3, "ok\n") == 0;
+    };
+    TEST(control.execute("add processing 2") == "added processing 201\nadded processing 202\nok\n",
+         "Processing threads are added with the next ids");
+    TEST(succeeded(control.execute("remove processing")) &&
+             pipeline.getProcessingThreads().size() == 2,
+         "Removing without id retires the newest thread");
+    TEST(succeeded(control.execute("rate data 2")) &&
+             pipeline.getDataThreads()[0]->getDelay() == DATA_PACING.scaled(0.025).delayFor(1),
+         "Rate divides the startup delays");
+    TEST(succeeded(control.execute("rate function max")) &&
+             pipeline.getFunctionThreads()[0]->getDelay().count() == 0,
+         "Rate max removes the delays");
+    TEST(succeeded(control.execute("capacity data 7")) &&
+             pipeline.getDataThreads()[1]->getQueue().getMaxCapacity() == 7,
+         "Capacity resizes live queues");
+    TEST(succeeded(control.execute("log errors")) &&
+             BaseThread::getLogLevel() == LogLevel::ERRORS,
+         "Log level changes");
+    BaseThread::setLogLevel(LogLevel::OFF);
+    TEST(control.execute("rate data -1").rfind("error: ", 0) == 0 &&
+             control.execute("remove data 42").rfind("error: ", 0) == 0 &&
+             control.execute("frobnicate").rfind("error: ", 0) == 0,
+         "Invalid commands are rejected");
+
+    string path = (filesystem::temp_directory_path() / "pt_test_control.sock").string();
+    string error, reply;
+    if (control.listen(path, error)) {
+        TEST(sendControlCommand(path, "add data", reply, error) && reply == "added data 3\nok\n",
+             "Commands are served over the socket");
+        TEST(sendControlCommand(path, "stats", reply, error) &&
+                 reply.find("threads data=3 function=1 processing=2") != string::npos &&
+                 reply.find("data 3: ") != string::npos && succeeded(reply),
+             "Stats list every thread kind and queue");
+        control.stop();
+        TEST(!filesystem::exists(path), "Stopping removes the socket file");
+    } else {
+        cout << "Control socket unavailable (" << error << "), skipping" << endl;
+    }
+    pipeline.stop();
+
+    logQueueCreation = true;
+    BaseThread::setLogLevel(previous);
+}
+
+void test_overflow_policies() {
+    cout << "\n=== Testing Overflow Policies ===" << endl;
+
+    logQueueCreation = false;
+    Queue<int> dropNewest(2, OverflowPolicy::DROP_NEWEST);
+    dropNewest.push(1);
+    dropNewest.push(2);
+    TEST(dropNewest.push(3) == PushResult::DROPPED && dropNewest.contents() == vector<int>({1, 2}),
+         "Drop-newest discards the pushed element");
+    TEST(dropNewest.droppedCount() == 1 && dropNewest.rejectedCount() == 0,
+         "Drop-newest counts the discarded element");
+
+    Queue<int> dropOldest(2, OverflowPolicy::DROP_OLDEST);
+    dropOldest.push(1);
+    dropOldest.push(2);
+    TEST(dropOldest.push(3) == PushResult::EVICTED_OLDEST &&
+             dropOldest.contents() == vector<int>({2, 3}),
+         "Drop-oldest keeps the newest elements like a ring");
+    dropOldest.setMaxCapacity(1);
+    dropOldest.push(4);
+    TEST(dropOldest.contents() == vector<int>({4}) && dropOldest.droppedCount() == 3,
+         "Drop-oldest evicts down to a lowered capacity");
+    TEST(dropOldest.evictedCount() == 3 && dropNewest.evictedCount() == 0,
+         "Only removed queued elements count as evicted");
+
+    Queue<int> reject(1, OverflowPolicy::REJECT);
+    reject.push(1);
+    TEST(reject.push(2) == PushResult::REJECTED && reject.rejectedCount() == 1 &&
+             reject.droppedCount() == 0,
+         "Reject refuses the element with a status");
+    reject.close();
+    TEST(reject.push(3) == PushResult::CLOSED, "Closed queues report it");
+
+    Queue<int> blocking(1);
+    blocking.push(1);
+    PushResult released = PushResult::PUSHED;
+    thread pusher([&] { released = blocking.push(2); });
+    this_thread::sleep_for(chrono::milliseconds(50));
+    blocking.setOverflowPolicy(OverflowPolicy::DROP_NEWEST);
+    pusher.join();
+    TEST(released == PushResult::DROPPED, "Changing the policy releases blocked pushers");
+
+    OverflowPolicy parsed;
+    TEST(parseOverflowPolicy("drop-oldest", parsed) && parsed == OverflowPolicy::DROP_OLDEST &&
+             !parseOverflowPolicy("sometimes", parsed),
+         "Policy names parse");
+
+    // Generators without consumers shed load instead of blocking
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    PipelineConfig config;
+    config.dataThreads = 2;
+    config.functionThreads = 1;
+    config.dataQueueCapacity = 4;
+    config.functionQueueCapacity = 4;
+    config.dataPacing = DATA_PACING.scaled(0.01);
+    config.functionPacing = FUNCTION_PACING.scaled(0.01);
+    config.dataOverflow = OverflowPolicy::DROP_OLDEST;
+    config.functionOverflow = OverflowPolicy::REJECT;
+    Pipeline pipeline(config);
+    pipeline.startDataThreads();
+    pipeline.startFunctionThreads();
+    this_thread::sleep_for(chrono::milliseconds(200));
+    OverflowCounts counts = pipeline.getOverflowCounts();
+    TEST(counts.dropped > 0 && counts.rejected > 0, "Pipeline sums the overflow counters");
+    pipeline.stop();
+    BaseThread::setLogLevel(previous);
+    logQueueCreation = true;
+}
+
+void test_timed_queue_operations() {
+    cout << "\n=== Testing Timed Queue Operations ===" << endl;
+
+    logQueueCreation = false;
+    Queue<int> queue(1);
+    auto start = chrono::steady_clock::now();
+    TEST(!queue.popFor(chrono::milliseconds(20)).has_value() &&
+             chrono::steady_clock::now() - start >= chrono::milliseconds(20),
+         "popFor gives up after the timeout on an empty queue");
+    TEST(queue.pushFor(1, chrono::milliseconds(20)) == PushResult::PUSHED,
+         "pushFor pushes when there is room");
+    start = chrono::steady_clock::now();
+    TEST(queue.pushFor(2, chrono::milliseconds(20)) == PushResult::TIMED_OUT &&
+             chrono::steady_clock::now() - start >= chrono::milliseconds(20) &&
+             queue.contents() == vector<int>({1}),
+         "pushFor times out on a full blocking queue");
+    TEST(queue.popUntil(chrono::steady_clock::now() + chrono::milliseconds(20)) == optional<int>(1),
+         "popUntil returns an available element");
+
+    thread producer([&queue] {
+        this_thread::sleep_for(chrono::milliseconds(20));
+        queue.push(3);
+    });
+    TEST(queue.popFor(chrono::seconds(5)) == optional<int>(3),
+         "popFor wakes up as soon as an element arrives");
+    producer.join();
+
+    queue.close();
+    bool threw = false;
+    try {
+        queue.popFor(chrono::milliseconds(20));
+    } catch (const runtime_error&) {
+        threw = true;
+    }
+    TEST(threw, "Timed pops still report a closed, drained queue");
+
+    // Transfers between two full queues must not pin a processing thread:
+    // each attempt gives up after the wait and puts the value back
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    QueueRegistry registry;
+    auto idle = [](DataValue&) { return false; };
+    DataThread first(1, 1, DATA_PACING, idle);
+    DataThread second(2, 1, DATA_PACING, idle);
+    first.pushValue(1);
+    second.pushValue(2);
+    registry.add(&first);
+    registry.add(&second);
+    atomic<int> processed{0};
+    chrono::steady_clock::duration stopTime;
+    {
+        ProcessingThread processor(200, processed, 1, registry, PROCESSING_PACING.scaled(0.01),
+                                   nullptr, 0, {}, chrono::milliseconds(10));
+        this_thread::sleep_for(chrono::milliseconds(100));
+        start = chrono::steady_clock::now();
+        processor.stop();
+        processor.join();
+        stopTime = chrono::steady_clock::now() - start;
+    }
+    TEST(stopTime < chrono::seconds(1), "Processing thread stops while both queues stay full");
+    TEST(first.getQueueSize() == 1 && second.getQueueSize() == 1,
+         "Timed-out transfers return the value to its source");
+    BaseThread::setLogLevel(previous);
+    logQueueCreation = true;
+}
+
+void test_backpressure() {
+    cout << "\n=== Testing Backpressure ===" << endl;
+
+    logQueueCreation = false;
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    QueueRegistry registry;
+    auto idle = [](DataValue&) { return false; };
+    DataThread busy(1, 10, DATA_PACING, idle);
+    DataThread calm(2, 10, DATA_PACING, idle);
+    for (int i = 0; i < 8; ++i) busy.pushValue(i);
+    registry.add(&busy);
+    registry.add(&calm);
+
+    LatencyHistogram latencies;
+    BackpressureConfig config;
+    config.latencyTarget = chrono::milliseconds(10);
+    BackpressureController controller(registry, &latencies, config);
+    controller.update();
+    TEST(abs(busy.getThrottle() - 0.7) < 1e-9 && calm.getThrottle() == 1,
+         "Only the generator of a queue above the target fill is slowed down");
+    for (int i = 0; i < 20; ++i) controller.update();
+    TEST(abs(busy.getThrottle() - config.minThrottle) < 1e-9,
+         "Throttle decreases multiplicatively down to the minimum");
+
+    DataValue value;
+    while (busy.tryPopValue(value)) {
+    }
+    controller.update();
+    controller.update();
+    TEST(abs(busy.getThrottle() - (config.minThrottle + 2 * config.increase)) < 1e-9,
+         "Throttle recovers additively once the queue drains");
+
+    latencies.record(50'000'000);
+    controller.update();
+    TEST(calm.getThrottle() < 1 && busy.getThrottle() < config.minThrottle + 2 * config.increase,
+         "A missed latency target slows every generator down");
+    latencies.record(1'000'000);
+    controller.update();
+    TEST(calm.getThrottle() > 0.7, "Latency is judged per interval, not cumulatively");
+    latencies.reset();
+    latencies.record(1'000'000);
+    controller.update();
+    TEST(calm.getThrottle() > 0.7, "A histogram reset starts a new window");
+
+    // The window is taken from count and sum snapshots that agree
+    LatencyHistogram shared;
+    atomic<bool> recording{true};
+    thread recorder([&] {
+        while (recording) shared.record(1000);
+    });
+    bool consistent = true;
+    for (int i = 0; i < 100000; ++i) {
+        LatencyHistogram::Totals totals = shared.totals();
+        consistent = consistent && totals.sumNs <= totals.count * 1000;
+    }
+    recording = false;
+    recorder.join();
+    TEST(consistent, "Every value in the sum snapshot is also counted");
+
+    BackpressureStats stats = controller.getStats();
+    TEST(stats.intervals == 26 && stats.decreases > 0 && stats.increases > 0,
+         "Controller counts its intervals and adjustments");
+
+    BackpressureConfig fast;
+    fast.interval = chrono::milliseconds(5);
+    BackpressureController running(registry, nullptr, fast);
+    running.start();
+    this_thread::sleep_for(chrono::milliseconds(100));
+    running.stop();
+    TEST(running.getStats().intervals > 0 && calm.getThrottle() == 1,
+         "Started controller adjusts throttles every interval");
+    BaseThread::setLogLevel(previous);
+    logQueueCreation = true;
+}
+
+void test_reorder_buffer() {
+    cout << "\n=== Testing Reorder Buffer ===" << endl;
+
+    vector<uint64_t> released;
+    ReorderMetrics metrics;
+    ReorderConfig config;
+    config.capacity = 4;
+    config.gapTimeout = chrono::milliseconds(30);
+    {
+        ReorderBuffer buffer(100, [&released](const OrderedResult& r) {
+            released.push_back(r.sequence);
+        }, config, &metrics);
+        buffer.complete(2, 2, "two");
+        buffer.complete(3, 3, "three");
+        TEST(released.empty() && buffer.depth() == 2, "Results wait for the missing head");
+        buffer.complete(1, 1, "one");
+        TEST(released == vector<uint64_t>({1, 2, 3}) && buffer.getHead() == 4,
+             "Results are released in sequence once the head completes");
+
+        buffer.skip(4);
+        buffer.complete(5, 5, "five");
+        TEST(released.size() == 4 && released.back() == 5, "Skipped sequences leave no gap");
+
+        buffer.complete(7, 7, "seven");
+        TEST(released.size() == 4, "A missing sequence holds back later results");
+        this_thread::sleep_for(chrono::milliseconds(40));
+        buffer.complete(8, 8, "eight");
+        TEST(released == vector<uint64_t>({1, 2, 3, 5, 7, 8}) && metrics.gaps == 1,
+             "Missing sequence is given up after the gap timeout");
+        buffer.complete(6, 6, "six");
+        TEST(released.back() == 6 && metrics.late == 1, "A late result is released at once");
+
+        buffer.complete(0, 0, "unsequenced");
+        TEST(released.back() == 0, "Unsequenced results bypass the buffer");
+        buffer.complete(11, 11, "eleven");
+        TEST(released.back() == 0 && metrics.maxDepth >= 2, "Depth is tracked");
+    }
+    TEST(released.back() == 11 && metrics.gaps == 3, "Destruction flushes held results");
+    TEST(metrics.released == 9 && metrics.delay.count() == 9,
+         "Every release records its reorder delay");
+
+    // A result a whole capacity ahead of an empty buffer moves the window
+    // after the gap timeout although nothing is pending to trigger it
+    released.clear();
+    ReorderMetrics windowMetrics;
+    {
+        ReorderBuffer buffer(100, [&released](const OrderedResult& r) {
+            released.push_back(r.sequence);
+        }, config, &windowMetrics);
+        buffer.complete(config.capacity + 5, 9, "nine");
+        TEST(buffer.getHead() == 6 && windowMetrics.gaps == 5 && released.empty(),
+             "A result beyond the window gives up the sequences it pushes out");
+    }
+    TEST(released == vector<uint64_t>({config.capacity + 5}) && windowMetrics.gaps == 8,
+         "The result is released once its own gaps are given up");
+
+    // A slow sink holds up only the completer that runs it
+    atomic<bool> sinkBlocked{true};
+    vector<uint64_t> slow;
+    {
+        ReorderBuffer buffer(100, [&sinkBlocked, &slow](const OrderedResult& r) {
+            while (sinkBlocked.load()) this_thread::yield();
+            slow.push_back(r.sequence);
+        }, config);
+        thread first([&buffer] { buffer.complete(1, 1, "one"); });
+        while (buffer.getHead() != 2) this_thread::yield();
+        buffer.complete(2, 2, "two");
+        TEST(slow.empty(), "A completer does not wait for another's sink");
+        sinkBlocked = false;
+        first.join();
+    }
+    TEST(slow == vector<uint64_t>({1, 2}), "The emitting completer delivers both in order");
+
+    // Concurrent completers, each completing every fourth sequence out of
+    // order, with a buffer smaller than the span of in-flight results
+    constexpr int COMPLETERS = 4;
+    constexpr uint64_t PER_COMPLETER = 2000;
+    vector<uint64_t> ordered;
+    config.capacity = 64;
+    config.gapTimeout = chrono::seconds(10);
+    {
+        ReorderBuffer buffer(100, [&ordered](const OrderedResult& r) {
+            ordered.push_back(r.sequence);
+        }, config);
+        vector<thread> completers;
+        for (int c = 0; c < COMPLETERS; ++c) {
+            completers.emplace_back([&buffer, c] {
+                for (uint64_t i = 0; i < PER_COMPLETER; ++i) {
+                    uint64_t sequence = i * COMPLETERS + static_cast<uint64_t>(c) + 1;
+                    if (sequence % 97 == 0) {
+                        buffer.skip(sequence);
+                    } else {
+                        buffer.complete(sequence, static_cast<int>(sequence), string());
+                    }
+                    if (i % 64 == 0) this_thread::yield();
+                }
+            });
+        }
+        for (auto& completer : completers) completer.join();
+    }
+    bool inOrder = !ordered.empty() && is_sorted(ordered.begin(), ordered.end()) &&
+                   adjacent_find(ordered.begin(), ordered.end()) == ordered.end();
+    uint64_t total = COMPLETERS * PER_COMPLETER;
+    TEST(inOrder && ordered.size() == total - total / 97,
+         "Concurrent completions are released exactly once and in order");
+
+    // Pipeline: every function thread's results come out in generation order
+    logQueueCreation = false;
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    mutex outputMtx;
+    map<int, vector<uint64_t>> streams;
+    PipelineConfig pipelineConfig;
+    pipelineConfig.functionThreads = 2;
+    pipelineConfig.dataThreads = 2;
+    pipelineConfig.processingThreads = 3;
+    pipelineConfig.maxFunctions = 30;
+    pipelineConfig.dataPacing = DATA_PACING.scaled(0.02);
+    pipelineConfig.functionPacing = FUNCTION_PACING.scaled(0.02);
+    pipelineConfig.processingPacing = PROCESSING_PACING.scaled(0.02);
+    pipelineConfig.orderedSink = [&](const OrderedResult& r) {
+        lock_guard<mutex> lock(outputMtx);
+        streams[r.stream].push_back(r.sequence);
+    };
+    Pipeline pipeline(pipelineConfig);
+    pipeline.start();
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(20);
+    while (pipeline.getFunctionsProcessed() < 30 && chrono::steady_clock::now() < deadline) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    pipeline.stop();
+    bool streamsOrdered = true;
+    size_t count = 0;
+    for (const auto& [stream, sequences] : streams) {
+        streamsOrdered = streamsOrdered && stream >= 100 &&
+                         is_sorted(sequences.begin(), sequences.end());
+        count += sequences.size();
+    }
+    TEST(streamsOrdered && count == static_cast<size_t>(pipeline.getFunctionsProcessed()) &&
+             pipeline.getReorderMetrics().released == count,
+         "Pipeline releases every applied function in its stream's order");
+    BaseThread::setLogLevel(previous);
+    logQueueCreation = true;
+}
+
+void test_partitioned_routing() {
+    cout << "\n=== Testing Partitioned Routing ===" << endl;
+
+    HashRing ring;
+    TEST(ring.owner(1) == -1, "Empty ring owns nothing");
+    ring.add(200);
+    TEST(ring.owner(1) == 200 && ring.owner(12345) == 200, "A single node owns every key");
+    for (int node = 201; node < 204; ++node) ring.add(node);
+    ring.add(203);
+    TEST(ring.size() == 4, "Adding a present node changes nothing");
+
+    constexpr int KEYS = 2000;
+    map<int, int> shares;
+    vector<int> before(KEYS);
+    for (int key = 0; key < KEYS; ++key) {
+        before[key] = ring.owner(static_cast<uint64_t>(key));
+        ++shares[before[key]];
+    }
+    bool balanced = shares.size() == 4;
+    for (const auto& [node, keys] : shares) {
+        balanced = balanced && keys > KEYS / 8 && keys < KEYS / 2;
+    }
+    TEST(balanced, "Keys spread over all nodes");
+
+    ring.add(204);
+    int moved = 0;
+    bool onlyToNewNode = true;
+    for (int key = 0; key < KEYS; ++key) {
+        int owner = ring.owner(static_cast<uint64_t>(key));
+        if (owner != before[key]) {
+            ++moved;
+            onlyToNewNode = onlyToNewNode && owner == 204;
+        }
+    }
+    TEST(onlyToNewNode && moved > KEYS / 10 && moved < KEYS * 3 / 10,
+         "Adding a node moves about 1/n of the keys, all to it");
+    ring.remove(204);
+    bool restored = true;
+    for (int key = 0; key < KEYS; ++key) {
+        restored = restored && ring.owner(static_cast<uint64_t>(key)) == before[key];
+    }
+    TEST(restored, "Removing the node restores the previous assignment");
+    vector<uint64_t> keys = {3, 9, 27};
+    int nearest = HashRing::nearest(200, keys);
+    TEST(nearest >= 0 && HashRing::nearest(200, keys) == nearest &&
+             HashRing::nearest(200, {}) == -1,
+         "The key nearest to a node is deterministic");
+
+    QueueRegistry registry;
+    uint64_t version = registry.getVersion();
+    registry.addPartitionOwner(200);
+    registry.addPartitionOwner(201);
+    TEST(registry.getVersion() == version + 2 && registry.partitionOwner(7) >= 200,
+         "Registry publishes partition owners in its snapshots");
+    registry.removePartitionOwner(201);
+    registry.removePartitionOwner(200);
+    TEST(registry.partitionOwner(7) == -1, "Removed owners no longer serve generators");
+
+    // Partitioned pipeline keeps processing across rebalancing
+    logQueueCreation = false;
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    PipelineConfig config;
+    config.functionThreads = 4;
+    config.dataThreads = 4;
+    config.processingThreads = 2;
+    config.maxFunctions = 40;
+    config.dataPacing = DATA_PACING.scaled(0.02);
+    config.functionPacing = FUNCTION_PACING.scaled(0.02);
+    config.processingPacing = PROCESSING_PACING.scaled(0.02);
+    config.partitioned = true;
+    Pipeline pipeline(config);
+    pipeline.start();
+    auto waitFor = [&pipeline](int count) {
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(20);
+        while (pipeline.getFunctionsProcessed() < count && chrono::steady_clock::now() < deadline) {
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        return pipeline.getFunctionsProcessed() >= count;
+    };
+    TEST(waitFor(10), "Partitioned processing threads apply functions");
+    int added = pipeline.addProcessingThread();
+    bool ownsSome = false;
+    for (const auto& thread : pipeline.getDataThreads()) {
+        ownsSome = ownsSome || pipeline.getRegistry().partitionOwner(thread->getId()) == added;
+    }
+    for (const auto& thread : pipeline.getFunctionThreads()) {
+        ownsSome = ownsSome || pipeline.getRegistry().partitionOwner(thread->getId()) == added;
+    }
+    pipeline.retireProcessingThread(200);
+    bool noneFor200 = true;
+    for (const auto& thread : pipeline.getDataThreads()) {
+        noneFor200 = noneFor200 && pipeline.getRegistry().partitionOwner(thread->getId()) != 200;
+    }
+    TEST(ownsSome && noneFor200, "Adding and retiring processing threads rebalances queues");
+    {
+        auto reader = pipeline.getRegistry().registerReader();
+        auto topology = reader->read();
+        map<int, int> owners;  // generator id -> processing threads owning its queue
+        bool borrowsOne = true;
+        for (int id : {201, added}) {
+            QueuePartition partition = partitionFor(*topology, id);
+            auto countOwned = [&topology, &owners, id](const auto& threads) {
+                size_t count = 0;
+                for (auto* thread : threads) {
+                    if (topology->partitions.owner(static_cast<uint64_t>(thread->getId())) != id) {
+                        continue;
+                    }
+                    ++owners[thread->getId()];
+                    ++count;
+                }
+                return count;
+            };
+            size_t data = countOwned(partition.data);
+            size_t functions = countOwned(partition.functions);
+            borrowsOne = borrowsOne && partition.data.size() == max(data, size_t{1}) &&
+                         partition.functions.size() == max(functions, size_t{1});
+        }
+        bool oneOwner = owners.size() == topology->dataThreads.size() +
+                                             topology->functionThreads.size();
+        for (const auto& [generator, count] : owners) oneOwner = oneOwner && count == 1;
+        TEST(oneOwner && borrowsOne,
+             "After a rebalance each queue has one owner and borrowing takes one queue");
+    }
+    TEST(waitFor(40), "Processing continues after rebalancing");
+    pipeline.stop();
+    BaseThread::setLogLevel(previous);
+    logQueueCreation = true;
+}
+
+void test_micro_batching() {
+    cout << "\n=== Testing Micro-Batching ===" << endl;
+
+    // The batch kernel must agree with apply() for every operation and type mix
+    vector<DataValue> values = {7, -3, 0, 2.5f, -0.5f, 0.0f, complex<double>(1, 2),
+                                complex<double>(0, 0)};
+    vector<BatchItem> items;
+    for (int op = 0; op < 4; ++op) {
+        for (const auto& left : values) {
+            for (const auto& right : values) {
+                ArithmeticFunction both{static_cast<Operation>(op), left, nullopt};
+                items.push_back({both, {right}, DataValue(), false, {}});
+                ArithmeticFunction none{static_cast<Operation>(op), nullopt, nullopt};
+                items.push_back({none, {left, right}, DataValue(), false, {}});
+            }
+        }
+    }
+    size_t buckets = applyBatch(items);
+    bool matches = true;
+    size_t failures = 0;
+    for (const auto& item : items) {
+        try {
+            DataValue expected = item.function.apply(item.args);
+            matches = matches && !item.failed && item.result == expected;
+        } catch (const runtime_error& e) {
+            matches = matches && item.failed && item.error == e.what();
+            ++failures;
+        }
+    }
+    TEST(matches, "Batched results equal one-at-a-time results");
+    TEST(failures > 0 && buckets == 4 * 9,
+         "Division by zero fails single items; one bucket per key");
+
+    // A processing thread drains prefilled queues in batches
+    logQueueCreation = false;
+    LogLevel previous = BaseThread::getLogLevel();
+    BaseThread::setLogLevel(LogLevel::OFF);
+    QueueRegistry registry;
+    DataThread data(1, 100, DATA_PACING, [](DataValue&) { return false; });
+    FunctionThread functions(100, 100, FUNCTION_PACING, [](ArithmeticFunction&) { return false; });
+    for (int i = 0; i < 40; ++i) data.pushValue(i % 2 == 0 ? DataValue(i) : DataValue(1.5f));
+    for (int i = 0; i < 20; ++i) {
+        functions.pushFunction({static_cast<Operation>(i % 3), nullopt, nullopt});
+    }
+    registry.add(&data);
+    registry.add(&functions);
+    atomic<int> processed{0};
+    BatchStats stats;
+    {
+        ProcessingThread processor(200, processed, 20, registry, PROCESSING_PACING.scaled(0.01),
+                                   nullptr, 0, {}, PROCESSING_QUEUE_WAIT, false,
+                                   BatchConfig{8, chrono::milliseconds(5)});
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+        while (processed < 20 && chrono::steady_clock::now() < deadline) {
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        processor.stop();
+        processor.join();
+        stats = processor.getBatchStats();
+    }
+    TEST(processed == 20 && data.getQueueSize() == 0 && functions.getQueueSize() == 0,
+         "Batches apply every function with its arguments");
+    TEST(stats.functions == 20 && stats.batches <= 3 && stats.meanSize() > 1,
+         "Functions are applied up to eight at a time");
+
+    // A batch never waits for data beyond the first function: the rest go back
+    FunctionThread more(101, 100, FUNCTION_PACING, [](ArithmeticFunction&) { return false; });
+    for (int i = 0; i < 5; ++i) more.pushFunction({Operation::ADD, 1, nullopt});
+    data.pushValue(1);
+    data.pushValue(2);
+    QueueRegistry partial;
+    partial.add(&data);
+    partial.add(&more);
+    atomic<int> applied{0};
+    {
+        ProcessingThread processor(201, applied, 100, partial, PROCESSING_PACING.scaled(0.01),
+                                   nullptr, 0, {}, chrono::milliseconds(10), false,
+                                   BatchConfig{8, chrono::milliseconds(5)});
+        auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+        while (applied < 2 && chrono::steady_clock::now() < deadline) {
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    TEST(applied == 2 && more.getQueueSize() == 3,
+         "Functions without data are returned to their queue");
+    BaseThread::setLogLevel(previous);
+    logQueueCreation = true;
+}
+
 // Integration test with command line parameters
 void test_with_parameters(int num_data_threads, int num_function_threads) {
     if (num_data_threads <= 0 || num_function_threads <= 0) {
@@ -264,11 +1929,40 @@ int main(int argc, char* argv[]) {
     try {
         // Core functionality tests
         test_queue_basic_functionality();
+        test_queue_lock_free_size();
+        test_queue_close();
         test_queue_with_variant();
         test_data_generation();
         test_function_generation();
         test_concurrent_operation();
         test_arithmetic_function_evaluation();
+        test_perf_counters();
+        test_tracing();
+        test_live_stats();
+        test_queue_sampler();
+        test_latency_histogram();
+        test_pipeline();
+        test_simulator();
+        test_autotune();
+        test_codec();
+        test_durable_queue();
+        test_snapshot();
+        test_shm_queue();
+        test_transport();
+        test_lookup_table();
+        test_memo_cache();
+        test_prefill();
+        test_seeding();
+        test_option_list();
+        test_low_latency();
+        test_queue_registry();
+        test_control();
+        test_overflow_policies();
+        test_timed_queue_operations();
+        test_backpressure();
+        test_reorder_buffer();
+        test_partitioned_routing();
+        test_micro_batching();
 
         // Integration test with command line parameters
         if (argc >= 3) {